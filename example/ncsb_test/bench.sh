@@ -0,0 +1,17 @@
+# compare the number of states of the complements of the semi-deterministic
+# automata in hoa/ obtained by NCSB, lazy NCSB, NCB, NSBC, the SCC-based complementation
+# and the determinization followed by the dualization
+out=bench.csv
+echo "file,ncsb,ncsb-lazy,ncb,nsbc,comp,dualize" > $out
+for f in hoa/*.hoa
+do
+    line="$f"
+    for opts in "--algo=ncsb" "--algo=ncsb-lazy" "--algo=ncb" "--algo=nsbc" "--algo=comp --simulation" \
+                "--determinize=cola --complement --simulation --stutter --use-scc"
+    do
+        states=$(timeout 300 ../../cola $opts $f | autfilt --stats=%s 2>/dev/null)
+        line="$line,${states:-TO}"
+    done
+    echo "$line"
+    echo "$line" >> $out
+done
@@ -0,0 +1,13 @@
+# check the result of --algo=comp against the complement computed by Spot
+rm -f output/comp_verify.log
+for f in ncsb_test/hoa/*.hoa
+do
+    echo "$f"
+    ../cola --algo=comp --simulation $f -o output/comp.hoa
+    autfilt $f --complement --output=output/spot_comp.hoa
+    if autfilt output/comp.hoa --equivalent-to=output/spot_comp.hoa > /dev/null; then
+	    echo "$f: equivalent" >> output/comp_verify.log
+    else
+	    echo "$f: not equivalent" >> output/comp_verify.log
+    fi
+done
@@ -0,0 +1,41 @@
+# check the results of --inclusion and --universality against Spot
+rm -f output/inclusion_verify.log output/universality_verify.log
+files=(ncsb_test/hoa/*.hoa)
+for i in "${!files[@]}"
+do
+    f=${files[$i]}
+    g=${files[$(( (i + 1) % ${#files[@]} ))]}
+    echo "$f"
+    # L(f) is included in itself and usually not in the language of another automaton
+    for h in $f $g
+    do
+        res=$(../cola --inclusion --simulation $f $h)
+        if autfilt $f --included-in=$h > /dev/null; then
+            expected="included"
+        else
+            expected="not included"
+        fi
+        if [[ "$res" == "$expected"* ]]; then
+            echo "$f $h: correct" >> output/inclusion_verify.log
+        else
+            echo "$f $h: wrong, cola says $res" >> output/inclusion_verify.log
+        fi
+    done
+    # f itself and the union of f with its complement, which is universal
+    autfilt $f --complement --output=output/spot_comp.hoa
+    autfilt $f --sum=output/spot_comp.hoa --output=output/sum.hoa
+    for h in $f output/sum.hoa
+    do
+        res=$(../cola --universality --simulation $h)
+        if autfilt $h --is-universal > /dev/null; then
+            expected="universal"
+        else
+            expected="not universal"
+        fi
+        if [[ "$res" == "$expected"* ]]; then
+            echo "$f $h: correct" >> output/universality_verify.log
+        else
+            echo "$f $h: wrong, cola says $res" >> output/universality_verify.log
+        fi
+    done
+done
@@ -0,0 +1,258 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "analysis.hpp"
+
+#include <unordered_set>
+
+#include <spot/twaalgos/isdet.hh>
+#include <spot/twaalgos/sccfilter.hh>
+#include <spot/twaalgos/simulation.hh>
+
+namespace cola
+{
+  analysis::analysis(const spot::const_twa_graph_ptr &aut)
+      : aut_(aut), si_(aut, spot::scc_info_options::ALL)
+  {
+    scc_types_ = cola::get_scc_types(si_);
+  }
+
+  analysis::analysis(const spot::const_twa_graph_ptr &aut, std::vector<bdd> &&implications)
+      : aut_(aut), si_(aut, spot::scc_info_options::ALL), implications_(std::move(implications))
+  {
+    scc_types_ = cola::get_scc_types(si_);
+  }
+
+  void
+  analysis::compute_supports()
+  {
+    unsigned nb_states = aut_->num_states();
+    support_.resize(nb_states);
+    compat_.resize(nb_states);
+    for (unsigned i = 0; i < nb_states; ++i)
+    {
+      bdd res_support = bddtrue;
+      bdd res_compat = bddfalse;
+      for (const auto &out : aut_->out(i))
+      {
+        res_support &= bdd_support(out.cond);
+        res_compat |= out.cond;
+      }
+      support_[i] = res_support;
+      compat_[i] = res_compat;
+    }
+  }
+
+  const std::vector<bdd> &
+  analysis::get_support()
+  {
+    if (support_.size() != aut_->num_states())
+      compute_supports();
+    return support_;
+  }
+
+  const std::vector<bdd> &
+  analysis::get_compat()
+  {
+    if (compat_.size() != aut_->num_states())
+      compute_supports();
+    return compat_;
+  }
+
+  const std::vector<bdd> &
+  analysis::get_stutter_support()
+  {
+    if (stutter_support_.size() != aut_->num_states())
+    {
+      stutter_support_ = get_support();
+      // the successors of an SCC have smaller numbers
+      for (unsigned c = 0; c != si_.scc_count(); ++c)
+      {
+        bdd c_supp = si_.scc_ap_support(c);
+        for (unsigned su : si_.succ(c))
+          c_supp &= stutter_support_[si_.one_state_of(su)];
+        for (unsigned st : si_.states_of(c))
+          stutter_support_[st] = c_supp;
+      }
+    }
+    return stutter_support_;
+  }
+
+  const std::vector<bool> &
+  analysis::get_scc_paths()
+  {
+    if (!has_scc_paths_)
+    {
+      scc_paths_ = find_scc_paths(si_);
+      has_scc_paths_ = true;
+    }
+    return scc_paths_;
+  }
+
+  state_simulator &
+  analysis::get_simulator()
+  {
+    if (!simulator_)
+      simulator_.reset(new state_simulator(aut_, si_, implications_, get_scc_paths(), !implications_.empty()));
+    return *simulator_;
+  }
+
+  analysis &
+  analysis::get_reduced(int trans_pruning)
+  {
+    if (!reduced_ || reduced_pruning_ != trans_pruning)
+    {
+      std::vector<bdd> implications;
+      spot::twa_graph_ptr aut_tmp = spot::scc_filter(aut_);
+      aut_tmp = spot::simulation(aut_tmp, &implications, trans_pruning);
+      reduced_.reset(new analysis(aut_tmp, std::move(implications)));
+      reduced_pruning_ = trans_pruning;
+    }
+    return *reduced_;
+  }
+
+  unsigned
+  analysis::get_type()
+  {
+    if (type_ < 0)
+    {
+      type_ = NONDETERMINISTIC;
+      if (is_weak_automaton(si_, scc_types_))
+        type_ |= INHERENTLY_WEAK;
+      if (is_limit_deterministic_automaton(si_, scc_types_))
+        type_ |= LIMIT_DETERMINISTIC;
+      if (is_elevator_automaton(si_, scc_types_))
+        type_ |= ELEVATOR;
+    }
+    return type_;
+  }
+
+  bool
+  analysis::is_weak()
+  {
+    return (get_type() & INHERENTLY_WEAK) > 0;
+  }
+
+  bool
+  analysis::is_elevator()
+  {
+    return (get_type() & ELEVATOR) > 0;
+  }
+
+  bool
+  analysis::is_limit_deterministic()
+  {
+    return (get_type() & LIMIT_DETERMINISTIC) > 0;
+  }
+
+  bool
+  analysis::is_deterministic()
+  {
+    if (deterministic_ < 0)
+      deterministic_ = spot::is_deterministic(aut_);
+    return deterministic_ > 0;
+  }
+
+  const std::pair<bdd, bdd> &
+  reach_letters::get(const std::vector<unsigned> &states)
+  {
+    auto it = cache_.find(states);
+    if (it != cache_.end())
+      return it->second;
+    bdd support = bddtrue;
+    bdd compat = bddfalse;
+    for (unsigned s : states)
+    {
+      support &= support_[s];
+      compat |= compat_[s];
+    }
+    return cache_.emplace(states, std::make_pair(support, compat)).first->second;
+  }
+
+  const std::vector<bdd> &
+  letter_classes::get(const std::vector<unsigned> &states, const bdd &letters)
+  {
+    auto it = cache_.find(states);
+    if (it != cache_.end())
+      return it->second;
+    std::vector<bdd> classes;
+    if (letters != bddfalse)
+      classes.push_back(letters);
+    std::unordered_set<int> guards;
+    std::vector<bdd> refined;
+    for (unsigned s : states)
+    {
+      for (const auto &t : aut_->out(s))
+      {
+        if (!guards.insert(t.cond.id()).second)
+          continue;
+        refined.clear();
+        for (const bdd &c : classes)
+        {
+          bdd in = c & t.cond;
+          bdd out = c - t.cond;
+          if (in != bddfalse)
+            refined.push_back(in);
+          if (out != bddfalse)
+            refined.push_back(out);
+        }
+        classes.swap(refined);
+      }
+    }
+    return cache_.emplace(states, std::move(classes)).first->second;
+  }
+
+  analysis_cache::analysis_cache(unsigned capacity)
+      : capacity_(capacity)
+  {
+  }
+
+  std::shared_ptr<analysis>
+  analysis_cache::find(const std::string &key)
+  {
+    auto it = index_.find(key);
+    if (it == index_.end())
+      return nullptr;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->second;
+  }
+
+  void
+  analysis_cache::insert(const std::string &key, const std::shared_ptr<analysis> &ctx)
+  {
+    if (capacity_ == 0)
+      return;
+    auto it = index_.find(key);
+    if (it != index_.end())
+    {
+      it->second->second = ctx;
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return;
+    }
+    entries_.emplace_front(key, ctx);
+    index_[key] = entries_.begin();
+    while (entries_.size() > capacity_)
+    {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+  }
+
+  void
+  analysis_cache::clear()
+  {
+    index_.clear();
+    entries_.clear();
+  }
+}
@@ -0,0 +1,222 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "cola.hpp"
+#include "hash.hpp"
+#include "optimizer.hpp"
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <spot/twaalgos/sccinfo.hh>
+
+namespace cola
+{
+  /// \brief The information about an input NBA that is shared by the
+  /// classification and all the constructions
+  ///
+  /// The SCC information and the SCC types are computed once at construction,
+  /// everything else is computed on the first request and then kept.
+  class analysis
+  {
+  private:
+    const spot::const_twa_graph_ptr aut_;
+
+    spot::scc_info si_;
+
+    // types of the SCCs, see get_scc_types()
+    std::string scc_types_;
+
+    // support and compatible letters of the outgoing transitions of each state
+    std::vector<bdd> support_;
+    std::vector<bdd> compat_;
+    // support_ extended for the stutter steps, see get_stutter_support()
+    std::vector<bdd> stutter_support_;
+
+    // reachability of the SCCs, see find_scc_paths()
+    std::vector<bool> scc_paths_;
+    bool has_scc_paths_ = false;
+
+    // automaton_type flags, -1 if not computed
+    int type_ = -1;
+    // -1 if not computed
+    int deterministic_ = -1;
+
+    // implications of the simulation, empty if aut_ is not reduced by simulation
+    std::vector<bdd> implications_;
+
+    std::unique_ptr<state_simulator> simulator_;
+
+    // the automaton reduced by simulation
+    std::unique_ptr<analysis> reduced_;
+    int reduced_pruning_ = 0;
+
+    void compute_supports();
+
+  public:
+    analysis(const spot::const_twa_graph_ptr &aut);
+
+    analysis(const spot::const_twa_graph_ptr &aut, std::vector<bdd> &&implications);
+
+    const spot::const_twa_graph_ptr &
+    get_aut() const
+    {
+      return aut_;
+    }
+
+    spot::scc_info &
+    get_scc_info()
+    {
+      return si_;
+    }
+
+    std::string &
+    get_scc_types()
+    {
+      return scc_types_;
+    }
+
+    const std::vector<bdd> &get_support();
+
+    const std::vector<bdd> &get_compat();
+
+    /// \brief The support of each state for a stutter-invariant automaton
+    ///
+    /// A state has the support of its SCC and of the states after it, since
+    /// the stutter steps may go on from there.
+    const std::vector<bdd> &get_stutter_support();
+
+    // res[i + scccount*j] = 1 iff SCC i is reachable from SCC j
+    const std::vector<bool> &get_scc_paths();
+
+    std::vector<bdd> &
+    get_implications()
+    {
+      return implications_;
+    }
+
+    /// \brief The simulation relation given by the implications
+    /// (the identity if there are none)
+    state_simulator &get_simulator();
+
+    /// \brief The analysis of the automaton reduced by scc_filter and
+    /// spot::simulation with \a trans_pruning
+    analysis &get_reduced(int trans_pruning);
+
+    // automaton_type flags
+    unsigned get_type();
+
+    bool is_weak();
+
+    bool is_elevator();
+
+    bool is_limit_deterministic();
+
+    bool is_deterministic();
+  };
+
+  struct states_hash
+  {
+    size_t
+    operator()(const std::vector<unsigned> &states) const noexcept
+    {
+      return hash_values(states);
+    }
+  };
+
+  /// \brief The support and the compatible letters of sets of states
+  ///
+  /// Many macrostates share the same set of states, so the conjunction of
+  /// the supports and the disjunction of the compatible letters of the
+  /// states are only computed once for each set.
+  class reach_letters
+  {
+  private:
+    const std::vector<bdd> &support_;
+    const std::vector<bdd> &compat_;
+
+    std::unordered_map<std::vector<unsigned>, std::pair<bdd, bdd>, states_hash> cache_;
+
+  public:
+    reach_letters(const std::vector<bdd> &support, const std::vector<bdd> &compat)
+        : support_(support), compat_(compat)
+    {
+    }
+
+    // (support, compatible letters) of the states, given in increasing order
+    const std::pair<bdd, bdd> &
+    get(const std::vector<unsigned> &states);
+  };
+
+  /// \brief The letter classes of sets of states
+  ///
+  /// The classes are the coarsest partition of the letters that refines the
+  /// guards of all outgoing edges of the states, so all letters of a class
+  /// take the same edges from these states. Like for reach_letters, they are
+  /// computed once for each set of states.
+  class letter_classes
+  {
+  private:
+    const spot::const_twa_graph_ptr aut_;
+
+    std::unordered_map<std::vector<unsigned>, std::vector<bdd>, states_hash> cache_;
+
+  public:
+    letter_classes(const spot::const_twa_graph_ptr &aut)
+        : aut_(aut)
+    {
+    }
+
+    // the classes of the \a letters of the states, given in increasing order
+    const std::vector<bdd> &
+    get(const std::vector<unsigned> &states, const bdd &letters);
+  };
+
+  /// \brief The analyses of the preprocessed inputs kept by the server mode
+  ///
+  /// The least recently used entry is dropped once there are more than
+  /// \a capacity entries.
+  class analysis_cache
+  {
+  private:
+    typedef std::list<std::pair<std::string, std::shared_ptr<analysis>>> entry_list;
+
+    unsigned capacity_;
+
+    // the most recently used first
+    entry_list entries_;
+    std::unordered_map<std::string, entry_list::iterator> index_;
+
+  public:
+    analysis_cache(unsigned capacity);
+
+    // nullptr if there is no entry for the key
+    std::shared_ptr<analysis> find(const std::string &key);
+
+    void insert(const std::string &key, const std::shared_ptr<analysis> &ctx);
+
+    void clear();
+
+    unsigned
+    size() const
+    {
+      return entries_.size();
+    }
+  };
+}
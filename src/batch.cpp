@@ -0,0 +1,244 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "batch.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+namespace cola
+{
+  static const char *END_MARKERS[] = {"--END--", "--ABORT--"};
+
+  hoa_batch::hoa_batch(const std::string &file, unsigned num_threads)
+      : data_(nullptr), size_(0)
+  {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("cola: cannot open " + file);
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+      close(fd);
+      throw std::runtime_error("cola: cannot read " + file);
+    }
+    size_ = st.st_size;
+    if (size_ > 0)
+    {
+      void *map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map == MAP_FAILED)
+      {
+        close(fd);
+        throw std::runtime_error("cola: cannot map " + file);
+      }
+      data_ = (const char *)map;
+    }
+    close(fd);
+    scan(std::max(1u, num_threads));
+  }
+
+  hoa_batch::~hoa_batch()
+  {
+    if (data_)
+      munmap((void *)data_, size_);
+  }
+
+  void
+  hoa_batch::scan(unsigned num_threads)
+  {
+    // the ends of the automata found in each part of the file
+    std::vector<std::vector<size_t>> ends(num_threads);
+    size_t part = size_ / num_threads + 1;
+    auto scan_part = [&](unsigned t)
+    {
+      size_t lo = std::min(size_, t * part);
+      size_t hi = std::min(size_, lo + part);
+      for (const char *marker : END_MARKERS)
+      {
+        size_t len = std::strlen(marker);
+        // a marker starting in [lo, hi) may end after hi
+        size_t limit = std::min(size_, hi + len - 1);
+        const char *p = data_ + lo;
+        while ((p = (const char *)memmem(p, data_ + limit - p, marker, len)) != nullptr)
+        {
+          size_t pos = p - data_;
+          if (pos >= hi)
+            break;
+          // a marker is a token of its own
+          if ((pos == 0 || std::isspace((unsigned char)data_[pos - 1]))
+              && (pos + len == size_ || std::isspace((unsigned char)data_[pos + len])))
+            ends[t].push_back(pos + len);
+          p++;
+        }
+      }
+      std::sort(ends[t].begin(), ends[t].end());
+    };
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < num_threads; t++)
+      threads.emplace_back(scan_part, t);
+    scan_part(0);
+    for (auto &t : threads)
+      t.join();
+
+    size_t begin = 0;
+    for (const auto &part_ends : ends)
+    {
+      for (size_t end : part_ends)
+      {
+        ranges_.emplace_back(begin, end);
+        begin = end;
+      }
+    }
+    // anything after the last automaton is left to the parser to complain about
+    for (size_t i = begin; i < size_; i++)
+    {
+      if (!std::isspace((unsigned char)data_[i]))
+      {
+        ranges_.emplace_back(begin, size_);
+        break;
+      }
+    }
+  }
+
+  std::string
+  hoa_batch::get(size_t i) const
+  {
+    return std::string(data_ + ranges_[i].first, ranges_[i].second - ranges_[i].first);
+  }
+
+  static bool
+  write_all(int fd, const std::string &data)
+  {
+    size_t written = 0;
+    while (written < data.size())
+    {
+      ssize_t n = write(fd, data.data() + written, data.size() - written);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      written += n;
+    }
+    return true;
+  }
+
+  void
+  run_batch(size_t num_items, unsigned num_jobs, const std::function<int(size_t, std::string &)> &work,
+            const std::function<void(size_t, int, const std::string &)> &emit)
+  {
+    if (num_jobs <= 1 || num_items <= 1)
+    {
+      for (size_t i = 0; i < num_items; i++)
+      {
+        std::string out;
+        int status = work(i, out);
+        emit(i, status, out);
+      }
+      return;
+    }
+    num_jobs = std::min((size_t)num_jobs, num_items);
+    // otherwise the buffered output would be printed by every child
+    std::cout.flush();
+    std::vector<FILE *> files;
+    std::vector<pid_t> pids;
+    for (unsigned w = 0; w < num_jobs; w++)
+    {
+      // the child writes to it, the parent reads it once the child is done
+      FILE *file = tmpfile();
+      if (file == nullptr)
+        throw std::runtime_error("cola: cannot create a temporary file");
+      pid_t pid = fork();
+      if (pid < 0)
+        throw std::runtime_error("cola: cannot fork a worker");
+      if (pid == 0)
+      {
+        int fd = fileno(file);
+        for (size_t i = w; i < num_items; i += num_jobs)
+        {
+          std::string out;
+          int status;
+          try
+          {
+            status = work(i, out);
+          }
+          catch (const std::exception &e)
+          {
+            status = 1;
+            out = std::string(e.what()) + '\n';
+          }
+          // a frame is "<item> <status> <length>\n" and the output
+          std::string header = std::to_string(i) + ' ' + std::to_string(status) + ' ' + std::to_string(out.size()) + '\n';
+          if (!write_all(fd, header) || !write_all(fd, out))
+            break;
+        }
+        std::cout.flush();
+        // do not run the destructors of the parent's objects
+        _exit(0);
+      }
+      files.push_back(file);
+      pids.push_back(pid);
+    }
+
+    std::vector<std::string> outputs(num_items);
+    // -1 for the items whose worker has stopped before them
+    std::vector<int> status(num_items, -1);
+    for (unsigned w = 0; w < num_jobs; w++)
+    {
+      waitpid(pids[w], nullptr, 0);
+      std::string data;
+      char buffer[1 << 16];
+      int fd = fileno(files[w]);
+      lseek(fd, 0, SEEK_SET);
+      ssize_t n;
+      while ((n = read(fd, buffer, sizeof(buffer))) > 0 || (n < 0 && errno == EINTR))
+        if (n > 0)
+          data.append(buffer, n);
+      fclose(files[w]);
+      size_t pos = 0;
+      while (pos < data.size())
+      {
+        size_t eol = data.find('\n', pos);
+        if (eol == std::string::npos)
+          break;
+        size_t item, length;
+        int item_status;
+        if (std::sscanf(data.c_str() + pos, "%zu %d %zu", &item, &item_status, &length) != 3
+            || item >= num_items || item_status < 0 || eol + 1 + length > data.size())
+          break;
+        outputs[item] = data.substr(eol + 1, length);
+        status[item] = item_status;
+        pos = eol + 1 + length;
+      }
+    }
+    for (size_t i = 0; i < num_items; i++)
+    {
+      if (status[i] < 0)
+        emit(i, 1, "cola: the worker stopped before automaton " + std::to_string(i) + "\n");
+      else
+        emit(i, status[i], outputs[i]);
+    }
+  }
+}
@@ -0,0 +1,72 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cola
+{
+  /// \brief The automata of a HOA file, mapped in memory
+  ///
+  /// The file is split at the --END-- and --ABORT-- markers by threads that
+  /// scan disjoint parts of it, so each automaton can be parsed on its own.
+  /// The parsing itself needs BuDDy, which is not thread-safe.
+  class hoa_batch
+  {
+  private:
+    const char *data_;
+    size_t size_;
+
+    // [begin, end) of each automaton in the file
+    std::vector<std::pair<size_t, size_t>> ranges_;
+
+    void
+    scan(unsigned num_threads);
+
+  public:
+    hoa_batch(const std::string &file, unsigned num_threads);
+
+    ~hoa_batch();
+
+    hoa_batch(const hoa_batch &) = delete;
+    hoa_batch &operator=(const hoa_batch &) = delete;
+
+    // the number of automata
+    size_t
+    size() const
+    {
+      return ranges_.size();
+    }
+
+    // the text of the i-th automaton
+    std::string
+    get(size_t i) const;
+  };
+
+  /// \brief Run \a work on the items 0, ..., \a num_items - 1 in \a num_jobs processes
+  ///
+  /// The items are dealt round-robin to forked child processes, each with its
+  /// own copy of the BDDs. \a work returns 0 if an item has succeeded, and
+  /// otherwise the exit status of its failure, with the error in its output.
+  /// Once all children have finished, \a emit gets the statuses and the
+  /// outputs in the order of the items. Runs everything in this process if
+  /// \a num_jobs is at most 1.
+  void
+  run_batch(size_t num_items, unsigned num_jobs, const std::function<int(size_t, std::string &)> &work,
+            const std::function<void(size_t, int, const std::string &)> &emit);
+}
@@ -0,0 +1,311 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "binary.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace cola
+{
+  static const char MAGIC[] = {'C', 'O', 'L', 'A', 1};
+  static const unsigned MAX_SETS = 64;
+
+  void
+  write_varint(std::string &buf, uint64_t value)
+  {
+    while (value >= 0x80)
+    {
+      buf.push_back((char)(value | 0x80));
+      value >>= 7;
+    }
+    buf.push_back((char)value);
+  }
+
+  static void
+  write_string(std::string &buf, const std::string &str)
+  {
+    write_varint(buf, str.size());
+    buf += str;
+  }
+
+  uint64_t
+  read_varint(const char *&data, const char *end)
+  {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+      if (data == end)
+        throw std::runtime_error("binary automaton: truncated input");
+      unsigned char byte = *data++;
+      value |= (uint64_t)(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+        return value;
+    }
+    throw std::runtime_error("binary automaton: invalid integer");
+  }
+
+  static std::string
+  read_string(const char *&data, const char *end)
+  {
+    uint64_t size = read_varint(data, end);
+    if (size > (uint64_t)(end - data))
+      throw std::runtime_error("binary automaton: truncated input");
+    std::string res(data, size);
+    data += size;
+    return res;
+  }
+
+  // the table of the BDD nodes of the guards, shared by all guards
+  class bdd_table
+  {
+  private:
+    // proposition -> index in the list of propositions of the automaton
+    const std::unordered_map<int, unsigned> &var2ap_;
+    // BDD identifier -> reference
+    std::unordered_map<int, uint64_t> refs_;
+    uint64_t num_nodes_ = 0;
+
+  public:
+    std::string nodes_;
+
+    bdd_table(const std::unordered_map<int, unsigned> &var2ap)
+        : var2ap_(var2ap)
+    {
+    }
+
+    uint64_t
+    add(const bdd &b)
+    {
+      if (b == bddfalse)
+        return 0;
+      if (b == bddtrue)
+        return 1;
+      auto it = refs_.find(b.id());
+      if (it != refs_.end())
+        return it->second;
+      uint64_t low = add(bdd_low(b));
+      uint64_t high = add(bdd_high(b));
+      auto ap = var2ap_.find(bdd_var(b));
+      if (ap == var2ap_.end())
+        throw std::runtime_error("binary automaton: a guard uses an unregistered proposition");
+      write_varint(nodes_, ap->second);
+      write_varint(nodes_, low);
+      write_varint(nodes_, high);
+      uint64_t ref = 2 + num_nodes_++;
+      refs_.emplace(b.id(), ref);
+      return ref;
+    }
+
+    uint64_t
+    num_nodes() const
+    {
+      return num_nodes_;
+    }
+  };
+
+  bool
+  is_binary_automaton(const char *data, size_t size)
+  {
+    return size >= sizeof(MAGIC) && std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+  }
+
+  bool
+  is_binary_file(const std::string &file)
+  {
+    char header[sizeof(MAGIC)];
+    std::ifstream in(file, std::ios::binary);
+    return in.read(header, sizeof(header)) && is_binary_automaton(header, sizeof(header));
+  }
+
+  void
+  print_binary(std::ostream &out, const spot::const_twa_graph_ptr &aut)
+  {
+    // the colors of an edge are a 64-bit mask
+    if (aut->num_sets() > MAX_SETS)
+      throw std::runtime_error("binary automaton: more than " + std::to_string(MAX_SETS) + " acceptance sets");
+    std::string buf(MAGIC, sizeof(MAGIC));
+    std::unordered_map<int, unsigned> var2ap;
+    write_varint(buf, aut->ap().size());
+    for (unsigned i = 0; i < aut->ap().size(); i++)
+    {
+      write_string(buf, aut->ap()[i].ap_name());
+      var2ap.emplace(aut->get_dict()->varnum(aut->ap()[i]), i);
+    }
+    std::ostringstream acc;
+    acc << aut->get_acceptance();
+    write_varint(buf, aut->num_sets());
+    write_string(buf, acc.str());
+
+    // every distinct guard once
+    bdd_table table(var2ap);
+    std::unordered_map<int, uint64_t> guard2index;
+    std::string guards;
+    for (const auto &t : aut->edges())
+    {
+      if (guard2index.count(t.cond.id()))
+        continue;
+      guard2index.emplace(t.cond.id(), guard2index.size());
+      write_varint(guards, table.add(t.cond));
+    }
+    write_varint(buf, table.num_nodes());
+    buf += table.nodes_;
+    write_varint(buf, guard2index.size());
+    buf += guards;
+
+    unsigned num_states = aut->num_states();
+    write_varint(buf, num_states);
+    write_varint(buf, aut->get_init_state_number());
+    for (unsigned s = 0; s < num_states; s++)
+    {
+      unsigned num_edges = 0;
+      for (const auto &t : aut->out(s))
+      {
+        (void)t;
+        num_edges++;
+      }
+      write_varint(buf, num_edges);
+      for (const auto &t : aut->out(s))
+      {
+        write_varint(buf, t.dst);
+        write_varint(buf, guard2index[t.cond.id()]);
+        uint64_t colors = 0;
+        for (unsigned c : t.acc.sets())
+          colors |= (uint64_t)1 << c;
+        write_varint(buf, colors);
+      }
+    }
+    out.write(buf.data(), buf.size());
+  }
+
+  void
+  output_binary_file(const spot::const_twa_graph_ptr &aut, const char *file)
+  {
+    std::ofstream outfile(file, std::ios::binary);
+    print_binary(outfile, aut);
+  }
+
+  spot::twa_graph_ptr
+  parse_binary(const char *&data, const char *end, const spot::bdd_dict_ptr &dict)
+  {
+    if (!is_binary_automaton(data, end - data))
+      throw std::runtime_error("binary automaton: missing header");
+    data += sizeof(MAGIC);
+    spot::twa_graph_ptr aut = spot::make_twa_graph(dict);
+
+    uint64_t num_aps = read_varint(data, end);
+    std::vector<bdd> vars;
+    for (uint64_t i = 0; i < num_aps; i++)
+      vars.push_back(bdd_ithvar(aut->register_ap(spot::formula::ap(read_string(data, end)))));
+    unsigned num_sets = read_varint(data, end);
+    if (num_sets > MAX_SETS)
+      throw std::runtime_error("binary automaton: too many acceptance sets");
+    std::string acc = read_string(data, end);
+    aut->set_acceptance(num_sets, spot::acc_cond::acc_code(acc.c_str()));
+
+    // the children of a node come before it
+    uint64_t num_nodes = read_varint(data, end);
+    std::vector<bdd> nodes = {bddfalse, bddtrue};
+    nodes.reserve(num_nodes + 2);
+    for (uint64_t i = 0; i < num_nodes; i++)
+    {
+      uint64_t ap = read_varint(data, end);
+      uint64_t low = read_varint(data, end);
+      uint64_t high = read_varint(data, end);
+      if (ap >= vars.size() || low >= nodes.size() || high >= nodes.size())
+        throw std::runtime_error("binary automaton: invalid BDD node");
+      nodes.push_back(bdd_ite(vars[ap], nodes[high], nodes[low]));
+    }
+    uint64_t num_guards = read_varint(data, end);
+    std::vector<bdd> guards;
+    guards.reserve(num_guards);
+    for (uint64_t i = 0; i < num_guards; i++)
+    {
+      uint64_t ref = read_varint(data, end);
+      if (ref >= nodes.size())
+        throw std::runtime_error("binary automaton: invalid guard");
+      guards.push_back(nodes[ref]);
+    }
+
+    uint64_t num_states = read_varint(data, end);
+    uint64_t init = read_varint(data, end);
+    if (init >= num_states)
+      throw std::runtime_error("binary automaton: invalid initial state");
+    aut->new_states(num_states);
+    aut->set_init_state(init);
+    for (uint64_t s = 0; s < num_states; s++)
+    {
+      uint64_t num_edges = read_varint(data, end);
+      for (uint64_t i = 0; i < num_edges; i++)
+      {
+        uint64_t dst = read_varint(data, end);
+        uint64_t guard = read_varint(data, end);
+        uint64_t colors = read_varint(data, end);
+        if (dst >= num_states || guard >= guards.size())
+          throw std::runtime_error("binary automaton: invalid edge");
+        spot::acc_cond::mark_t acc = {};
+        for (unsigned c = 0; colors != 0; c++, colors >>= 1)
+          if (colors & 1)
+            acc.set(c);
+        aut->new_edge(s, dst, guards[guard], acc);
+      }
+    }
+    return aut;
+  }
+
+  std::vector<spot::twa_graph_ptr>
+  load_binary(const std::string &file, const spot::bdd_dict_ptr &dict)
+  {
+    std::vector<spot::twa_graph_ptr> res;
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0)
+      return res;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MAGIC))
+    {
+      close(fd);
+      return res;
+    }
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+      return res;
+    const char *data = (const char *)map;
+    const char *end = data + st.st_size;
+    try
+    {
+      if (is_binary_automaton(data, end - data))
+      {
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+        while (data != end)
+          res.push_back(parse_binary(data, end, dict));
+      }
+    }
+    catch (...)
+    {
+      munmap(map, st.st_size);
+      throw;
+    }
+    munmap(map, st.st_size);
+    return res;
+  }
+}
@@ -0,0 +1,77 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "cola.hpp"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// A compact binary format for automata, faster to write and read than HOA.
+//
+// An automaton is the magic "COLA", a version byte and then unsigned LEB128
+// integers (varints):
+//   the atomic propositions, each as its length and its name,
+//   the number of acceptance sets and the acceptance condition as text,
+//   the BDD nodes of all the guards, children first, each as (proposition,
+//     low, high) where a reference is 0 for false, 1 for true and n + 2
+//     for the n-th node,
+//   the guards as references to the nodes,
+//   the number of states and the initial state,
+//   for each state its number of edges and then each edge as the successor,
+//     the guard and the bit mask of its colors, so at most 64 acceptance
+//     sets are supported.
+// A file may hold several automata one after another.
+
+namespace cola
+{
+  // append value to buf as a varint
+  void
+  write_varint(std::string &buf, uint64_t value);
+
+  // read a varint and move data after it
+  uint64_t
+  read_varint(const char *&data, const char *end);
+
+  // whether the data starts with an automaton in the binary format
+  bool
+  is_binary_automaton(const char *data, size_t size);
+
+  // whether the file starts with an automaton in the binary format
+  bool
+  is_binary_file(const std::string &file);
+
+  void
+  print_binary(std::ostream &out, const spot::const_twa_graph_ptr &aut);
+
+  // write aut to file in the binary format
+  void
+  output_binary_file(const spot::const_twa_graph_ptr &aut, const char *file);
+
+  /// \brief Read an automaton in the binary format
+  ///
+  /// Reads from data and moves data after the automaton.
+  spot::twa_graph_ptr
+  parse_binary(const char *&data, const char *end, const spot::bdd_dict_ptr &dict);
+
+  /// \brief Read all the automata of a file in the binary format
+  ///
+  /// The file is mapped in memory and the automata are built directly from
+  /// the mapping. Returns no automaton if the file cannot be opened or is
+  /// not in the binary format.
+  std::vector<spot::twa_graph_ptr>
+  load_binary(const std::string &file, const spot::bdd_dict_ptr &dict);
+}
@@ -0,0 +1,123 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "budget.hpp"
+
+#include <fstream>
+
+#include <unistd.h>
+#include <sys/resource.h>
+
+namespace cola
+{
+  budget_exceeded::budget_exceeded(const std::string &reason, unsigned num_states, size_t frontier, size_t memory_kb, double elapsed_ms)
+      : std::runtime_error("budget exceeded: " + reason),
+        reason_(reason),
+        num_states_(num_states),
+        frontier_(frontier),
+        memory_kb_(memory_kb),
+        elapsed_ms_(elapsed_ms)
+  {
+  }
+
+  void
+  budget_exceeded::print_report(std::ostream &os) const
+  {
+    os << "Aborted (" << reason_ << ") after " << elapsed_ms_ << " ms\n";
+    os << "States explored: " << (num_states_ - frontier_) << "\n";
+    os << "States in frontier: " << frontier_ << "\n";
+    os << "Memory used: " << memory_kb_ / 1024 << " MB\n";
+  }
+
+  budget::budget(const spot::option_map &om)
+      : max_states_(om.get(MAX_STATES) > 0 ? om.get(MAX_STATES) : 0),
+        timeout_ms_(om.get(TIMEOUT) > 0 ? 1000u * om.get(TIMEOUT) : 0),
+        max_memory_kb_(om.get(MAX_MEMORY) > 0 ? 1024ul * om.get(MAX_MEMORY) : 0),
+        start_(std::chrono::steady_clock::now()),
+        cancelled_(false),
+        ticks_(0)
+  {
+  }
+
+  void
+  budget::check(unsigned num_states, size_t frontier)
+  {
+    if (cancelled_.load(std::memory_order_relaxed))
+      throw budget_exceeded("cancelled", num_states, frontier, current_memory_kb(), elapsed_ms());
+    unsigned max_states = max_states_.load(std::memory_order_relaxed);
+    if (max_states > 0 && num_states > max_states)
+      throw budget_exceeded("max-states", num_states, frontier, current_memory_kb(), elapsed_ms());
+    if (timeout_ms_ > 0 && elapsed_ms() > timeout_ms_)
+      throw budget_exceeded("timeout", num_states, frontier, current_memory_kb(), elapsed_ms());
+    // the memory only grows slowly, no need to ask the kernel every time
+    if (max_memory_kb_ > 0 && (++ticks_ & 63) == 0)
+    {
+      size_t memory_kb = current_memory_kb();
+      if (memory_kb > max_memory_kb_)
+        throw budget_exceeded("max-memory", num_states, frontier, memory_kb, elapsed_ms());
+    }
+  }
+
+  void
+  budget::cancel()
+  {
+    cancelled_.store(true);
+  }
+
+  bool
+  budget::is_cancelled() const
+  {
+    return cancelled_.load();
+  }
+
+  void
+  budget::set_max_states(unsigned max_states)
+  {
+    max_states_.store(max_states);
+  }
+
+  unsigned
+  budget::get_max_states() const
+  {
+    return max_states_.load();
+  }
+
+  bool
+  budget::has_limits() const
+  {
+    return max_states_.load() > 0 || timeout_ms_ > 0 || max_memory_kb_ > 0;
+  }
+
+  double
+  budget::elapsed_ms() const
+  {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_;
+    return elapsed.count();
+  }
+
+  size_t
+  budget::current_memory_kb()
+  {
+    // the second field of statm is the number of resident pages
+    std::ifstream statm("/proc/self/statm");
+    size_t size = 0, resident = 0;
+    if (statm >> size >> resident)
+      return resident * (sysconf(_SC_PAGESIZE) / 1024);
+    // otherwise fall back to the peak usage
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+      return usage.ru_maxrss;
+    return 0;
+  }
+}
@@ -0,0 +1,125 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "cola.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#include <spot/misc/optionmap.hh>
+
+namespace cola
+{
+  /// \brief Thrown by a construction when it runs out of its budget
+  ///
+  /// Carries a summary of the partial exploration at the time of the abort.
+  class budget_exceeded : public std::runtime_error
+  {
+  private:
+    // the limit that has been hit
+    std::string reason_;
+    // number of macrostates created so far
+    unsigned num_states_;
+    // number of macrostates that still need to be explored
+    size_t frontier_;
+    // resident memory (KB) at the time of the abort
+    size_t memory_kb_;
+    double elapsed_ms_;
+
+  public:
+    budget_exceeded(const std::string &reason, unsigned num_states, size_t frontier, size_t memory_kb, double elapsed_ms);
+
+    const std::string &reason() const
+    {
+      return reason_;
+    }
+
+    unsigned num_states() const
+    {
+      return num_states_;
+    }
+
+    size_t frontier() const
+    {
+      return frontier_;
+    }
+
+    size_t memory_kb() const
+    {
+      return memory_kb_;
+    }
+
+    double elapsed_ms() const
+    {
+      return elapsed_ms_;
+    }
+
+    // print the partial-exploration report
+    void print_report(std::ostream &os) const;
+  };
+
+  /// \brief Limits on the number of states, the running time and the memory
+  /// of a construction, set by MAX_STATES, TIMEOUT and MAX_MEMORY
+  ///
+  /// The constructions call check() in their exploration loops, so an
+  /// exceeded limit aborts the construction with budget_exceeded.
+  /// The clock starts when the budget is created.
+  class budget
+  {
+  private:
+    // 0 means no limit
+    std::atomic<unsigned> max_states_;
+    unsigned timeout_ms_;
+    size_t max_memory_kb_;
+
+    std::chrono::steady_clock::time_point start_;
+
+    // set by another thread to stop the construction as soon as possible
+    std::atomic<bool> cancelled_;
+
+    // reading the memory usage is expensive, so only do it every few checks
+    unsigned ticks_;
+
+  public:
+    budget(const spot::option_map &om);
+
+    /// \brief Throw budget_exceeded if a limit has been hit
+    ///
+    /// \a num_states is the number of states created so far and
+    /// \a frontier the number of states still to be explored
+    void check(unsigned num_states, size_t frontier);
+
+    // ask the construction using this budget to stop
+    void cancel();
+
+    bool is_cancelled() const;
+
+    void set_max_states(unsigned max_states);
+
+    unsigned get_max_states() const;
+
+    // whether any of the limits is set
+    bool has_limits() const;
+
+    double elapsed_ms() const;
+
+    // the resident memory of the process in KB
+    static size_t current_memory_kb();
+  };
+}
@@ -36,11 +36,32 @@ static const char *USE_UNAMBIGUITY = "use-unambiguity";
 static const char *MORE_ACC_EDGES = "more-acc-edges";
 static const char *VERBOSE_LEVEL = "verbose-level";
 static const char *NUM_NBA_DECOMPOSED = "num-nba-decomposed";
+// simplify the pieces of the decomposer with Spot's postprocessor
+static const char *DECOMPOSE_POSTPROCESS = "decompose-postprocess";
+// processes that determinize the pieces of the decomposer
+static const char *DECOMPOSE_JOBS = "decompose-jobs";
 static const char *NUM_SCC_LIMIT_MERGER = "num-scc-limit-merger";
 static const char *SCC_REACH_MEMORY_LIMIT = "scc-reach-memory-limit";
 static const char *REQUIRE_PARITY = "require-parity";
 static const char *NUM_TRANS_PRUNING = "num-trans-pruning"; 
 static const char *MSTATE_REARRANGE = "rank-rearrange";
+// successors of determinize_tnba() computed per letter class of the macrostate
+static const char *LETTER_CLASSES = "letter-classes";
+// resource limits for the constructions, 0 means no limit
+static const char *MAX_STATES = "max-states";
+static const char *TIMEOUT = "timeout";       // in seconds
+static const char *MAX_MEMORY = "max-memory"; // in MB
+// percentage of the states of Spot's result that cola may still reach in the portfolio
+static const char *PORTFOLIO_RATIO = "portfolio-ratio";
+// milliseconds spent by postprocess_sccs(), 0 means no limit
+static const char *POST_TIME_LIMIT = "post-time-limit";
+// MB of macrostates kept in memory by the external exploration of determinize_tnba(), 0 means in memory
+static const char *EXTERNAL_BFS = "external-bfs";
+// checkpoints of determinize_tnba(): the file to write (string), the seconds
+// between two checkpoints, and the file to resume from (string)
+static const char *CHECKPOINT_FILE = "checkpoint-file";
+static const char *CHECKPOINT_INTERVAL = "checkpoint-interval";
+static const char *RESUME_FILE = "resume-file";
 
 
 static const char SCC_WEAK_TYPE = 1;
@@ -63,15 +84,25 @@ enum automaton_type
 
 namespace cola
 {
+  class budget;
+  class analysis;
 
   spot::twa_graph_ptr
-  complement_semidet_opt(const spot::const_twa_graph_ptr &aut, bool show_names = false);
+  complement_semidet_opt(const spot::const_twa_graph_ptr &aut, bool show_names = false, budget *limits = nullptr);
 
   spot::twa_graph_ptr
-  complement_semidet_onthefly(const spot::const_twa_graph_ptr &aut, bool show_names = false);
+  complement_semidet_onthefly(const spot::const_twa_graph_ptr &aut, bool show_names = false, budget *limits = nullptr);
 
   spot::twa_graph_ptr
-  complement_semidet_opt_onthefly(const spot::const_twa_graph_ptr &aut, bool show_names = false);
+  complement_semidet_opt_onthefly(const spot::const_twa_graph_ptr &aut, bool show_names = false, budget *limits = nullptr);
+
+  /// \brief Complement a semideterministic TωA with lazy NCSB
+  ///
+  /// The safe states are only guessed once the breakpoint B' is known, and
+  /// then as in NCSB-MaxRank: either no state or all the states of B' move
+  /// to S', so a macrostate has at most two successors per letter.
+  spot::twa_graph_ptr
+  complement_semidet_lazy(const spot::const_twa_graph_ptr &aut, bool show_names = false, budget *limits = nullptr);
 
   /// \brief Complement a unambiguous TωA
   ///
@@ -79,7 +110,7 @@ namespace cola
   ///
   /// Uses the NCSB algorithm described by Y. Li, M.Y. Vardi, and L. Zhang (GandALF'20)
   spot::twa_graph_ptr
-  complement_unambiguous(const spot::const_twa_graph_ptr &aut, bool show_names = false);
+  complement_unambiguous(const spot::const_twa_graph_ptr &aut, bool show_names = false, budget *limits = nullptr);
 
   /// \brief Complement a semideterministic TωA
   ///
@@ -87,25 +118,72 @@ namespace cola
   ///
   /// Uses the NCB algorithm described by Y. Li
   spot::twa_graph_ptr
-  new_complement_semidet(const spot::const_twa_graph_ptr &aut, bool show_names = false);
+  new_complement_semidet(const spot::const_twa_graph_ptr &aut, bool show_names = false, budget *limits = nullptr);
 
   /// \brief Complementation
   ///
   /// The automaton \a aut should be an elevator automaton for now.
   /// Output a generalized Buchi automaton
   spot::twa_graph_ptr
-  complement_tnba(const spot::const_twa_graph_ptr &aut, spot::option_map &om);
+  complement_tnba(const spot::const_twa_graph_ptr &aut, spot::option_map &om, budget *limits = nullptr);
+
+  // the same on an automaton that has already been analysed
+  spot::twa_graph_ptr
+  complement_tnba(analysis &ctx, spot::option_map &om, budget *limits = nullptr);
+
+  /// \brief Complementation on the fly
+  ///
+  /// The same construction as complement_tnba(), but the states of the
+  /// generalized Buchi complement are only built when they are explored,
+  /// e.g., by an emptiness check of a product with the complement.
+  spot::twa_ptr
+  complement_tnba_onthefly(const spot::const_twa_graph_ptr &aut, spot::option_map &om);
+
+  // whether the macrostate s of comp, built by complement_tnba_onthefly(),
+  // accepts a subset of the words of t
+  bool
+  complement_tnba_included(const spot::const_twa_ptr &comp, const spot::state *s, const spot::state *t);
+
+  /// \brief Language inclusion L(A) ⊆ L(B)
+  ///
+  /// Explores the product of \a A with the complement of \a B on the fly and
+  /// stops at the first accepting cycle. A product state is pruned once a
+  /// state without accepting runs subsumes it, i.e., its state of \a A is
+  /// simulated and its macrostate accepts fewer words.
+  /// If the inclusion does not hold, a word of L(A) \ L(B) is stored in
+  /// \a counterexample.
+  bool
+  contains(const spot::const_twa_graph_ptr &A, const spot::const_twa_graph_ptr &B, spot::option_map &om
+  , spot::twa_word_ptr *counterexample = nullptr, budget *limits = nullptr);
+
+  /// \brief Universality L(A) = Σ^ω
+  ///
+  /// Looks for a word accepted by the complement of \a A, explored on the
+  /// fly as in contains(). With USE_SIMULATION, a macrostate is also
+  /// subsumed by one that tracks runs from simulating states.
+  /// If \a A is not universal, a rejected word is stored in \a counterexample.
+  bool
+  is_universal(const spot::const_twa_graph_ptr &A, spot::option_map &om
+  , spot::twa_word_ptr *counterexample = nullptr, budget *limits = nullptr);
 
 
   spot::twa_graph_ptr
-  determinize_twba(const spot::const_twa_graph_ptr &aut, spot::option_map &om);
+  determinize_twba(const spot::const_twa_graph_ptr &aut, spot::option_map &om, budget *limits = nullptr);
+
+  // the same on an automaton that has already been analysed
+  spot::twa_graph_ptr
+  determinize_twba(analysis &ctx, spot::option_map &om, budget *limits = nullptr);
 
   /// \brief Determinizing semi-deterministic or limit deterministic or elevator Buchi automaton
   ///
   /// The automaton \a aut should be a semideterminisitc.
   /// Output a deterministic parity automaton
   spot::twa_graph_ptr
-  determinize_tldba(const spot::const_twa_graph_ptr &aut, spot::option_map &om);
+  determinize_tldba(const spot::const_twa_graph_ptr &aut, spot::option_map &om, budget *limits = nullptr);
+
+  // the same on an automaton that has already been analysed
+  spot::twa_graph_ptr
+  determinize_tldba(analysis &ctx, spot::option_map &om, budget *limits = nullptr);
 
   /// \brief Determinizing TBA by combining the semi-determinization of TBA
   /// and the determinization of TLDBA
@@ -119,8 +197,14 @@ namespace cola
   ///
   /// The automaton \a aut should have Buchi condition.
   /// Output a deterministic Emenson-Lei automaton
+  /// Throws budget_exceeded if the construction runs out of \a limits
+  /// (by default the limits are taken from \a om)
   spot::twa_graph_ptr
-  determinize_tnba(const spot::const_twa_graph_ptr &aut, spot::option_map &om);
+  determinize_tnba(const spot::const_twa_graph_ptr &aut, spot::option_map &om, budget *limits = nullptr);
+
+  // the same on an automaton that has already been analysed
+  spot::twa_graph_ptr
+  determinize_tnba(analysis &ctx, spot::option_map &om, budget *limits = nullptr);
 
 
   /// \brief Determinizing elevator Buchi automaton that has either deterministic or weak SCCs
@@ -128,7 +212,32 @@ namespace cola
   /// The automaton \a aut should be an elevator automaton.
   /// Output a deterministic automaton
   spot::twa_graph_ptr
-  determinize_televator(const spot::const_twa_graph_ptr &aut, spot::option_map &om);
+  determinize_televator(const spot::const_twa_graph_ptr &aut, spot::option_map &om, budget *limits = nullptr);
+
+  // the same on an automaton that has already been analysed
+  spot::twa_graph_ptr
+  determinize_televator(analysis &ctx, spot::option_map &om, budget *limits = nullptr);
+
+  /// \brief Postprocess a deterministic automaton SCC by SCC
+  ///
+  /// Cleans up the acceptance condition, compacts the colors of each SCC
+  /// of a parity automaton and merges bisimilar states inside each SCC,
+  /// starting from the bottom SCCs. Once POST_TIME_LIMIT milliseconds have
+  /// passed, the remaining SCCs are left as they are.
+  spot::twa_graph_ptr
+  postprocess_sccs(const spot::twa_graph_ptr &aut, spot::option_map &om);
+
+  /// \brief Quotient of a deterministic automaton by bisimulation
+  ///
+  /// States are merged if they move to merged states with the same colors
+  /// on every letter class, the coarsest partition of the letters that
+  /// refines all guards. Each edge becomes one transition per letter class
+  /// of its guard, so the partition refinement of Valmari runs in
+  /// O(m k log n) for m edges and k letter classes, after computing the
+  /// classes with O(g k) BDD operations for the g distinct guards.
+  /// Nondeterministic automata are returned as they are.
+  spot::twa_graph_ptr
+  bisimulation_quotient(const spot::twa_graph_ptr &aut, spot::option_map &om);
 
 
   // ============================ helper functions ===================================
@@ -17,10 +17,12 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "optimizer.hpp"
+#include "budget.hpp"
 //#include "struct.hpp"
 
 #include <deque>
 #include <map>
+#include <unordered_map>
 
 #include <spot/misc/hashfunc.hh>
 #include <spot/twaalgos/isdet.hh>
@@ -50,54 +52,150 @@
 // contributed back to Spot in the future.
 namespace from_spot
 {
-        class ncsb_complementation
-                {
-                private:
-                    // The source automaton.
-                    const spot::const_twa_graph_ptr aut_;
+        // The part shared by the NCSB, NCB and NSBC complementations. A
+        // macrostate gives a Label to each state of the source automaton,
+        // Missing to the states that are not in it, and is numbered in the
+        // complement by the list of its other states.
+        template <typename Label, Label Missing, typename Hash>
+        class macrostate_complementation
+        {
+        protected:
+            typedef std::vector<Label> macro_t;
+            typedef std::vector<std::pair<unsigned, Label>> small_t;
 
-                    // SCCs information of the source automaton.
-                    spot::scc_info si_;
+            // The source automaton.
+            const spot::const_twa_graph_ptr aut_;
 
-                    // Number of states in the input automaton.
-                    unsigned nb_states_;
+            // SCCs information of the source automaton.
+            spot::scc_info si_;
 
-                    // The complement being built.
-                    spot::twa_graph_ptr res_;
+            // Number of states in the input automaton.
+            unsigned nb_states_;
 
-                    // Association between NCSB states and state numbers of the
-                    // complement.
-                    std::unordered_map<small_mstate, unsigned, small_mstate_hash> ncsb2n_;
+            // The complement being built.
+            spot::twa_graph_ptr res_;
 
-                    // States to process.
-                    std::deque<std::pair<mstate, unsigned>> todo_;
+            // Association between macrostates and state numbers of the
+            // complement.
+            std::unordered_map<small_t, unsigned, Hash> mstate2n_;
 
-                    // Support for each state of the source automaton.
-                    std::vector<bdd> support_;
+            // States to process.
+            std::deque<std::pair<macro_t, unsigned>> todo_;
 
-                    // Propositions compatible with all transitions of a state.
-                    std::vector<bdd> compat_;
+            // Support for each state of the source automaton.
+            std::vector<bdd> support_;
 
-                    // Whether a SCC is deterministic or not
-                    std::vector<bool> is_deter_;
+            // Propositions compatible with all transitions of a state.
+            std::vector<bdd> compat_;
 
-                    // Whether a state only has accepting transitions
-                    std::vector<bool> is_accepting_;
+            // Whether a SCC is deterministic or not
+            std::vector<bool> is_deter_;
 
-                    // State names for graphviz display
-                    std::vector<std::string>* names_;
+            // Whether a state only has accepting transitions
+            std::vector<bool> is_accepting_;
 
-                    // Show NCSB states in state name to help debug
-                    bool show_names_;
+            // State names for graphviz display
+            std::vector<std::string>* names_ = nullptr;
+
+            // Show the macrostates in state name to help debug
+            bool show_names_;
+
+            // limits on the number of states, time and memory
+            cola::budget &budget_;
+
+            virtual std::string
+            get_name(const small_t& ms) = 0;
+
+            small_t
+            to_small(const macro_t& ms)
+            {
+              unsigned count = 0;
+              for (unsigned i = 0; i < nb_states_; ++i)
+                count += (ms[i] != Missing);
+              small_t small;
+              small.reserve(count);
+              for (unsigned i = 0; i < nb_states_; ++i)
+                if (ms[i] != Missing)
+                  small.emplace_back(i, ms[i]);
+              return small;
+            }
 
+            // From a macrostate, looks for a duplicate in the map before
+            // creating a new state if needed.
+            unsigned
+            new_state(macro_t&& s)
+            {
+              auto p = mstate2n_.emplace(to_small(s), 0);
+              if (p.second) // This is a new state
+              {
+                p.first->second = res_->new_state();
+                if (show_names_)
+                  names_->push_back(get_name(p.first->first));
+                todo_.emplace_back(std::move(s), p.first->second);
+              }
+              return p.first->second;
+            }
+
+            macrostate_complementation(const spot::const_twa_graph_ptr& aut, bool show_names, cola::budget &limits)
+                    : aut_(aut),
+                      si_(aut),
+                      nb_states_(aut->num_states()),
+                      support_(nb_states_),
+                      compat_(nb_states_),
+                      is_accepting_(nb_states_),
+                      show_names_(show_names),
+                      budget_(limits)
+            {
+              res_ = spot::make_twa_graph(aut->get_dict());
+              res_->copy_ap_of(aut);
+              res_->set_buchi();
+
+              // Generate bdd supports and compatible options for each state.
+              // Also check if all its transitions are accepting.
+              for (unsigned i = 0; i < nb_states_; ++i)
+              {
+                bdd res_support = bddtrue;
+                bdd res_compat = bddfalse;
+                bool accepting = true;
+                bool has_transitions = false;
+                for (const auto& out: aut->out(i))
+                {
+                  has_transitions = true;
+                  res_support &= bdd_support(out.cond);
+                  res_compat |= out.cond;
+                  if (!out.acc)
+                    accepting = false;
+                }
+                support_[i] = res_support;
+                compat_[i] = res_compat;
+                is_accepting_[i] = accepting && has_transitions;
+              }
+
+              if (show_names_)
+              {
+                names_ = new std::vector<std::string>();
+                res_->set_named_prop("state-names", names_);
+              }
+            }
+
+        public:
+            virtual ~macrostate_complementation() = default;
+        };
+
+        class ncsb_complementation : public macrostate_complementation<ncsb, ncsb_m, small_mstate_hash>
+                {
+                private:
                     // opt 
                     bool optb_;
 
                     // on the fly
                     bool onthefly;
 
+                    // guess the safe states only when B' is computed, see lazy_successors()
+                    bool lazy_;
+
                     std::string
-                    get_name(const small_mstate& ms)
+                    get_name(const small_mstate& ms) override
                     {
                       std::string res = "{";
 
@@ -150,34 +248,53 @@ namespace from_spot
                       return res + "}";
                     }
 
-                    small_mstate
-                    to_small_mstate(const mstate& ms)
+                    // The MaxRank variant of NCSB (Havlena and Lengal, CONCUR'21):
+                    // no state is moved to S' before B' is known, and then either
+                    // none or all the states of B' are moved at once, so there are
+                    // at most two successors instead of one per subset of C'.
+                    void
+                    lazy_successors(mstate&& succ, unsigned origin, bdd letter)
                     {
-                      unsigned count = 0;
+                      bool b_empty = true;
+                      bool b_accepting = false;
                       for (unsigned i = 0; i < nb_states_; ++i)
-                        count+= (ms[i] != ncsb_m);
-                      small_mstate small;
-                      small.reserve(count);
-                      for (unsigned i = 0; i < nb_states_; ++i)
-                        if (ms[i] != ncsb_m)
-                          small.emplace_back(i, ms[i]);
-                      return small;
-                    }
+                      {
+                        if (succ[i] != ncsb_cb)
+                          continue;
+                        b_empty = false;
+                        if (is_accepting_[i])
+                          b_accepting = true;
+                      }
 
-                    // From a NCSB state, looks for a duplicate in the map before
-                    // creating a new state if needed.
-                    unsigned
-                    new_state(mstate&& s)
-                    {
-                      auto p = ncsb2n_.emplace(to_small_mstate(s), 0);
-                      if (p.second) // This is a new state
+                      if (b_empty)
+                      {
+                        // breakpoint, check C' again
+                        for (unsigned i = 0; i < nb_states_; ++i)
+                          if (succ[i] == ncsb_c)
+                            succ[i] = ncsb_cb;
+                        unsigned dst = new_state(std::move(succ));
+                        res_->new_edge(origin, dst, letter, {0});
+                        return;
+                      }
+
+                      // the runs in B' will not visit accepting transitions any more,
+                      // impossible if one of them is in an accepting state
+                      if (!b_accepting)
                       {
-                        p.first->second = res_->new_state();
-                        if (show_names_)
-                          names_->push_back(get_name(p.first->first));
-                        todo_.emplace_back(std::move(s), p.first->second);
+                        mstate safe(succ);
+                        for (unsigned i = 0; i < nb_states_; ++i)
+                        {
+                          if (safe[i] == ncsb_cb)
+                            safe[i] = ncsb_s;
+                          else if (safe[i] == ncsb_c)
+                            safe[i] = ncsb_cb;
+                        }
+                        unsigned dst = new_state(std::move(safe));
+                        res_->new_edge(origin, dst, letter, {0});
                       }
-                      return p.first->second;
+
+                      unsigned dst = new_state(std::move(succ));
+                      res_->new_edge(origin, dst, letter);
                     }
 
                     void
@@ -332,6 +449,12 @@ namespace from_spot
                           return;
                       }
 
+                      if (lazy_)
+                      {
+                        lazy_successors(std::move(succs[0]), origin, letter);
+                        return;
+                      }
+
                       // Allow to move accepting dst to S'
                       for (unsigned i = 0; i < nb_states_; ++i)
                       {
@@ -465,49 +588,13 @@ namespace from_spot
                     }
 
                 public:
-                    ncsb_complementation(const spot::const_twa_graph_ptr& aut, bool show_names)
-                            : aut_(aut),
-                              si_(aut),
-                              nb_states_(aut->num_states()),
-                              support_(nb_states_),
-                              compat_(nb_states_),
-                              is_accepting_(nb_states_),
-                              show_names_(show_names)
+                    ncsb_complementation(const spot::const_twa_graph_ptr& aut, bool show_names, cola::budget &limits)
+                            : macrostate_complementation(aut, show_names, limits)
                     {
-                      res_ = spot::make_twa_graph(aut->get_dict());
-                      res_->copy_ap_of(aut);
-                      res_->set_buchi();
-
-                      // Generate bdd supports and compatible options for each state.
-                      // Also check if all its transitions are accepting.
-                      for (unsigned i = 0; i < nb_states_; ++i)
-                      {
-                        bdd res_support = bddtrue;
-                        bdd res_compat = bddfalse;
-                        bool accepting = true;
-                        bool has_transitions = false;
-                        for (const auto& out: aut->out(i))
-                        {
-                          has_transitions = true;
-                          res_support &= bdd_support(out.cond);
-                          res_compat |= out.cond;
-                          if (!out.acc)
-                            accepting = false;
-                        }
-                        support_[i] = res_support;
-                        compat_[i] = res_compat;
-                        is_accepting_[i] = accepting && has_transitions;
-                      }
-
                       optb_ = false;
+                      lazy_ = false;
                       onthefly = false;
 
-                      if (show_names_)
-                      {
-                        names_ = new std::vector<std::string>();
-                        res_->set_named_prop("state-names", names_);
-                      }
-
                       // Because we only handle one initial state, we assume it
                       // belongs to the N set. (otherwise the automaton would be
                       // deterministic)
@@ -517,6 +604,11 @@ namespace from_spot
                       res_->set_init_state(new_state(std::move(new_init_state)));
                     }
 
+                    void set_lazy()
+                    {
+                      lazy_ = true;
+                    }
+
                     void set_opt() 
                     {
                       optb_ = true;
@@ -585,6 +677,7 @@ namespace from_spot
                         {
                           bdd one = bdd_satoneset(all, msupport, bddfalse);
                           all -= one;
+                          budget_.check(res_->num_states(), todo_.size());
 
                           // Compute all new states available from the generated
                           // letter.
@@ -598,12 +691,12 @@ namespace from_spot
                 };
 
     spot::twa_graph_ptr
-    complement_semidet(const spot::const_twa_graph_ptr& aut, bool show_names)
+    complement_semidet(const spot::const_twa_graph_ptr& aut, bool show_names, cola::budget &limits)
     {
       if (!is_semi_deterministic(aut))
         throw std::runtime_error
                 ("complement_semidet() requires a semi-deterministic input");
-      auto ncsb = ncsb_complementation(aut, show_names);
+      auto ncsb = ncsb_complementation(aut, show_names, limits);
       return ncsb.run();
     }
 
@@ -613,49 +706,11 @@ namespace cola
 {
 
      // fengwz
-        class ncb_complementation
+        class ncb_complementation : public from_spot::macrostate_complementation<ncb, ncb_m, small_macrostate_hash>
         {
         private:
-            // The source automaton.
-            const spot::const_twa_graph_ptr aut_;
-
-            // SCCs information of the source automaton.
-            spot::scc_info si_;
-
-            // Number of states in the input automaton.
-            unsigned nb_states_;
-
-            // The complement being built.
-            spot::twa_graph_ptr res_;
-
-            // Association between NCB states and state numbers of the
-            // complement.
-            std::unordered_map<small_macrostate, unsigned, small_macrostate_hash> ncb2n_;
-            // std::unordered_map<macrostate, unsigned, small_macrostate_hash> ncb2n_;
-
-            // States to process.
-            std::deque<std::pair<macrostate, unsigned>> todo_;
-
-            // Support for each state of the source automaton.
-            std::vector<bdd> support_;
-
-            // Propositions compatible with all transitions of a state.
-            std::vector<bdd> compat_;
-
-            // Whether a SCC is deterministic or not
-            std::vector<bool> is_deter_;
-
-            // Whether a state only has accepting transitions
-            std::vector<bool> is_accepting_;
-
-            // State names for graphviz display
-            std::vector<std::string>* names_;
-
-            // Show NCB states in state name to help debug
-            bool show_names_;
-            
             std::string
-            get_name(const small_macrostate& ms)
+            get_name(const small_macrostate& ms) override
             {
               std::string res = "{";
 
@@ -699,43 +754,6 @@ namespace cola
               return res + "}";
             }
 
-            // delete unreachable states (ncb = ncb_m)
-            small_macrostate
-            to_small_macrostate(const macrostate& ms)
-            {
-              unsigned count = 0;
-              for (unsigned i = 0; i < nb_states_; ++i)
-              {
-                count+= (ms[i] != ncb_m);
-              }
-              small_macrostate small;
-              small.reserve(count);
-              for (unsigned i = 0; i < nb_states_; ++i)
-              {
-                if (ms[i] != ncb_m)
-                  small.emplace_back(i, ms[i]);
-              }
-              return small;
-            }
-
-            // input a NCB state
-            // return unsigned 
-            // looks for a duplicate in the map before creating a new state if needed.
-            unsigned
-            new_state(macrostate&& s)
-            {
-              // <small_macrostate, unsigned>
-              auto p = ncb2n_.emplace(to_small_macrostate(s), 0);
-              if (p.second) // This is a new state
-              {
-                p.first->second = res_->new_state();
-                if (show_names_)
-                  names_->push_back(get_name(p.first->first));
-                todo_.emplace_back(std::move(s), p.first->second);
-              }
-              return p.first->second;
-            }
-
             // accepting phase: (n,c,b) to (n,c,b)
             void
             acc_successors(macrostate&& ms, unsigned origin, bdd letter)
@@ -916,51 +934,12 @@ namespace cola
            
 
         public:
-            ncb_complementation(const spot::const_twa_graph_ptr& aut, bool show_names)
-                    : aut_(aut),
-                      si_(aut),
-                      nb_states_(aut->num_states()),
-                      support_(nb_states_),
-                      compat_(nb_states_),
-                      is_accepting_(nb_states_),
-                      show_names_(show_names)
+            ncb_complementation(const spot::const_twa_graph_ptr& aut, bool show_names, cola::budget &limits)
+                    : macrostate_complementation(aut, show_names, limits)
             {
-              res_ = spot::make_twa_graph(aut->get_dict());
-              res_->copy_ap_of(aut);
-              res_->set_buchi();
-
-              // Generate bdd supports and compatible options for each state.
-              // Also check if all its transitions are accepting.
-              for (unsigned i = 0; i < nb_states_; ++i)
-              {
-                bdd res_support = bddtrue;
-                bdd res_compat = bddfalse;
-                bool accepting = true;
-                bool has_transitions = false;
-                for (const auto& out: aut->out(i))
-                {
-                  has_transitions = true;
-                  res_support &= bdd_support(out.cond);
-                  res_compat |= out.cond;
-                  if (!out.acc)
-                    accepting = false;
-                }
-                support_[i] = res_support;
-                compat_[i] = res_compat;
-                is_accepting_[i] = accepting && has_transitions;
-              }
-
-
-
               // // Compute which SCCs are part of the deterministic set.
               // is_deter_ = spot::semidet_sccs(si_);
 
-              if (show_names_)
-              {
-                names_ = new std::vector<std::string>();
-                res_->set_named_prop("state-names", names_);
-              }
-
               // Because we only handle one initial state, we assume it
               // belongs to the N set. (otherwise the automaton would be
               // deterministic)
@@ -1015,6 +994,7 @@ namespace cola
                 {
                   bdd one = bdd_satoneset(all, msupport, bddfalse);
                   all -= one;
+                  budget_.check(res_->num_states(), todo_.size());
 
                   // Compute all new states available from the generated letter.
                   ncb_successors(std::move(ms), top.second, one);
@@ -1026,48 +1006,11 @@ namespace cola
             }
         };
 
-        class nsbc_complementation
+        class nsbc_complementation : public from_spot::macrostate_complementation<nsbc, nsbc_m, small_mcstate_hash>
         {
         private:
-            // The source automaton.
-            const spot::const_twa_graph_ptr aut_;
-
-            // SCCs information of the source automaton.
-            spot::scc_info si_;
-
-            // Number of states in the input automaton.
-            unsigned nb_states_;
-
-            // The complement being built.
-            spot::twa_graph_ptr res_;
-
-            // Association between NCSB states and state numbers of the
-            // complement.
-            std::unordered_map<small_mcstate, unsigned, small_mcstate_hash> nsbc2n_;
-
-            // States to process.
-            std::deque<std::pair<mcstate, unsigned>> todo_;
-
-            // Support for each state of the source automaton.
-            std::vector<bdd> support_;
-
-            // Propositions compatible with all transitions of a state.
-            std::vector<bdd> compat_;
-
-            // Whether a SCC is deterministic or not
-            std::vector<bool> is_deter_;
-
-            // Whether a state only has accepting transitions
-            std::vector<bool> is_accepting_;
-
-            // State names for graphviz display
-            std::vector<std::string>* names_;
-
-            // Show NCSB states in state name to help debug
-            bool show_names_;
-
             std::string
-            get_name(const small_mcstate& ms)
+            get_name(const small_mcstate& ms) override
             {
               std::string res = "{";
 
@@ -1137,36 +1080,6 @@ namespace cola
               return res + "}";
             }
 
-            small_mcstate
-            to_small_mcstate(const mcstate& ms)
-            {
-              unsigned count = 0;
-              for (unsigned i = 0; i < nb_states_; ++i)
-                count+= (ms[i] != nsbc_m);
-              small_mcstate small;
-              small.reserve(count);
-              for (unsigned i = 0; i < nb_states_; ++i)
-                if (ms[i] != nsbc_m)
-                  small.emplace_back(i, ms[i]);
-              return small;
-            }
-
-            // looks for a duplicate in the map before
-            // creating a new state if needed.
-            unsigned
-            new_state(mcstate&& s)
-            {
-              auto p = nsbc2n_.emplace(to_small_mcstate(s), 0);
-              if (p.second) // This is a new state
-              {
-                p.first->second = res_->new_state();
-                if (show_names_)
-                  names_->push_back(get_name(p.first->first));
-                todo_.emplace_back(std::move(s), p.first->second);
-              }
-              return p.first->second;
-            }
-
             void
             acc_successors(mcstate&& ms, unsigned origin, bdd letter)
             {
@@ -1381,52 +1294,12 @@ namespace cola
             }
 
         public:
-            nsbc_complementation(const spot::const_twa_graph_ptr& aut, bool show_names)
-                    : aut_(aut),
-                      si_(aut),
-                      nb_states_(aut->num_states()),
-                      support_(nb_states_),
-                      compat_(nb_states_),
-                      is_accepting_(nb_states_),
-                      show_names_(show_names)
+            nsbc_complementation(const spot::const_twa_graph_ptr& aut, bool show_names, cola::budget &limits)
+                    : macrostate_complementation(aut, show_names, limits)
             {
-              res_ = spot::make_twa_graph(aut->get_dict());
-              res_->copy_ap_of(aut);
-              res_->set_buchi();
-
-              // Generate bdd supports and compatible options for each state.
-              // Also check if all its transitions are accepting.
-              for (unsigned i = 0; i < nb_states_; ++i)
-              {
-                bdd res_support = bddtrue;
-                bdd res_compat = bddfalse;
-                
-                bool accepting = true;
-                bool has_transitions = false;
-                for (const auto& out: aut->out(i))
-                {
-                  has_transitions = true;
-                  res_support &= bdd_support(out.cond);
-                  res_compat |= out.cond;
-                  if (!out.acc)
-                    accepting = false;
-                }
-                support_[i] = res_support;
-                compat_[i] = res_compat;
-                is_accepting_[i] = accepting && has_transitions;
-              }
-
-
-
               // Compute which SCCs are part of the deterministic set.
               is_deter_ = spot::semidet_sccs(si_);
 
-              if (show_names_)
-              {
-                names_ = new std::vector<std::string>();
-                res_->set_named_prop("state-names", names_);
-              }
-
               // Because we only handle one initial state, we assume it
               // belongs to the N set. (otherwise the automaton would be
               // deterministic)
@@ -1479,6 +1352,7 @@ namespace cola
                 {
                   bdd one = bdd_satoneset(all, msupport, bddfalse);
                   all -= one;
+                  budget_.check(res_->num_states(), todo_.size());
 
                   // Compute all new states available from the generated letter.
                   nsbc_successors(std::move(ms), top.second, one);
@@ -1495,61 +1369,84 @@ namespace cola
 
 
     spot::twa_graph_ptr
-    complement_semidet_onthefly(const spot::const_twa_graph_ptr& aut, bool show_names)
+    complement_semidet_onthefly(const spot::const_twa_graph_ptr& aut, bool show_names, budget *limits)
     {
       if (!is_semi_deterministic(aut))
         throw std::runtime_error
                 ("complement_semidet() requires a semi-deterministic input");
-      auto ncsb = from_spot::ncsb_complementation(aut, show_names);
+      spot::option_map om;
+      budget local_limits(om);
+      auto ncsb = from_spot::ncsb_complementation(aut, show_names, limits ? *limits : local_limits);
       ncsb.set_onthefly();
       return ncsb.run();
     }
 
     spot::twa_graph_ptr
-    complement_semidet_opt(const spot::const_twa_graph_ptr& aut, bool show_names)
+    complement_semidet_opt(const spot::const_twa_graph_ptr& aut, bool show_names, budget *limits)
     {
       if (!is_semi_deterministic(aut))
         throw std::runtime_error
                 ("complement_semidet() requires a semi-deterministic input");
-      auto ncsb = from_spot::ncsb_complementation(aut, show_names);
+      spot::option_map om;
+      budget local_limits(om);
+      auto ncsb = from_spot::ncsb_complementation(aut, show_names, limits ? *limits : local_limits);
       ncsb.set_opt();
       return ncsb.run();
     }
 
     spot::twa_graph_ptr
-    complement_semidet_opt_onthefly(const spot::const_twa_graph_ptr& aut, bool show_names)
+    complement_semidet_opt_onthefly(const spot::const_twa_graph_ptr& aut, bool show_names, budget *limits)
     {
       if (!is_semi_deterministic(aut))
         throw std::runtime_error
                 ("complement_semidet() requires a semi-deterministic input");
-      auto ncsb = from_spot::ncsb_complementation(aut, show_names);
+      spot::option_map om;
+      budget local_limits(om);
+      auto ncsb = from_spot::ncsb_complementation(aut, show_names, limits ? *limits : local_limits);
       ncsb.set_opt();
       ncsb.set_onthefly();
       return ncsb.run();
     }
 
 
+    spot::twa_graph_ptr
+    complement_semidet_lazy(const spot::const_twa_graph_ptr& aut, bool show_names, budget *limits)
+    {
+      if (!is_semi_deterministic(aut))
+        throw std::runtime_error
+                ("complement_semidet() requires a semi-deterministic input");
+      spot::option_map om;
+      budget local_limits(om);
+      auto ncsb = from_spot::ncsb_complementation(aut, show_names, limits ? *limits : local_limits);
+      ncsb.set_lazy();
+      return ncsb.run();
+    }
+
     // fengwz
     spot::twa_graph_ptr
-    complement_unambiguous(const spot::const_twa_graph_ptr &aut, bool show_names)
+    complement_unambiguous(const spot::const_twa_graph_ptr &aut, bool show_names, budget *limits)
     {
       if (!is_unambiguous(aut))
         throw std::runtime_error
                 ("complement_unambiguous() requires an unambiguous input");
 
-      auto ncb = ncb_complementation(aut, show_names);
+      spot::option_map om;
+      budget local_limits(om);
+      auto ncb = ncb_complementation(aut, show_names, limits ? *limits : local_limits);
       return ncb.run();
     }
 
     // new complement_semidet
     spot::twa_graph_ptr
-    new_complement_semidet(const spot::const_twa_graph_ptr& aut, bool show_names)
+    new_complement_semidet(const spot::const_twa_graph_ptr& aut, bool show_names, budget *limits)
     {
       if (!is_semi_deterministic(aut))
         throw std::runtime_error
                 ("complement_semidet() requires a semi-deterministic input");
 
-      auto nsbc = nsbc_complementation(aut, show_names);
+      spot::option_map om;
+      budget local_limits(om);
+      auto nsbc = nsbc_complementation(aut, show_names, limits ? *limits : local_limits);
       return nsbc.run();
     }
 }
@@ -19,12 +19,19 @@
 #include "cola.hpp"
 #include "simulation.hpp"
 #include "types.hpp"
+#include "hash.hpp"
+#include "budget.hpp"
+#include "analysis.hpp"
+#include "edge_group.hpp"
 //#include "struct.hpp"
 
+#include <algorithm>
 #include <deque>
 #include <map>
+#include <memory>
 #include <set>
 
+#include <spot/misc/casts.hh>
 #include <spot/misc/hashfunc.hh>
 #include <spot/twaalgos/isdet.hh>
 #include <spot/twaalgos/sccinfo.hh>
@@ -80,11 +87,22 @@ namespace cola
       this->detscc_index_ = other.detscc_index_;
 
       this->nondetscc_ranks_ = other.nondetscc_ranks_; // copy
+      this->reach_ = other.reach_;
+      this->frozen_ = other.frozen_;
     }
 
     std::set<unsigned>
     get_reach_set() const;
 
+    // the states of the macrostate in increasing order
+    const std::vector<unsigned> &
+    get_reach() const;
+
+    // keep the result of get_reach() from now on, the macrostate must not
+    // change afterwards
+    void
+    freeze();
+
     std::set<unsigned>
     get_weak_set() const;
 
@@ -95,6 +113,10 @@ namespace cola
     bool operator<(const complement_mstate &other) const;
     bool operator==(const complement_mstate &other) const;
 
+    // whether every word accepted from this macrostate is accepted from other,
+    // a weak state of other may be simulated by one here if sim is given
+    bool included_in(const complement_mstate &other, const state_simulator *sim = nullptr) const;
+
     complement_mstate &
     operator=(const complement_mstate &other)
     {
@@ -108,6 +130,8 @@ namespace cola
       this->detscc_index_ = other.detscc_index_;
 
       this->nondetscc_ranks_ = other.nondetscc_ranks_;
+      this->reach_ = other.reach_;
+      this->frozen_ = other.frozen_;
 
       return *this;
     }
@@ -128,6 +152,11 @@ namespace cola
     // breakpoint construction for weak accepting SCCs
     std::set<unsigned> weak_set_;
     std::set<unsigned> break_set_;
+
+  private:
+    // computed by every call to get_reach() until the macrostate is frozen
+    mutable std::vector<unsigned> reach_;
+    bool frozen_ = false;
   };
 
   struct complement_mstate_hash
@@ -150,7 +179,7 @@ namespace cola
         {
             return detscc_ranks_ < other.detscc_ranks_;
         }
-        if (detscc_index_ == other.detscc_index_)
+        if (detscc_index_ != other.detscc_index_)
         {
           return detscc_index_ < other.detscc_index_;
         }
@@ -185,6 +214,11 @@ namespace cola
       {
         return false;
       }
+    // the same ranks may still wait for a different DAC
+    if (detscc_index_ != other.detscc_index_)
+      {
+        return false;
+      }
 
     if (nondetscc_ranks_ != other.nondetscc_ranks_)
       {
@@ -192,6 +226,58 @@ namespace cola
       }
     return true;
   }
+  bool
+  complement_mstate::included_in(const complement_mstate &other, const state_simulator *sim) const
+  {
+    if (detscc_index_ != other.detscc_index_)
+    {
+      return false;
+    }
+    // other has to track fewer runs, so fewer words are rejected there
+    if (sim == nullptr)
+    {
+      if (!std::includes(weak_set_.begin(), weak_set_.end(), other.weak_set_.begin(), other.weak_set_.end()))
+        return false;
+    }
+    else
+    {
+      // a run from a weak state of other is also a run from a state simulating it
+      for (unsigned q : other.weak_set_)
+      {
+        if (weak_set_.find(q) != weak_set_.end())
+          continue;
+        bool simulated = false;
+        for (unsigned p : weak_set_)
+        {
+          if (sim->simulate(p, q))
+          {
+            simulated = true;
+            break;
+          }
+        }
+        if (!simulated)
+          return false;
+      }
+    }
+    if (!std::includes(break_set_.begin(), break_set_.end(), other.break_set_.begin(), other.break_set_.end()))
+    {
+      return false;
+    }
+    // a run in S of other may not visit accepting transitions any more,
+    // so it has to be in S here as well
+    auto it = detscc_ranks_.begin();
+    for (const rank &r : other.detscc_ranks_)
+    {
+      while (it != detscc_ranks_.end() && it->first < r.first)
+        ++it;
+      if (it == detscc_ranks_.end() || it->first != r.first)
+        return false;
+      if (it->second != r.second && it->second != NCSB_S)
+        return false;
+    }
+    return nondetscc_ranks_ == other.nondetscc_ranks_;
+  }
+
   int complement_mstate::get_max_rank() const
   {
     return -1;
@@ -211,6 +297,28 @@ namespace cola
     }
     return result;
   }
+  const std::vector<unsigned> &
+  complement_mstate::get_reach() const
+  {
+    if (frozen_)
+      return reach_;
+    reach_.assign(weak_set_.begin(), weak_set_.end());
+    for (auto &p : detscc_ranks_)
+      reach_.push_back(p.first);
+    for (auto &p : nondetscc_ranks_)
+      reach_.push_back(p.first);
+    std::sort(reach_.begin(), reach_.end());
+    reach_.erase(std::unique(reach_.begin(), reach_.end()), reach_.end());
+    return reach_;
+  }
+
+  void
+  complement_mstate::freeze()
+  {
+    get_reach();
+    reach_.shrink_to_fit();
+    frozen_ = true;
+  }
   bool complement_mstate::is_empty() const
   {
     if (!weak_set_.empty())
@@ -238,29 +346,25 @@ namespace cola
   size_t
   complement_mstate::hash() const
   {
-    size_t res = 0;
-    for (unsigned i : weak_set_)
-    {
-      res = (res << 3) ^ i;
-    }
-    for (unsigned i : break_set_)
-    {
-      res ^= (res << 3) ^ i;
-    }
-    for (auto &p : detscc_ranks_)
-      {
-        res ^= (res << 3) ^ (p.first);
-        res ^= (res << 3) ^ (p.second);
-      }
-    for (auto &p : nondetscc_ranks_)
-      {
-        res ^= (res << 3) ^ (p.first);
-        res ^= (res << 3) ^ (p.second);
-      }
-
+    size_t res = hash_combine(hash_values(weak_set_), hash_values(break_set_));
+    res = hash_combine(res, hash_pairs(detscc_ranks_, detscc_index_));
+    res = hash_combine(res, hash_pairs(nondetscc_ranks_));
     return res;
   }
 
+  // an outgoing transition of a macrostate in the complement
+  struct complement_edge
+  {
+    bdd cond;
+    complement_mstate dst;
+    spot::acc_cond::mark_t acc;
+
+    complement_edge(bdd cond, const complement_mstate &dst, spot::acc_cond::mark_t acc)
+        : cond(cond), dst(dst), acc(acc)
+    {
+    }
+  };
+
   // complementation Buchi automata
   class tnba_complement
   {
@@ -275,7 +379,7 @@ namespace cola
     unsigned nb_states_;
 
     // state_simulator
-    state_simulator simulator_;
+    const state_simulator &simulator_;
 
     // delayed simulation
     delayed_simulation delayed_simulator_;
@@ -283,13 +387,17 @@ namespace cola
     // The parity automata being built.
     spot::twa_graph_ptr res_;
 
-    // the number of indices
-    unsigned sets_ = 0;
+    // the break set of the weak SCCs and the DACs have one set each, the
+    // complement accepts the runs that visit both infinitely often
+    static const unsigned NUM_SETS = 2;
 
     unsigned num_colors_;
 
     spot::option_map &om_;
 
+    // limits on the number of states, time and memory
+    budget &budget_;
+
     // use ambiguous
     bool use_unambiguous_;
 
@@ -308,10 +416,13 @@ namespace cola
     std::deque<std::pair<complement_mstate, unsigned>> todo_;
 
     // Support for each state of the source automaton.
-    std::vector<bdd> support_;
+    const std::vector<bdd> &support_;
 
     // Propositions compatible with all transitions of a state.
-    std::vector<bdd> compat_;
+    const std::vector<bdd> &compat_;
+
+    // support_ and compat_ of the sets of states of the macrostates
+    reach_letters reach_letters_;
 
     // is accepting for states
     std::vector<bool> is_accepting_;
@@ -417,9 +528,10 @@ namespace cola
     // From a Rank state, looks for a duplicate in the map before
     // creating a new state if needed.
     unsigned
-    new_state(complement_mstate &s)
+    new_state(const complement_mstate &s)
     {
       complement_mstate dup(s);
+      dup.freeze();
       auto p = rank2n_.emplace(dup, 0);
       if (p.second) // This is a new state
       {
@@ -806,7 +918,7 @@ namespace cola
     // compute the successor P={nondeterministic states and nonaccepting SCCs} O = {breakpoint for weak SCCs}
     // and labelling states for each SCC
     void
-    compute_successors(const complement_mstate &ms, unsigned origin, bdd letter)
+    compute_successors(const complement_mstate &ms, bdd letter, std::vector<complement_edge> &edges)
     {
       // std::cout << "current state: " << get_name(ms) << " src: " << origin << " letter: " << letter << std::endl;
       complement_mstate succ(si_);
@@ -954,8 +1066,6 @@ namespace cola
         succ.detscc_ranks_ = det_successors[0];
       }
 
-      unsigned dst = new_state(succ);
-
       // std::cout << "First deterministic part = " << get_name(succ) << std::endl;
 
       
@@ -964,16 +1074,14 @@ namespace cola
       if (break_empty)
       {
         acc1.set(0);
-        sets_ = std::max((unsigned)0, sets_);
       }
       // if has no successors or has successors 
       // std::cout << "acc succ: " << det_acc_successors.size() << " det_succ " << det_successors.size() << std::endl;
       if (succ.detscc_ranks_.empty() || det_acc_successors[0] && next_scc_index[0] == 0)
       {
         acc1.set(1);
-        sets_ = std::max((unsigned)1, sets_);
       }
-      res_->new_edge(origin, dst, letter, acc1);
+      edges.emplace_back(letter, succ, acc1);
       
       // whether we need to add another one
       if (det_successors.size() <= 1)
@@ -988,22 +1096,18 @@ namespace cola
       succ1.detscc_ranks_ = det_successors[1];
       // std::cout << "Second deterministic part = " << get_name(succ1) << std::endl;
 
-      dst = new_state(succ1);
-      
       spot::acc_cond::mark_t acc2 = {};
       
       if (break_empty)
       {
         acc2.set(0);
-        sets_ = std::max((unsigned)0, sets_);
       }
       // if acc and index is 0
       if (det_acc_successors[1] && next_scc_index[1] == 0)
       {
         acc2.set(1);
-        sets_ = std::max((unsigned)1, sets_);
       }
-      res_->new_edge(origin, dst, letter, acc2);
+      edges.emplace_back(letter, succ1, acc2);
     
     }
    
@@ -1031,30 +1135,32 @@ namespace cola
     }
 
   public:
-    tnba_complement(const spot::const_twa_graph_ptr &aut, spot::scc_info &si, spot::option_map &om, std::vector<bdd> &implications)
-        : aut_(aut),
+    tnba_complement(analysis &ctx, spot::option_map &om, budget &limits)
+        : aut_(ctx.get_aut()),
           om_(om),
+          budget_(limits),
           use_simulation_(om.get(USE_SIMULATION) > 0),
           use_scc_(om.get(USE_SCC_INFO) > 0),
           use_stutter_(om.get(USE_STUTTER) > 0),
           use_unambiguous_(om.get(USE_UNAMBIGUITY) > 0),
-          si_(si),
-          nb_states_(aut->num_states()),
-          support_(nb_states_),
-          compat_(nb_states_),
-          is_accepting_(aut->num_states(), false),
-          MAX_RANK_(aut->num_states() + 2),
-          simulator_(aut, si, implications, om.get(USE_SIMULATION) > 0),
-          delayed_simulator_(aut, om),
+          si_(ctx.get_scc_info()),
+          nb_states_(aut_->num_states()),
+          support_(ctx.get_support()),
+          compat_(ctx.get_compat()),
+          reach_letters_(support_, compat_),
+          is_accepting_(aut_->num_states(), false),
+          MAX_RANK_(aut_->num_states() + 2),
+          simulator_(ctx.get_simulator()),
+          delayed_simulator_(aut_, om),
           show_names_(om.get(VERBOSE_LEVEL) >= 1)
     {
       if (om.get(VERBOSE_LEVEL) >= 2)
       {
         simulator_.output_simulation();
       }
-      res_ = spot::make_twa_graph(aut->get_dict());
-      res_->copy_ap_of(aut);
-      res_->prop_copy(aut,
+      res_ = spot::make_twa_graph(aut_->get_dict());
+      res_->copy_ap_of(aut_);
+      res_->prop_copy(aut_,
                       {
                           false,        // state based
                           false,        // inherently_weak
@@ -1062,28 +1168,21 @@ namespace cola
                           true,         // complete
                           false         // stutter inv
                       });
-      // Generate bdd supports and compatible options for each state.
-      // Also check if all its transitions are accepting.
+      // Check if all transitions of a state are accepting.
       for (unsigned i = 0; i < nb_states_; ++i)
       {
-        bdd res_support = bddtrue;
-        bdd res_compat = bddfalse;
         bool accepting = true;
         bool has_transitions = false;
-        for (const auto &out : aut->out(i))
+        for (const auto &out : aut_->out(i))
         {
           has_transitions = true;
-          res_support &= bdd_support(out.cond);
-          res_compat |= out.cond;
           if (!out.acc)
             accepting = false;
         }
-        support_[i] = res_support;
-        compat_[i] = res_compat;
         is_accepting_[i] = accepting && has_transitions;
       }
       // obtain the types of each SCC
-      scc_types_ = get_scc_types(si_);
+      scc_types_ = ctx.get_scc_types();
       // std::cout << "scc types : " << scc_types_ << " " << scc_types_.size() << std::endl;
       // find out the DACs and NACs
       for (unsigned i = 0; i < scc_types_.size(); i++)
@@ -1106,15 +1205,19 @@ namespace cola
       }
 
       // optimize with the fact of being unambiguous
-      use_unambiguous_ = use_unambiguous_ && is_unambiguous(aut);
+      use_unambiguous_ = use_unambiguous_ && is_unambiguous(aut_);
       if (show_names_)
       {
         names_ = new std::vector<std::string>();
         res_->set_named_prop("state-names", names_);
       }
+    }
 
-      // we only handle one initial state
-      unsigned init_state = aut->get_init_state_number();
+    // the macrostate of the initial state, we only handle one initial state
+    complement_mstate
+    initial_state()
+    {
+      unsigned init_state = aut_->get_init_state_number();
       complement_mstate new_init_state(si_);
       unsigned init_scc = si_.scc_of(init_state);
       new_init_state.detscc_index_ = 0;
@@ -1138,8 +1241,64 @@ namespace cola
         // new_init_state.nondetscc_labels_[init_scc_index].emplace_back(init_state, 0);
         // new_init_state.nondetscc_breaces_[init_scc_index].emplace_back(RANK_TOP_BRACE);
       }
-      // we assume that the initial state is not in deterministic part
-      res_->set_init_state(new_state(new_init_state));
+      return new_init_state;
+    }
+
+    // the transitions of ms, the rest of the letters go to the empty macrostate
+    void
+    successors(const complement_mstate &ms, std::vector<complement_edge> &edges)
+    {
+      // the occurred variables in the outgoing transitions of ms and the
+      // letters that have some of them
+      const std::pair<bdd, bdd> &letters = reach_letters_.get(ms.get_reach());
+      bdd msupport = letters.first;
+      bdd n_s_compat = letters.second;
+
+      bdd all = n_s_compat;
+      if (all != bddtrue)
+      {
+        // direct the rest to sink state
+        // empty state use 0 as well as the weak ones
+        edges.emplace_back(!all, complement_mstate(si_), spot::acc_cond::mark_t{});
+      }
+      while (all != bddfalse)
+      {
+        bdd letter = bdd_satoneset(all, msupport, bddfalse);
+        all -= letter;
+        // std::cout << "Current state = " << get_name(ms) << " letter = "<< letter << std::endl;
+        // the number of SCCs we care is the accepting det SCCs and the weak SCCs
+        compute_successors(ms, letter, edges);
+      }
+    }
+
+    // the acceptance of the complement, the same explored or on the fly
+    static unsigned
+    num_sets()
+    {
+      return NUM_SETS;
+    }
+
+    // all sets, for the loop of the sink
+    static spot::acc_cond::mark_t
+    all_sets()
+    {
+      spot::acc_cond::mark_t acc = {};
+      for (unsigned c = 0; c < NUM_SETS; c++)
+        acc.set(c);
+      return acc;
+    }
+
+    std::string
+    format_state(const complement_mstate &ms)
+    {
+      return get_name(ms);
+    }
+
+    // whether every word accepted from s is accepted from t
+    bool
+    included(const complement_mstate &s, const complement_mstate &t)
+    {
+      return s.included_in(t, use_simulation_ ? &simulator_ : nullptr);
     }
 
     spot::twa_graph_ptr
@@ -1148,6 +1307,9 @@ namespace cola
       // Main stuff happens here
       // todo_ is a queue for handling states
       unsigned sink = INT_MAX;
+      res_->set_init_state(new_state(initial_state()));
+      std::vector<complement_edge> edges;
+      edge_group<unsigned, spot::acc_cond::mark_t> out;
 
       while (!todo_.empty())
       {
@@ -1155,35 +1317,22 @@ namespace cola
         todo_.pop_front();
         // pop current state, (N, Rnk)
         complement_mstate ms = top.first;
+        budget_.check(res_->num_states(), todo_.size());
 
-        // Compute support of all available states.
-        bdd msupport = bddtrue;
-        bdd n_s_compat = bddfalse;
-        const std::set<unsigned> &reach_set = ms.get_reach_set();
-        // compute the occurred variables in the outgoing transitions of ms, stored in msupport
-        for (unsigned s : reach_set)
-        {
-          msupport &= support_[s];
-          n_s_compat |= compat_[s];
-        }
-
-        bdd all = n_s_compat;
-        if (all != bddtrue)
+        edges.clear();
+        successors(ms, edges);
+        for (auto &e : edges)
         {
-          // direct the rest to sink state
-          complement_mstate succ(si_);
-          sink = new_state(succ);
-          // empty state use 0 as well as the weak ones
-          res_->new_edge(top.second, sink, !all);
+          unsigned dst = new_state(e.dst);
+          if (e.dst.is_empty())
+            sink = dst;
+          out.add(dst, e.acc, e.cond);
         }
-        while (all != bddfalse)
+        // one edge per successor and colors
+        out.flush([&](unsigned dst, spot::acc_cond::mark_t acc, const bdd &cond)
         {
-          bdd letter = bdd_satoneset(all, msupport, bddfalse);
-          all -= letter;
-          // std::cout << "Current state = " << get_name(ms) << " letter = "<< letter << std::endl;
-          // the number of SCCs we care is the accepting det SCCs and the weak SCCs
-          compute_successors(ms, top.second, letter);
-        }
+          res_->new_edge(top.second, dst, cond, acc);
+        });
       }
       // amend the edges
       if (sink < res_->num_states())
@@ -1192,16 +1341,13 @@ namespace cola
         {
           if (t.dst == sink)
           {
-            for (unsigned c = 0; c <= sets_; c ++)
-            {
-              t.acc.set(c);
-            }
+            t.acc = all_sets();
           }
         }
       }
       
       // set up the acceptance
-      res_->set_generalized_buchi(sets_ + 1);
+      res_->set_generalized_buchi(NUM_SETS);
       if (aut_->prop_complete().is_true())
         res_->prop_complete(true);
       // res_->prop_universal(true);
@@ -1231,28 +1377,189 @@ namespace cola
     }
   };
 
-  spot::twa_graph_ptr
-  complement_tnba(const spot::const_twa_graph_ptr &aut, spot::option_map &om)
+  // a macrostate of the on-the-fly complement
+  class complement_state : public spot::state
   {
-    if (!aut->acc().is_buchi() || !is_elevator_automaton(aut))
-      throw std::runtime_error("complement_tnba() requires a Buchi input");
-    const int trans_pruning = om.get(NUM_TRANS_PRUNING);
-    // now we compute the simulator
-    spot::const_twa_graph_ptr aut_reduced;
-    std::vector<bdd> implications;
-    spot::twa_graph_ptr aut_tmp = nullptr;
-    if (om.get(USE_SIMULATION) > 0)
+  public:
+    complement_mstate ms_;
+
+    complement_state(const complement_mstate &ms)
+        : ms_(ms)
     {
-      aut_tmp = spot::scc_filter(aut);
-      auto aut2 = spot::simulation(aut_tmp, &implications, trans_pruning);
-      aut_tmp = aut2;
+      ms_.freeze();
     }
-    if (aut_tmp)
-      aut_reduced = aut_tmp;
-    else
-      aut_reduced = aut;
-    spot::scc_info scc(aut_reduced, spot::scc_info_options::ALL);
-    auto det = cola::tnba_complement(aut_reduced, scc, om, implications);
+
+    int
+    compare(const spot::state *other) const override
+    {
+      const complement_state *o = spot::down_cast<const complement_state *>(other);
+      if (ms_ < o->ms_)
+        return -1;
+      if (o->ms_ < ms_)
+        return 1;
+      return 0;
+    }
+
+    size_t
+    hash() const override
+    {
+      return ms_.hash();
+    }
+
+    complement_state *
+    clone() const override
+    {
+      return new complement_state(ms_);
+    }
+  };
+
+  // iterates over the transitions of a macrostate, computed all at once
+  class complement_succ_iterator : public spot::twa_succ_iterator
+  {
+  private:
+    std::vector<complement_edge> edges_;
+    size_t pos_ = 0;
+
+  public:
+    complement_succ_iterator(std::vector<complement_edge> &&edges)
+        : edges_(std::move(edges))
+    {
+    }
+
+    bool
+    first() override
+    {
+      pos_ = 0;
+      return !edges_.empty();
+    }
+
+    bool
+    next() override
+    {
+      return ++pos_ < edges_.size();
+    }
+
+    bool
+    done() const override
+    {
+      return pos_ >= edges_.size();
+    }
+
+    const spot::state *
+    dst() const override
+    {
+      return new complement_state(edges_[pos_].dst);
+    }
+
+    bdd
+    cond() const override
+    {
+      return edges_[pos_].cond;
+    }
+
+    spot::acc_cond::mark_t
+    acc() const override
+    {
+      return edges_[pos_].acc;
+    }
+  };
+
+  /// \brief The complement of an elevator automaton explored on demand
+  ///
+  /// The successors of a macrostate are only computed when an algorithm,
+  /// e.g., an emptiness check of a product, asks for them.
+  class complement_twa : public spot::twa
+  {
+  private:
+    // keeps the input and its analysis alive
+    std::shared_ptr<analysis> ctx_;
+    spot::option_map om_;
+    mutable budget limits_;
+    // the successors are computed by the same construction as complement_tnba()
+    mutable tnba_complement engine_;
+    // number of macrostates whose successors have been computed
+    mutable unsigned num_explored_ = 0;
+
+  public:
+    complement_twa(const std::shared_ptr<analysis> &ctx, analysis &input, const spot::option_map &om)
+        : spot::twa(ctx->get_aut()->get_dict()),
+          ctx_(ctx),
+          om_(om),
+          limits_(om),
+          engine_(input, om_, limits_)
+    {
+      copy_ap_of(ctx->get_aut());
+      set_generalized_buchi(tnba_complement::num_sets());
+    }
+
+    const spot::state *
+    get_init_state() const override
+    {
+      return new complement_state(engine_.initial_state());
+    }
+
+    spot::twa_succ_iterator *
+    succ_iter(const spot::state *s) const override
+    {
+      const complement_mstate &ms = spot::down_cast<const complement_state *>(s)->ms_;
+      limits_.check(++num_explored_, 0);
+      std::vector<complement_edge> edges;
+      engine_.successors(ms, edges);
+      // the sink accepts every word, so its loop visits every set
+      if (ms.is_empty())
+      {
+        for (auto &e : edges)
+          e.acc = tnba_complement::all_sets();
+      }
+      return new complement_succ_iterator(std::move(edges));
+    }
+
+    std::string
+    format_state(const spot::state *s) const override
+    {
+      return engine_.format_state(spot::down_cast<const complement_state *>(s)->ms_);
+    }
+
+    bool
+    included(const spot::state *s, const spot::state *t) const
+    {
+      return engine_.included(spot::down_cast<const complement_state *>(s)->ms_,
+                              spot::down_cast<const complement_state *>(t)->ms_);
+    }
+  };
+
+  spot::twa_graph_ptr
+  complement_tnba(const spot::const_twa_graph_ptr &aut, spot::option_map &om, budget *limits)
+  {
+    analysis ctx(aut);
+    return complement_tnba(ctx, om, limits);
+  }
+
+  spot::twa_graph_ptr
+  complement_tnba(analysis &ctx, spot::option_map &om, budget *limits)
+  {
+    if (!ctx.get_aut()->acc().is_buchi() || !ctx.is_elevator())
+      throw std::runtime_error("complement_tnba() requires a Buchi input");
+    // the simulator is computed on the reduced automaton
+    analysis &input = om.get(USE_SIMULATION) > 0 ? ctx.get_reduced(om.get(NUM_TRANS_PRUNING)) : ctx;
+    budget local_limits(om);
+    auto det = cola::tnba_complement(input, om, limits ? *limits : local_limits);
     return det.run();
   }
-}
\ No newline at end of file
+
+  spot::twa_ptr
+  complement_tnba_onthefly(const spot::const_twa_graph_ptr &aut, spot::option_map &om)
+  {
+    std::shared_ptr<analysis> ctx = std::make_shared<analysis>(aut);
+    if (!aut->acc().is_buchi() || !ctx->is_elevator())
+      throw std::runtime_error("complement_tnba_onthefly() requires a Buchi input");
+    analysis &input = om.get(USE_SIMULATION) > 0 ? ctx->get_reduced(om.get(NUM_TRANS_PRUNING)) : *ctx;
+    return std::make_shared<complement_twa>(ctx, input, om);
+  }
+
+  bool
+  complement_tnba_included(const spot::const_twa_ptr &comp, const spot::state *s, const spot::state *t)
+  {
+    return spot::down_cast<const complement_twa *>(comp.get())->included(s, t);
+  }
+}
@@ -18,6 +18,7 @@
 #include <vector>
 #include <functional>
 #include <queue>
+#include <algorithm>
 
 #include <spot/twaalgos/sccinfo.hh>
 #include <spot/twaalgos/postproc.hh>
@@ -32,7 +33,15 @@ decomposer::run()
     std::vector<spot::twa_graph_ptr> result;
     spot::scc_info si(nba_, spot::scc_info_options::ALL);
 
-    std::vector<bool> reach_sccs = find_scc_paths(si);
+    // the SCCs with an edge to each SCC, for the backward cones of the pieces
+    scc_preds_.assign(si.scc_count(), std::vector<unsigned>());
+    for (unsigned sc = 0; sc < si.scc_count(); sc ++)
+    {
+        for (unsigned succ : si.succ(sc))
+            scc_preds_[succ].push_back(sc);
+    }
+    in_cone_.assign(si.scc_count(), false);
+    new_state_.assign(nba_->num_states(), NO_STATE);
 
     struct pair_compare
     {
@@ -59,7 +68,7 @@ decomposer::run()
         
         std::set<unsigned> sccs;
         sccs.insert(scc_i);
-        spot::twa_graph_ptr aut = make_twa_with_scc(si, sccs, reach_sccs);
+        spot::twa_graph_ptr aut = make_twa_with_scc(si, sccs);
         result.push_back(aut);
 
         -- num_nbas_;
@@ -78,22 +87,44 @@ decomposer::run()
     }
     if (! remaining_sccs.empty())
     {
-        spot::twa_graph_ptr aut = make_twa_with_scc(si, remaining_sccs, reach_sccs);
+        spot::twa_graph_ptr aut = make_twa_with_scc(si, remaining_sccs);
         result.push_back(aut);
     }
     return result;
 }
 
 spot::twa_graph_ptr
-decomposer::make_twa_with_scc(spot::scc_info& si, std::set<unsigned> sccs, std::vector<bool>& reach_sccs)
+decomposer::make_twa_with_scc(spot::scc_info& si, const std::set<unsigned>& sccs)
 {
     assert(! sccs.empty());
 
-    auto scc_reach = [&si, &reach_sccs](unsigned s, unsigned t) -> bool
+    // the SCCs that can reach one of sccs, marked backwards from them
+    std::vector<unsigned> cone(sccs.begin(), sccs.end());
+    for (unsigned scc : sccs)
+        in_cone_[scc] = true;
+    for (unsigned i = 0; i < cone.size(); i++)
     {
-      return s == t || (reach_sccs[t + si.scc_count() * s]);
-    };
-    
+        for (unsigned pred : scc_preds_[cone[i]])
+        {
+            if (in_cone_[pred]) continue;
+            in_cone_[pred] = true;
+            cone.push_back(pred);
+        }
+    }
+
+    // the states of the cone, renumbered in their original order
+    std::vector<unsigned> states;
+    for (unsigned scc : cone)
+    {
+        in_cone_[scc] = false;
+        const std::vector<unsigned> &scc_states = si.states_of(scc);
+        states.insert(states.end(), scc_states.begin(), scc_states.end());
+    }
+    std::sort(states.begin(), states.end());
+    unsigned num_states = states.size();
+    for (unsigned i = 0; i < num_states; i++)
+        new_state_[states[i]] = i;
+
     // now construct new DPAs
     spot::twa_graph_ptr res = spot::make_twa_graph(nba_->get_dict());
     res->copy_ap_of(nba_);
@@ -102,44 +133,33 @@ decomposer::make_twa_with_scc(spot::scc_info& si, std::set<unsigned> sccs, std::
                        false,        // state based
                        nba_->prop_inherently_weak().is_true(),        // inherently_weak
                        false, false, // deterministic
-                       nba_->prop_complete().is_true(),         // complete
+                       // removed states may leave letters without edges
+                       num_states == nba_->num_states() && nba_->prop_complete().is_true(),         // complete
                        nba_->prop_stutter_invariant().is_true()         // stutter inv
                    });
-    for (unsigned s = 0; s < nba_->num_states(); s++)
-    {
-      res->new_state();
-    }
-    auto is_good_scc = [&scc_reach, &sccs](unsigned scc_i) -> bool
-    {
-        for(auto scc : sccs)
-        {
-            if (scc == scc_i) return true;
-            if (scc_reach(scc_i, scc))
-            {
-                return true;
-            }
-        }
-        return false;
-    };
-    for (auto &t : nba_->edges())
+    res->new_states(num_states);
+    for (unsigned s : states)
     {
-      // out going transition for t.src
-      unsigned scc_src = si.scc_of(t.src);
-      unsigned scc_dst = si.scc_of(t.dst);
-      if (is_good_scc(scc_src) && is_good_scc(scc_dst))
+      for (auto &t : nba_->out(s))
       {
-        //   if(sccs.find(scc_src) != sccs.end() && sccs.find(scc_dst) != sccs.end())
-            res->new_edge(t.src, t.dst, t.cond, t.acc);
+        if (new_state_[t.dst] != NO_STATE)
+          res->new_edge(new_state_[s], new_state_[t.dst], t.cond, t.acc);
       }
     }
-    // names
-    res->set_init_state(nba_->get_init_state_number());
+    // the initial state reaches every SCC of si, so it is in the cone
+    res->set_init_state(new_state_[nba_->get_init_state_number()]);
+    for (unsigned s : states)
+        new_state_[s] = NO_STATE;
     // now acceptance condition
     res->set_buchi();
-    // remove unreachable macrostates
-    spot::postprocessor p;
-    p.set_type(spot::postprocessor::Buchi);
-    res = p.run(res);
+    // every state reaches an accepting SCC of sccs, so the pieces are
+    // already trim, the postprocessor only simplifies them further
+    if (om_.get(DECOMPOSE_POSTPROCESS) > 0)
+    {
+      spot::postprocessor p;
+      p.set_type(spot::postprocessor::Buchi);
+      res = p.run(res);
+    }
     return res;
 }
 
@@ -16,6 +16,7 @@
 
 #include <functional>
 #include <set>
+#include <vector>
 
 #include <spot/twaalgos/hoa.hh>
 #include <spot/misc/optionmap.hh>
@@ -33,8 +34,16 @@ namespace cola
 
         int num_nbas_;
 
+        static constexpr unsigned NO_STATE = -1U;
+        // the SCCs with an edge to each SCC
+        std::vector<std::vector<unsigned>> scc_preds_;
+        // all false and NO_STATE between two pieces, so that a piece only
+        // costs the size of its cone
+        std::vector<bool> in_cone_;
+        std::vector<unsigned> new_state_;
+
         spot::twa_graph_ptr
-        make_twa_with_scc(spot::scc_info& si, std::set<unsigned> sccs, std::vector<bool>& reach_sccs);
+        make_twa_with_scc(spot::scc_info& si, const std::set<unsigned>& sccs);
 
         public:
         decomposer(spot::twa_graph_ptr &nba, spot::option_map& om)
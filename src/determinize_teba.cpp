@@ -17,6 +17,11 @@
 #include "cola.hpp"
 #include "simulation.hpp"
 #include "types.hpp"
+#include "budget.hpp"
+#include "analysis.hpp"
+#include "labelling.hpp"
+#include "hash.hpp"
+#include "edge_group.hpp"
 //#include "struct.hpp"
 
 #include <deque>
@@ -45,8 +50,6 @@
 // elevator automata have only deterministic SCCs and inherently weak SCCs
 namespace cola
 {
-  // state and the labelling value
-  typedef std::pair<unsigned, int> label;
   typedef std::pair<unsigned, bdd> outgoing_trans;
 
   struct outgoing_trans_hash
@@ -74,26 +77,35 @@ namespace cola
   class elevator_mstate
   {
   public:
-    elevator_mstate(spot::scc_info &si, size_t num, int value)
-        : si_(si), ordered_states_(num, value)
+    elevator_mstate(spot::scc_info &si)
+        : si_(si)
     {
     }
 
     elevator_mstate(const elevator_mstate &other)
-        : si_(other.si_)
+        : si_(other.si_), ordered_states_(other.ordered_states_), break_set_(other.break_set_),
+          reach_(other.reach_), frozen_(other.frozen_)
+    {
+    }
+
+    elevator_mstate(elevator_mstate &&other)
+        : si_(other.si_), ordered_states_(std::move(other.ordered_states_)), break_set_(std::move(other.break_set_)),
+          reach_(std::move(other.reach_)), frozen_(other.frozen_)
     {
-      ordered_states_.clear();
-      for (unsigned i = 0; i < other.ordered_states_.size(); i++)
-      {
-        ordered_states_.push_back(other.ordered_states_[i]);
-      }
-      break_set_.clear();
-      break_set_.insert(other.break_set_.begin(), other.break_set_.end());
     }
 
     std::set<unsigned>
     get_reach_set() const;
 
+    // the states of the macrostate in increasing order
+    const std::vector<unsigned> &
+    get_reach() const;
+
+    // keep the result of get_reach() from now on, the macrostate must not
+    // change afterwards
+    void
+    freeze();
+
     std::set<unsigned>
     get_unlabelled_set() const;
 
@@ -110,14 +122,20 @@ namespace cola
     elevator_mstate &
     operator=(const elevator_mstate &other)
     {
-      this->si_ = other.si_;
-      this->ordered_states_.clear();
-      for (unsigned i = 0; i < other.ordered_states_.size(); i++)
-      {
-        this->ordered_states_.push_back(other.ordered_states_[i]);
-      }
-      this->break_set_.clear();
-      this->break_set_.insert(other.break_set_.begin(), other.break_set_.end());
+      this->ordered_states_ = other.ordered_states_;
+      this->break_set_ = other.break_set_;
+      this->reach_ = other.reach_;
+      this->frozen_ = other.frozen_;
+      return *this;
+    }
+
+    elevator_mstate &
+    operator=(elevator_mstate &&other)
+    {
+      this->ordered_states_ = std::move(other.ordered_states_);
+      this->break_set_ = std::move(other.break_set_);
+      this->reach_ = std::move(other.reach_);
+      this->frozen_ = other.frozen_;
       return *this;
     }
 
@@ -125,10 +143,15 @@ namespace cola
 
     // SCC information
     spot::scc_info &si_;
-    // states are ordered according to their SCCs
-    std::vector<int> ordered_states_;
+    // the reached states and their labelling, sorted by state
+    sparse_labelling ordered_states_;
     // breakpoint construction for weak accepting SCCs
     std::set<unsigned> break_set_;
+
+  private:
+    // computed by every call to get_reach() until the macrostate is frozen
+    mutable std::vector<unsigned> reach_;
+    bool frozen_ = false;
   };
 
   struct elevator_mstate_hash
@@ -147,7 +170,7 @@ namespace cola
     {
       return break_set_ < other.break_set_;
     }
-    return ordered_states_ < other.ordered_states_;
+    return dense_less(ordered_states_, other.ordered_states_);
   }
   bool
   elevator_mstate::operator==(const elevator_mstate &other) const
@@ -157,44 +180,55 @@ namespace cola
   int elevator_mstate::get_max_rank() const
   {
     int max_rnk = -1;
-    for (unsigned i = 0; i < ordered_states_.size(); i++)
+    for (const auto &p : ordered_states_)
     {
-      max_rnk = std::max(max_rnk, ordered_states_[i]);
+      max_rnk = std::max(max_rnk, p.second);
     }
     return max_rnk;
   }
   bool elevator_mstate::is_empty() const
   {
-    for (unsigned i = 0; i < ordered_states_.size(); i++)
-    {
-      if (ordered_states_[i] != RANK_M)
-      {
-        return false;
-      }
-    }
-    return true;
+    return ordered_states_.empty();
   }
   std::set<unsigned>
   elevator_mstate::get_reach_set() const
   {
     std::set<unsigned> result;
-    for (unsigned i = 0; i < ordered_states_.size(); i++)
+    for (const auto &p : ordered_states_)
     {
-      if (ordered_states_[i] == RANK_M)
-        continue;
-      result.insert(i);
+      result.insert(result.end(), p.first);
     }
     return result;
   }
 
+  const std::vector<unsigned> &
+  elevator_mstate::get_reach() const
+  {
+    if (frozen_)
+      return reach_;
+    // the labelling is sorted by state
+    reach_.clear();
+    for (const auto &p : ordered_states_)
+      reach_.push_back(p.first);
+    return reach_;
+  }
+
+  void
+  elevator_mstate::freeze()
+  {
+    get_reach();
+    reach_.shrink_to_fit();
+    frozen_ = true;
+  }
+
   std::set<unsigned>
   elevator_mstate::get_unlabelled_set() const
   {
     std::set<unsigned> result;
-    for (unsigned i = 0; i < ordered_states_.size(); i++)
+    for (const auto &p : ordered_states_)
     {
-      if (ordered_states_[i] == RANK_N)
-        result.insert(i);
+      if (p.second == RANK_N)
+        result.insert(result.end(), p.first);
     }
     return result;
   }
@@ -213,15 +247,15 @@ namespace cola
   {
     std::vector<label> res;
     // traverse all states
-    for (unsigned i = 0; i < ordered_states_.size(); i++)
+    for (const auto &p : ordered_states_)
     {
-      if (ordered_states_[i] == RANK_M || ordered_states_[i] == RANK_N)
+      if (p.second == RANK_N)
       {
         continue;
       }
-      if (si_.scc_of(i) == scc)
+      if (si_.scc_of(p.first) == scc)
       {
-        res.emplace_back(i, ordered_states_[i]);
+        res.push_back(p);
       }
     }
     // std::cout << "\nBefore: ";
@@ -236,18 +270,7 @@ namespace cola
   size_t
   elevator_mstate::hash() const
   {
-    size_t res = 0;
-    for (unsigned i = 0; i < ordered_states_.size(); i ++)
-    {
-      if (ordered_states_[i] == RANK_M) continue;
-      res = (res << 3) ^ (i);
-      res = (res << 3) ^ (ordered_states_[i]);
-    }
-    for (unsigned i : break_set_)
-    {
-      res ^= (res << 3) ^ i;
-    }
-    return res;
+    return hash_combine(hash_pairs(ordered_states_), hash_values(break_set_));
   }
 
   // determinization of elevator automata
@@ -264,7 +287,7 @@ namespace cola
     unsigned nb_states_;
 
     // state_simulator
-    state_simulator simulator_;
+    const state_simulator &simulator_;
 
     // delayed simulation
     delayed_simulation delayed_simulator_;
@@ -279,6 +302,9 @@ namespace cola
 
     spot::option_map &om_;
 
+    // limits on the number of states, time and memory
+    budget &budget_;
+
     // use ambiguous
     bool use_unambiguous_;
 
@@ -302,11 +328,22 @@ namespace cola
     // States to process.
     std::deque<std::pair<elevator_mstate, unsigned>> todo_;
 
-    // Support for each state of the source automaton.
-    std::vector<bdd> support_;
+    // the labelling of the successor being computed
+    labelling_scratch scratch_;
+
+    // incoming transitions for unambiguous automata, reset with the touched states of scratch_
+    std::vector<bool> incoming_;
+    std::vector<bool> ignores_;
+
+    // Support for each state of the source automaton, extended by
+    // analysis::get_stutter_support() for the stutter steps.
+    const std::vector<bdd> &support_;
 
     // Propositions compatible with all transitions of a state.
-    std::vector<bdd> compat_;
+    const std::vector<bdd> &compat_;
+
+    // support_ and compat_ of the sets of states of the macrostates
+    reach_letters reach_letters_;
 
     // Whether a SCC is deterministic or not
     std::string scc_types_;
@@ -317,6 +354,9 @@ namespace cola
     // the index of each deterministic accepting SCCs
     std::vector<unsigned> acc_detsccs_;
 
+    // the position of an SCC in acc_detsccs_, -1 if it is not accepting deterministic
+    std::vector<int> acc_detscc_index_;
+
     // Show Rank states in state name to help debug
     bool show_names_;
 
@@ -326,13 +366,13 @@ namespace cola
       // nondeterministic states (including weak states)
       std::string res = "N={";
       bool first_state = true;
-      for (unsigned i = 0; i < ms.ordered_states_.size(); i++)
-        if (ms.ordered_states_[i] == RANK_N)
+      for (const auto &p : ms.ordered_states_)
+        if (p.second == RANK_N)
         {
           if (!first_state)
             res += ",";
           first_state = false;
-          res += std::to_string(i);
+          res += std::to_string(p.first);
         }
       res += "}";
       res += ", O=" + get_set_string(ms.break_set_);
@@ -359,6 +399,7 @@ namespace cola
     new_state(elevator_mstate &s)
     {
       elevator_mstate dup(s);
+      dup.freeze();
       auto p = rank2n_.emplace(dup, 0);
       if (p.second) // This is a new state
       {
@@ -375,11 +416,53 @@ namespace cola
       return rank2n_.end() != rank2n_.find(s);
     }
 
+    // the labelled states of each accepting deterministic SCC, ordered by their labelling
+    std::vector<std::vector<label>>
+    group_by_detscc(const sparse_labelling &ms)
+    {
+      std::vector<std::vector<label>> res(acc_detsccs_.size());
+      for (const auto &p : ms)
+      {
+        if (p.second == RANK_N)
+          continue;
+        int index = acc_detscc_index_[si_.scc_of(p.first)];
+        if (index >= 0)
+          res[index].push_back(p);
+      }
+      for (auto &states : res)
+        std::sort(states.begin(), states.end(), label_compare);
+      return res;
+    }
+
+    // second incoming transition of dst in an unambiguous automaton
+    bool
+    can_ignore(unsigned dst)
+    {
+      if (!use_unambiguous_)
+        return false;
+      if (incoming_[dst])
+      {
+        // this is the second incoming transitions
+        ignores_[dst] = true;
+      }
+      else
+      {
+        incoming_[dst] = true;
+      }
+      return ignores_[dst];
+    }
+
     // remove a state i if it is simulated by a state j
     void
-    make_simulation_state(elevator_mstate &ms)
+    make_simulation_state(labelling_scratch &ms, std::set<unsigned> &break_set)
     {
-      std::set<unsigned> reached_states = ms.get_reach_set();
+      std::vector<unsigned> reached_states;
+      for (unsigned i : ms.touched())
+      {
+        if (ms.get(i) != RANK_M)
+          reached_states.push_back(i);
+      }
+      std::sort(reached_states.begin(), reached_states.end());
       for (unsigned i : reached_states)
       {
         for (unsigned j : reached_states)
@@ -391,17 +474,17 @@ namespace cola
           {
             // std::cout << j << " simulated " << i << std::endl;
             // std::cout << "can_reach = " << simulator_.can_reach(j, i) << std::endl;
-            ms.ordered_states_[i] = RANK_M;
-            ms.break_set_.erase(i);
+            ms.set(i, RANK_M);
+            break_set.erase(i);
           }
           // (j, k1) and (i, k2), if j simulates i and k1 < k2, then remove k2
           // Note that here i and j are not equivalent
-          if ((simulator_.simulate(j, i) || delayed_simulator_.simulate(j, i)) && ms.ordered_states_[j] > RANK_N && (si_.scc_of(i) == si_.scc_of(j)) && ms.ordered_states_[j] < ms.ordered_states_[i])
+          if ((simulator_.simulate(j, i) || delayed_simulator_.simulate(j, i)) && ms.get(j) > RANK_N && (si_.scc_of(i) == si_.scc_of(j)) && ms.get(j) < ms.get(i))
           // if j can reach i, then scc(j) must be larger scc(i) ms[j] > RANK_N && ms[j] < ms[i])
           {
             // std::cout << j << "simulated" << i << std::endl;
-            ms.ordered_states_[i] = RANK_M;
-            ms.break_set_.erase(i);
+            ms.set(i, RANK_M);
+            break_set.erase(i);
           }
         }
       }
@@ -412,38 +495,19 @@ namespace cola
     void
     compute_successors(const elevator_mstate &ms, bdd letter, elevator_mstate &nxt, std::vector<int> &color)
     {
-      elevator_mstate succ(si_, nb_states_, RANK_M);
-      // used for unambiguous automaton
-      std::vector<bool> incoming(nb_states_, false);
-      std::vector<bool> ignores(nb_states_, false);
-
-      auto can_ignore = [&incoming, &ignores](bool use_ambiguous, unsigned dst) -> bool
-      {
-        if (use_ambiguous)
-          {
-            if (incoming[dst])
-            {
-              // this is the second incoming transitions
-              ignores[dst] = true;
-            }
-            else
-            {
-              incoming[dst] = true;
-            }
-            return ignores[dst];
-          }else 
-          {
-            return false;
-          }
-      };
+      // the labelling of the successor, the breakpoint is kept in succ
+      labelling_scratch &labels = scratch_;
+      elevator_mstate succ(si_);
 
       //1. first handle nondeterministic states
       std::set<unsigned> acc_weak_coming_states;
-      std::set<unsigned> unlabelled_states = ms.get_unlabelled_set();
       int max_rnk = ms.get_max_rank();
 
-      for (unsigned s : unlabelled_states)
+      for (const auto &p : ms.ordered_states_)
       {
+        if (p.second != RANK_N)
+          continue;
+        unsigned s = p.first;
         // nondeterministic states or states in nonaccepting SCCs
         bool in_break_set = (ms.break_set_.find(s) != ms.break_set_.end());
         for (const auto &t : aut_->out(s))
@@ -452,17 +516,17 @@ namespace cola
             continue;
           // it is legal to ignore the states have two incoming transitions
           // in unambiguous Buchi automaton
-          if (can_ignore(use_unambiguous_, t.dst)) continue;
+          if (can_ignore(t.dst)) continue;
           unsigned scc_id = si_.scc_of(t.dst);
           // we move the states in accepting det SCC to ordered states
           if (is_acc_detscc(scc_id))
           {
-            succ.ordered_states_[t.dst] = max_rnk + 1; //Sharing labels
+            labels.set(t.dst, max_rnk + 1); //Sharing labels
           }
           else
           {
             // weak states or nondeterministic or nonaccepting det scc
-            succ.ordered_states_[t.dst] = RANK_N;
+            labels.set(t.dst, RANK_N);
             bool in_acc_set = // must be accepting and weak
                 (scc_types_[scc_id] & SCC_ACC) > 0 && (scc_types_[scc_id] & SCC_WEAK_TYPE) > 0;
             // in breakpoint and it is accepting
@@ -483,12 +547,13 @@ namespace cola
       //2. Compute the labelling successors
       const int MAX_RANK = max_rnk + 3;
       std::vector<std::pair<int, int>> min_labellings;
+      // list of deterministic states of each SCC, already ordered by its labelling
+      std::vector<std::vector<label>> det_states = group_by_detscc(ms.ordered_states_);
 
       for (unsigned i = 0; i < acc_detsccs_.size(); i++)
       {
         unsigned scc_curr_id = acc_detsccs_[i];
-        // list of deterministic states, already ordered by its labelling
-        std::vector<label> acc_det_states = ms.get_detscc_states(scc_curr_id);
+        const std::vector<label> &acc_det_states = det_states[i];
         // print_label_vec(acc_det_states);
         for (unsigned j = 0; j < acc_det_states.size(); j++)
         {
@@ -499,7 +564,7 @@ namespace cola
           {
             if (!bdd_implies(letter, t.cond))
               continue;
-            if (can_ignore(use_unambiguous_, t.dst))
+            if (can_ignore(t.dst))
             {
               continue;
             }
@@ -512,7 +577,7 @@ namespace cola
             //      in this case, the state is not labelled
             if (scc_curr_id != scc_succ_id && !is_acc_detscc(scc_succ_id))
             {
-              succ.ordered_states_[t.dst] = RANK_N; // go back to nondeterministic part
+              labels.set(t.dst, RANK_N); // go back to nondeterministic part
               bool in_acc_set =    // must be accepting and weak
                   (scc_types_[scc_succ_id] & SCC_ACC) > 0 && (scc_types_[scc_succ_id] & SCC_WEAK_TYPE) > 0;
               // record accepting weak SCC states
@@ -524,9 +589,9 @@ namespace cola
             {
               //2). go to a different and smaller accepting deterministic SCC
               // if it is a new state entering that SCC
-              if (succ.ordered_states_[t.dst] < RANK_N)
+              if (labels.get(t.dst) < RANK_N)
               {
-                succ.ordered_states_[t.dst] = max_rnk + 1;
+                labels.set(t.dst, max_rnk + 1);
               }
               // else it is not new, must already inherit some labelling
             } else if (scc_curr_id == scc_succ_id)
@@ -535,8 +600,8 @@ namespace cola
               // will inherit the same labelling
       
               // else the successor is also in the same scc, no change, inherit the labelling
-              if (succ.ordered_states_[t.dst] == RANK_M) succ.ordered_states_[t.dst] = curr_label;
-              else succ.ordered_states_[t.dst] = std::min(succ.ordered_states_[t.dst], curr_label);
+              if (labels.get(t.dst) == RANK_M) labels.set(t.dst, curr_label);
+              else labels.set(t.dst, std::min(labels.get(t.dst), curr_label));
             }
           }
         }
@@ -545,18 +610,17 @@ namespace cola
       // remove redudant states
       if (use_simulation_)
       {
-        make_simulation_state(succ);
+        make_simulation_state(labels, succ.break_set_);
       }
       min_labellings.clear();
         // record the numbers
         for (unsigned i = 0; i < acc_detsccs_.size(); i++)
         {
-          unsigned scc_curr_id = acc_detsccs_[i];
           int min_acc = MAX_RANK;
           int min_dcc = MAX_RANK;
           // list of deterministic states, already ordered by its labelling
-          std::vector<label> acc_det_states = ms.get_detscc_states(scc_curr_id);
-          // std::cout << "Computing scc " << scc_curr_id << "\n";
+          const std::vector<label> &acc_det_states = det_states[i];
+          // std::cout << "Computing scc " << acc_detsccs_[i] << "\n";
           // print_label_vec(acc_det_states);
           for (unsigned j = 0; j < acc_det_states.size(); j++)
           {
@@ -569,14 +633,14 @@ namespace cola
             {
               if (!bdd_implies(letter, t.cond))
               continue;
-              if (can_ignore(use_unambiguous_, t.dst))
+              if (can_ignore(t.dst))
               {
                 continue;
               }
               // 1. first they should be in the same SCC
               // 2. second the label should be equal
               if (si_.scc_of(s) == si_.scc_of(t.dst)
-              && succ.ordered_states_[t.dst] == curr_label)
+              && labels.get(t.dst) == curr_label)
               {
                 has_succ = true;
                 has_acc = has_acc || t.acc;
@@ -601,10 +665,12 @@ namespace cola
       if (break_empty)
       {
         // if the breakpoint is empty, then fill it with newly-incoming accepting weak SCC states
-        std::set<unsigned> result;
-        std::set<unsigned> reach_sucss = succ.get_reach_set();
-        std::set_intersection(reach_sucss.begin(), reach_sucss.end(), acc_weak_coming_states.begin(), acc_weak_coming_states.end(), std::inserter(result, result.begin()));
-        succ.break_set_ = result;
+        // that are still reached
+        for (unsigned s : acc_weak_coming_states)
+        {
+          if (labels.get(s) != RANK_M)
+            succ.break_set_.insert(s);
+        }
       }
 
       std::vector<int> colors;
@@ -643,17 +709,27 @@ namespace cola
         colors.push_back(2);
       }
 
+      // the incoming transitions are only recorded for this letter
+      if (use_unambiguous_)
+      {
+        for (unsigned s : labels.touched())
+        {
+          incoming_[s] = false;
+          ignores_[s] = false;
+        }
+      }
+      labels.collect(succ.ordered_states_);
+
       //4. Reorgnize the indices of each accepting deterministic SCC
-      for (unsigned i = 0; i < acc_detsccs_.size(); i++)
+      for (const auto &states : group_by_detscc(succ.ordered_states_))
       {
-        std::vector<label> acc_det_states = succ.get_detscc_states(acc_detsccs_[i]);
-        for (unsigned j = 0; j < acc_det_states.size(); j++)
+        for (unsigned j = 0; j < states.size(); j++)
         {
-          succ.ordered_states_[acc_det_states[j].first] = j;
+          find_label(succ.ordered_states_, states[j].first)->second = j;
         }
       }
 
-      nxt = succ;
+      nxt = std::move(succ);
       color = colors;
     }
     // copied and adapted from deterministic.cc in Spot
@@ -683,11 +759,11 @@ namespace cola
           }
           stutter_path.emplace_back(std::move(ms));
           // next state
-          elevator_mstate tmp_succ(si_, nb_states_, RANK_M);
+          elevator_mstate tmp_succ(si_);
           std::vector<int> tmp_color(acc_detsccs_.size() + 1, -1);
           compute_successors(stutter_path.back(), letter, tmp_succ, tmp_color);
          
-          ms = tmp_succ;
+          ms = std::move(tmp_succ);
           for (unsigned i = 0; i < mincolor.size(); i++)
           {
             if (tmp_color[i] != -1 && mincolor[i] != -1)
@@ -749,29 +825,34 @@ namespace cola
     }
 
   public:
-    elevator_determinize(const spot::const_twa_graph_ptr &aut, spot::scc_info &si, spot::option_map &om, std::vector<bdd> &implications)
-        : aut_(aut),
+    elevator_determinize(analysis &ctx, spot::option_map &om, budget &limits)
+        : aut_(ctx.get_aut()),
           om_(om),
+          budget_(limits),
           use_simulation_(om.get(USE_SIMULATION) > 0),
           use_scc_(om.get(USE_SCC_INFO) > 0),
           use_stutter_(om.get(USE_STUTTER) > 0),
           use_unambiguous_(om.get(USE_UNAMBIGUITY) > 0),
-          si_(si),
-          nb_states_(aut->num_states()),
-          support_(nb_states_),
-          compat_(nb_states_),
+          si_(ctx.get_scc_info()),
+          nb_states_(aut_->num_states()),
+          support_(use_stutter_ && aut_->prop_stutter_invariant() ? ctx.get_stutter_support() : ctx.get_support()),
+          compat_(ctx.get_compat()),
+          reach_letters_(support_, compat_),
           // is_accepting_(nb_states_),
-          simulator_(aut, si, implications, om.get(USE_SIMULATION) > 0),
-          delayed_simulator_(aut, om),
+          simulator_(ctx.get_simulator()),
+          delayed_simulator_(aut_, om),
+          scratch_(aut_->num_states()),
+          incoming_(aut_->num_states(), false),
+          ignores_(aut_->num_states(), false),
           show_names_(om.get(VERBOSE_LEVEL) > 0)
     {
       if (om.get(VERBOSE_LEVEL) >= 2)
       {
         simulator_.output_simulation();
       }
-      res_ = spot::make_twa_graph(aut->get_dict());
-      res_->copy_ap_of(aut);
-      res_->prop_copy(aut,
+      res_ = spot::make_twa_graph(aut_->get_dict());
+      res_->copy_ap_of(aut_);
+      res_->prop_copy(aut_,
                       {
                           false,        // state based
                           false,        // inherently_weak
@@ -779,37 +860,14 @@ namespace cola
                           true,         // complete
                           false         // stutter inv
                       });
-      // Generate bdd supports and compatible options for each state.
-      // Also check if all its transitions are accepting.
-      for (unsigned i = 0; i < nb_states_; ++i)
-      {
-        bdd res_support = bddtrue;
-        bdd res_compat = bddfalse;
-        for (const auto &out : aut->out(i))
-        {
-          res_support &= bdd_support(out.cond);
-          res_compat |= out.cond;
-        }
-        support_[i] = res_support;
-        compat_[i] = res_compat;
-      }
-      if (use_stutter_ && aut_->prop_stutter_invariant())
-      {
-        for (unsigned c = 0; c != si_.scc_count(); ++c)
-            {
-              bdd c_supp = si_.scc_ap_support(c);
-              for (const auto& su: si_.succ(c))
-                c_supp &= support_[si_.one_state_of(su)];
-              for (unsigned st: si_.states_of(c))
-                support_[st] = c_supp;
-            }
-      }
-      scc_types_ = get_scc_types(si_);
+      scc_types_ = ctx.get_scc_types();
       // find out the accepting and deterministic SCCs
+      acc_detscc_index_.resize(scc_types_.size(), -1);
       for (unsigned i = 0; i < scc_types_.size(); i++)
       {
         if (is_acc_detscc(i))
         {
+          acc_detscc_index_[i] = acc_detsccs_.size();
           acc_detsccs_.push_back(i);
           max_colors_.push_back(-1);
           min_colors_.push_back(INT_MAX);
@@ -817,7 +875,7 @@ namespace cola
       }
 
       // optimize with the fact of being unambiguous
-      use_unambiguous_ = use_unambiguous_ && is_unambiguous(aut);
+      use_unambiguous_ = use_unambiguous_ && is_unambiguous(aut_);
       if (show_names_)
       {
         names_ = new std::vector<std::string>();
@@ -826,14 +884,14 @@ namespace cola
       // Because we only handle one initial state, we assume it
       // belongs to the N set. (otherwise the automaton would be
       // deterministic)
-      unsigned init_state = aut->get_init_state_number();
-      elevator_mstate new_init_state(si_, nb_states_, RANK_M);
+      unsigned init_state = aut_->get_init_state_number();
+      elevator_mstate new_init_state(si_);
       if (! is_acc_detscc(si_.scc_of(init_state)))
       {
-        new_init_state.ordered_states_[init_state] = RANK_N;
+        new_init_state.ordered_states_.emplace_back(init_state, RANK_N);
       }else 
       {
-        new_init_state.ordered_states_[init_state] = 0;
+        new_init_state.ordered_states_.emplace_back(init_state, 0);
       }
       // we assume that the initial state is not in deterministic part
       res_->set_init_state(new_state(new_init_state));
@@ -967,31 +1025,28 @@ namespace cola
     {
       // Main stuff happens here
       // todo_ is a queue for handling states
+      edge_group<unsigned, std::vector<int>> out;
       while (!todo_.empty())
       {
         auto top = todo_.front();
         todo_.pop_front();
         // pop current state, (N, Rnk)
-        elevator_mstate ms = top.first;
-
-        // Compute support of all available states.
-        bdd msupport = bddtrue;
-        bdd n_s_compat = bddfalse;
-        // compute the occurred variables in the outgoing transitions of ms, stored in msupport
-        for (unsigned s = 0; s < nb_states_; ++s)
-          if (ms.ordered_states_[s] != RANK_M)
-          {
-            msupport &= support_[s];
-            n_s_compat |= compat_[s];
-          }
+        const elevator_mstate &ms = top.first;
+
+        // the occurred variables in the outgoing transitions of ms and the
+        // letters that have some of them
+        const std::pair<bdd, bdd> &letters = reach_letters_.get(ms.get_reach());
+        bdd msupport = letters.first;
+        bdd n_s_compat = letters.second;
 
         bdd all = n_s_compat;
         while (all != bddfalse)
         {
           bdd letter = bdd_satoneset(all, msupport, bddfalse);
           all -= letter;
+          budget_.check(res_->num_states(), todo_.size());
 
-          elevator_mstate succ(si_, nb_states_, RANK_M);
+          elevator_mstate succ(si_);
           // the number of SCCs we care is the accepting det SCCs and the weak SCCs
           std::vector<int> colors(acc_detsccs_.size() + 1, -1);
           //compute_labelling_successors(std::move(ms), top.second, letter, succ, color);
@@ -999,12 +1054,9 @@ namespace cola
       
           if (succ.is_empty()) continue;
 
-          unsigned origin = top.second;
           // add transitions
           // Create the automaton states
           unsigned dst = new_state(succ);
-          // first add this transition
-          res_->new_edge(origin, dst, letter);
           // handle with colors
           for (unsigned i = 0; i < colors.size(); i++)
           {
@@ -1018,8 +1070,14 @@ namespace cola
             }
             // record this color
           }
-          trans2colors_.emplace(std::make_pair(origin, letter), colors);
+          out.add(dst, colors, letter);
         }
+        // add transitions, one per successor and colors
+        out.flush([&](unsigned dst, const std::vector<int> &colors, const bdd &cond)
+        {
+          res_->new_edge(top.second, dst, cond);
+          trans2colors_.emplace(std::make_pair(top.second, cond), colors);
+        });
       }
       finalize_acceptance();
 
@@ -1082,28 +1140,21 @@ namespace cola
   };
 
   spot::twa_graph_ptr
-  determinize_televator(const spot::const_twa_graph_ptr &aut, spot::option_map &om)
+  determinize_televator(const spot::const_twa_graph_ptr &aut, spot::option_map &om, budget *limits)
   {
-    if (!is_elevator_automaton(aut))
-      throw std::runtime_error("determinize_teba() requires a elevator input");
+    analysis ctx(aut);
+    return determinize_televator(ctx, om, limits);
+  }
 
-    // now we compute the simulator
-    // now we compute the simulator
-    spot::const_twa_graph_ptr aut_reduced;
-    std::vector<bdd> implications;
-    spot::twa_graph_ptr aut_tmp = nullptr;
-    if (om.get(USE_SIMULATION) > 0)
-    {
-      aut_tmp = spot::scc_filter(aut);
-      auto aut2 = spot::simulation(aut_tmp, &implications, om.get(NUM_TRANS_PRUNING));
-      aut_tmp = aut2;
-    }
-    if (aut_tmp)
-      aut_reduced = aut_tmp;
-    else
-      aut_reduced = aut;
-    spot::scc_info scc(aut_reduced, spot::scc_info_options::ALL);
-    auto det = cola::elevator_determinize(aut_reduced, scc, om, implications);
+  spot::twa_graph_ptr
+  determinize_televator(analysis &ctx, spot::option_map &om, budget *limits)
+  {
+    if (!ctx.is_elevator())
+      throw std::runtime_error("determinize_teba() requires a elevator input");
+    // the simulator is computed on the reduced automaton
+    analysis &input = om.get(USE_SIMULATION) > 0 ? ctx.get_reduced(om.get(NUM_TRANS_PRUNING)) : ctx;
+    budget local_limits(om);
+    auto det = cola::elevator_determinize(input, om, limits ? *limits : local_limits);
     return det.run();
   }
 }
\ No newline at end of file
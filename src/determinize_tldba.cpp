@@ -20,6 +20,11 @@
 #include "cola.hpp"
 #include "simulation.hpp"
 #include "types.hpp"
+#include "budget.hpp"
+#include "analysis.hpp"
+#include "labelling.hpp"
+#include "hash.hpp"
+#include "edge_group.hpp"
 //#include "struct.hpp"
 
 #include <deque>
@@ -48,25 +53,16 @@
 namespace cola
 {
 
-  // macro state in which every state is assigned with a value
+  // macro state in which every reached state is assigned with a value
   // indicating the order of entering the deterministic part
-  typedef std::vector<int> mstate;
-  // state and the labelling value
-  typedef std::pair<unsigned, int> label;
-  // state and labelling pairs
-  typedef std::vector<label> small_mstate;
+  typedef sparse_labelling small_mstate;
 
   struct small_mstate_hash
   {
     size_t
-    operator()(small_mstate s) const noexcept
+    operator()(const small_mstate &s) const noexcept
     {
-      size_t hash = 0;
-      for (const auto &p : s)
-      {
-        hash = spot::wang32_hash(hash ^ ((p.first << 2) | p.second));
-      }
-      return hash;
+      return hash_pairs(s);
     }
   };
 
@@ -83,7 +79,7 @@ namespace cola
     unsigned nb_states_;
 
     // state_simulator
-    state_simulator simulator_;
+    const state_simulator &simulator_;
 
     // delayed simulation
     delayed_simulation delayed_simulator_;
@@ -98,6 +94,9 @@ namespace cola
 
     spot::option_map &om_;
 
+    // limits on the number of states, time and memory
+    budget &budget_;
+
     // use ambiguous
     bool use_unambiguous_;
 
@@ -115,13 +114,20 @@ namespace cola
     std::unordered_map<small_mstate, unsigned, small_mstate_hash> rank2n_;
 
     // States to process.
-    std::deque<std::pair<mstate, unsigned>> todo_;
+    std::deque<std::pair<small_mstate, unsigned>> todo_;
+
+    // the successor being computed
+    labelling_scratch scratch_;
+
+    // incoming transitions for unambiguous automata, reset with the touched states of scratch_
+    std::vector<bool> incoming_;
+    std::vector<bool> ignores_;
 
     // Support for each state of the source automaton.
-    std::vector<bdd> support_;
+    const std::vector<bdd> &support_;
 
     // Propositions compatible with all transitions of a state.
-    std::vector<bdd> compat_;
+    const std::vector<bdd> &compat_;
 
     // Whether a SCC is deterministic or not
     std::vector<bool> is_deter_;
@@ -132,16 +138,14 @@ namespace cola
     // Show Rank states in state name to help debug
     bool show_names_;
 
-    int get_max_rank(const mstate &ms)
+    int get_max_rank(const small_mstate &ms)
     {
       int max_rnk = -2;
-      for (int i = 0; i < nb_states_; i++)
+      for (const auto &p : ms)
       {
-        if (ms[i] == RANK_M)
-          continue;
-        if (max_rnk < ms[i])
+        if (max_rnk < p.second)
         {
-          max_rnk = ms[i];
+          max_rnk = p.second;
         }
       }
       return max_rnk;
@@ -189,20 +193,6 @@ namespace cola
       return res;
     }
 
-    small_mstate
-    to_small_mstate(const mstate &ms)
-    {
-      unsigned count = 0;
-      for (unsigned i = 0; i < nb_states_; ++i)
-        count += (ms[i] != RANK_M);
-      small_mstate small;
-      small.reserve(count);
-      for (unsigned i = 0; i < nb_states_; ++i)
-        if (ms[i] != RANK_M)
-          small.emplace_back(i, ms[i]);
-      return small;
-    }
-
     struct compare_pair
     {
       bool
@@ -226,9 +216,9 @@ namespace cola
     // From a Rank state, looks for a duplicate in the map before
     // creating a new state if needed.
     unsigned
-    new_state(mstate &&s)
+    new_state(small_mstate &&s)
     {
-      auto p = rank2n_.emplace(to_small_mstate(s), 0);
+      auto p = rank2n_.emplace(s, 0);
       if (p.second) // This is a new state
       {
         p.first->second = res_->new_state();
@@ -239,37 +229,41 @@ namespace cola
       return p.first->second;
     }
 
-    bool exists(mstate &s)
+    bool exists(small_mstate &s)
     {
-      return rank2n_.end() == rank2n_.find(to_small_mstate(s));
+      return rank2n_.end() == rank2n_.find(s);
     }
 
+    // second incoming transition of dst in an unambiguous automaton
     bool
-    is_smaller(const mstate &fst, const mstate &snd)
+    can_ignore(unsigned dst)
     {
-      for (unsigned s = 0; s < nb_states_; s++)
+      if (!use_unambiguous_)
+        return false;
+      if (incoming_[dst])
       {
-        if (fst[s] == snd[s])
-          continue;
-        else if (fst[s] < snd[s])
-          return true;
-        else if (fst[s] > snd[s])
-          return false;
+        // this is the second incoming transitions
+        ignores_[dst] = true;
+      }
+      else
+      {
+        incoming_[dst] = true;
       }
-      return false;
+      return ignores_[dst];
     }
 
     // remove a state i if it is simulated by a state j
     void
-    make_simulation_state(mstate &ms)
+    make_simulation_state(labelling_scratch &ms)
     {
       std::vector<unsigned> reached_states;
-      for (unsigned i = 0; i < nb_states_; i++)
+      for (unsigned i : ms.touched())
       {
-        if (ms[i] == RANK_M)
+        if (ms.get(i) == RANK_M)
           continue;
         reached_states.push_back(i);
       }
+      std::sort(reached_states.begin(), reached_states.end());
       for (unsigned i : reached_states)
       {
         for (unsigned j : reached_states)
@@ -281,13 +275,13 @@ namespace cola
           if ((simulator_.simulate(j, i) || delayed_simulator_.simulate(j, i)) && simulator_.can_reach(j, i) == 0)
           {
             // std::cout << "simulated" << std::endl;
-            ms[i] = RANK_M;
+            ms.set(i, RANK_M);
           }
           // (j, k1) and (i, k2), if j simulates i and k1 < k2, then remove k2
           // Note that here i and j are not equivalent
-          if ((simulator_.simulate(j, i) || delayed_simulator_.simulate(j, i)) && ms[j] > RANK_N && ms[j] < ms[i])
+          if ((simulator_.simulate(j, i) || delayed_simulator_.simulate(j, i)) && ms.get(j) > RANK_N && ms.get(j) < ms.get(i))
           {
-            ms[i] = RANK_M;
+            ms.set(i, RANK_M);
           }
         }
       }
@@ -295,43 +289,26 @@ namespace cola
 
     //@param
     void
-    compute_labelling_successors(const mstate &ms, unsigned origin, bdd letter, mstate &nxt, int &color)
+    compute_labelling_successors(const small_mstate &ms, unsigned origin, bdd letter, small_mstate &nxt, int &color)
     {
-      mstate succ(nb_states_, RANK_M);
+      labelling_scratch &succ = scratch_;
       int max_rnk = get_max_rank(ms);
-      std::vector<bool> incoming(nb_states_, false);
-      std::vector<bool> ignores(nb_states_, false);
       // first handle nondeterministic states
       std::vector<unsigned> coming_states;
       std::vector<unsigned> bottom_scc_states;
       //std::vector<unsigned> acc_coming_states;
-      for (unsigned s = 0; s < nb_states_; ++s)
+      for (const auto &p : ms)
       {
-        // missing states
-        if (ms[s] == RANK_M)
-          continue;
         // nondeterministic states
-        if (ms[s] == RANK_N)
+        if (p.second == RANK_N)
         {
-          for (const auto &t : aut_->out(s))
+          for (const auto &t : aut_->out(p.first))
           {
             if (!bdd_implies(letter, t.cond))
               continue;
             // it is legal to ignore the states have two incoming transitions
             // in unambiguous Buchi automaton
-            if (use_unambiguous_)
-            {
-              if (incoming[t.dst])
-              {
-                // this is the second incoming transitions
-                ignores[t.dst] = true;
-              }
-              else
-              {
-                incoming[t.dst] = true;
-              }
-            }
-            if (ignores[t.dst])
+            if (can_ignore(t.dst))
             {
               // ignore this state
               continue;
@@ -351,16 +328,16 @@ namespace cola
             }
             if (jump)
             {
-              if (succ[t.dst] < RANK_N)
+              if (succ.get(t.dst) < RANK_N)
               {
                 coming_states.push_back(t.dst);
-                succ[t.dst] = max_rnk + 1; //Sharing labels
+                succ.set(t.dst, max_rnk + 1); //Sharing labels
                 // succ[t.dst] = ++ max_rnk;
               }
             }
             else
             {
-              succ[t.dst] = RANK_N;
+              succ.set(t.dst, RANK_N);
             }
           }
         }
@@ -368,51 +345,41 @@ namespace cola
       std::sort(coming_states.begin(), coming_states.end());
       for (unsigned s : coming_states)
       {
-        succ[s] = ++max_rnk;
+        succ.set(s, ++max_rnk);
       }
+      // the labelled states from the largest labelling, by state for the same labelling
+      std::vector<label> ranked;
+      for (const auto &p : ms)
+        if (p.second >= 0)
+          ranked.push_back(p);
+      std::stable_sort(ranked.begin(), ranked.end(),
+                       [](const label &a, const label &b) { return a.second > b.second; });
       // now we compute the rank successors
-      for (int rnk = max_rnk; rnk >= 0; rnk--)
+      for (const auto &p : ranked)
       {
-        for (unsigned s = 0; s < nb_states_; ++s)
+        unsigned s = p.first;
+        int rnk = p.second;
+        for (const auto &t : aut_->out(s))
         {
-          if (ms[s] == RANK_M || ms[s] == RANK_N)
+          if (!bdd_implies(letter, t.cond))
             continue;
-          if (ms[s] != rnk)
+          if (can_ignore(t.dst))
+          {
             continue;
-          for (const auto &t : aut_->out(s))
+          }
+          // NORMAL way, inherit the labelling
+          //succ[t.dst] = rnk;
+          int update_rnk = RANK_N;
+          // get out of an SCC to another and it is not accepting
+          if (use_scc_ && si_.scc_of(s) != si_.scc_of(t.dst) && !si_.is_accepting_scc(si_.scc_of(t.dst)))
           {
-            if (!bdd_implies(letter, t.cond))
-              continue;
-            if (use_unambiguous_)
-            {
-              if (incoming[t.dst])
-              {
-                // this is the second incoming transitions
-                ignores[t.dst] = true;
-              }
-              else
-              {
-                incoming[t.dst] = true;
-              }
-            }
-            if (ignores[t.dst])
-            {
-              continue;
-            }
-            // NORMAL way, inherit the labelling
-            //succ[t.dst] = rnk;
-            int update_rnk = RANK_N;
-            // get out of an SCC to another and it is not accepting
-            if (use_scc_ && si_.scc_of(s) != si_.scc_of(t.dst) && !si_.is_accepting_scc(si_.scc_of(t.dst)))
-            {
-              update_rnk = RANK_N; // go back to nondeterministic part
-            }
-            else
-            {
-              update_rnk = rnk;
-            }
-            succ[t.dst] = update_rnk;
+            update_rnk = RANK_N; // go back to nondeterministic part
           }
+          else
+          {
+            update_rnk = rnk;
+          }
+          succ.set(t.dst, update_rnk);
         }
       }
 
@@ -423,34 +390,31 @@ namespace cola
       const int MAX_RANK = nb_states_ + 2;
       int min_dcc = MAX_RANK;
       int min_acc = MAX_RANK;
-      for (int rnk = max_rnk; rnk >= 0; rnk--)
+      std::vector<bool> has_succ(std::max(max_rnk + 1, 0), false);
+      std::vector<bool> has_acc(std::max(max_rnk + 1, 0), false);
+      for (const auto &p : ranked)
       {
-        bool has_succ = false;
-        bool has_acc = false;
-        for (unsigned s = 0; s < nb_states_; ++s)
+        // exactly the rank is rnk
+        int rnk = p.second;
+        for (const auto &t : aut_->out(p.first))
         {
-          if (ms[s] == RANK_M || ms[s] == RANK_N)
-            continue;
-          if (ms[s] != rnk)
+          if (!bdd_implies(letter, t.cond))
             continue;
-          // exactly the rank is rnk
-          for (const auto &t : aut_->out(s))
+          // exactly the same rank means the existence of an edge from the parent s
+          if (succ.get(t.dst) == rnk)
           {
-            if (!bdd_implies(letter, t.cond))
-              continue;
-            // exactly the same rank means the existence of an edge from the parent s
-            if (succ[t.dst] == rnk)
-            {
-              has_succ = true;
-              has_acc = has_acc || t.acc;
-            }
+            has_succ[rnk] = true;
+            has_acc[rnk] = has_acc[rnk] || t.acc;
           }
         }
-        if (!has_succ)
+      }
+      for (int rnk = max_rnk; rnk >= 0; rnk--)
+      {
+        if (!has_succ[rnk])
         {
           min_dcc = rnk;
         }
-        else if (has_acc)
+        else if (has_acc[rnk])
         {
           min_acc = rnk;
         }
@@ -473,58 +437,56 @@ namespace cola
       {
         parity = -1;
       }
+      // the incoming transitions are only recorded for this letter
+      if (use_unambiguous_)
+      {
+        for (unsigned s : succ.touched())
+        {
+          incoming_[s] = false;
+          ignores_[s] = false;
+        }
+      }
+      succ.collect(nxt);
       // now reorgnize the indices
-      std::unordered_map<int, int> ord_func;
-      int index = 0;
       // the succ has at most max_rnk + 1
+      std::vector<int> ord_func(max_rnk + 2, -1);
+      for (const auto &p : nxt)
+      {
+        if (p.second != RANK_N)
+          ord_func[p.second] = 0;
+      }
+      int index = 0;
       for (int i = 0; i <= max_rnk + 1; i++)
       {
-        bool existing = false;
-        for (unsigned s = 0; s < nb_states_; ++s)
-        {
-          if (succ[s] == i)
-          {
-            existing = true;
-            break;
-          }
-        }
-        if (existing)
-        {
-          ord_func.emplace(i, index);
-          index++;
-        }
+        if (ord_func[i] >= 0)
+          ord_func[i] = index++;
       }
-      for (unsigned s = 0; s < nb_states_; s++)
+      for (auto &p : nxt)
       {
-        if (succ[s] != RANK_M && succ[s] != RANK_N)
+        if (p.second != RANK_N)
         {
           // update indices
-          succ[s] = ord_func[succ[s]];
+          p.second = ord_func[p.second];
         }
       }
 
       // now we find whether there is bisimulate-states
       //new_bisim_state(succ);
 
-      nxt = succ;
       color = parity;
     }
     // copied and adapted from deterministic.cc in Spot
     void
-    make_stutter_state(const mstate &curr, unsigned origin, bdd letter, mstate &succ, int &color)
+    make_stutter_state(const small_mstate &curr, unsigned origin, bdd letter, small_mstate &succ, int &color)
     {
-      mstate ms;//(nb_states_, RANK_M);
-      for (unsigned s = 0; s < nb_states_; s++)
-      {
-        ms.push_back(curr[s]);
-      }
-      std::vector<mstate> stutter_path;
+      small_mstate ms(curr);
+      std::vector<small_mstate> stutter_path;
       if (use_stutter_ && aut_->prop_stutter_invariant())
       {
         // The path is usually quite small (3-4 states), so it's
         // not worth setting up a hash table to detect a cycle.
         stutter_path.clear();
-        std::vector<mstate>::iterator cycle_seed;
+        std::vector<small_mstate>::iterator cycle_seed;
         int mincolor = -1;
         // stutter forward until we   cycle
         for (;;)
@@ -540,10 +502,10 @@ namespace cola
           }
           stutter_path.emplace_back(std::move(ms));
           // next state
-          mstate tmp_succ;
+          small_mstate tmp_succ;
           int tmp_color = -1;
           compute_labelling_successors(stutter_path.back(), origin, letter, tmp_succ, tmp_color);
-          ms = tmp_succ;
+          ms = std::move(tmp_succ);
           if (tmp_color != -1 && mincolor != -1)
           {
             mincolor = std::min(tmp_color, mincolor);
@@ -561,7 +523,7 @@ namespace cola
           {
             // if *cycle_seed is already in seen, replace
             // it with a smaller state also in seen.
-            if (exists(*it) && is_smaller(*it, *cycle_seed))
+            if (exists(*it) && dense_less(*it, *cycle_seed))
               cycle_seed = it;
           }
           else
@@ -574,7 +536,7 @@ namespace cola
               cycle_seed = it;
               in_seen = true;
             }
-            else if (is_smaller(*it, *cycle_seed))
+            else if (dense_less(*it, *cycle_seed))
             {
               cycle_seed = it;
             }
@@ -590,29 +552,33 @@ namespace cola
     }
 
   public:
-    ldba_determinize(const spot::const_twa_graph_ptr &aut, spot::scc_info& si, spot::option_map &om, std::vector<bdd>& implications)
-        : aut_(aut),
+    ldba_determinize(analysis &ctx, spot::option_map &om, budget &limits)
+        : aut_(ctx.get_aut()),
           om_(om),
+          budget_(limits),
           use_simulation_(om.get(USE_SIMULATION) > 0),
           use_scc_(om.get(USE_SCC_INFO) > 0),
           use_stutter_(om.get(USE_STUTTER) > 0),
           use_unambiguous_(om.get(USE_UNAMBIGUITY) > 0),
-          si_(si),
-          nb_states_(aut->num_states()),
-          support_(nb_states_),
-          compat_(nb_states_),
+          si_(ctx.get_scc_info()),
+          nb_states_(aut_->num_states()),
+          support_(ctx.get_support()),
+          compat_(ctx.get_compat()),
           // is_accepting_(nb_states_),
-          simulator_(aut, si, implications, om.get(USE_SIMULATION) > 0),
-          delayed_simulator_(aut, om),
+          simulator_(ctx.get_simulator()),
+          delayed_simulator_(aut_, om),
+          scratch_(aut_->num_states()),
+          incoming_(aut_->num_states(), false),
+          ignores_(aut_->num_states(), false),
           show_names_(om.get(VERBOSE_LEVEL) >= 2)
     {
       if(om.get(VERBOSE_LEVEL) >= 2)
       {
         simulator_.output_simulation();
       }
-      res_ = spot::make_twa_graph(aut->get_dict());
-      res_->copy_ap_of(aut);
-      res_->prop_copy(aut,
+      res_ = spot::make_twa_graph(aut_->get_dict());
+      res_->copy_ap_of(aut_);
+      res_->prop_copy(aut_,
                       {
                           false,        // state based
                           false,        // inherently_weak
@@ -620,22 +586,7 @@ namespace cola
                           true,         // complete
                           false         // stutter inv
                       });
-      // Generate bdd supports and compatible options for each state.
-      // Also check if all its transitions are accepting.
-      for (unsigned i = 0; i < nb_states_; ++i)
-      {
-        bdd res_support = bddtrue;
-        bdd res_compat = bddfalse;
-        for (const auto &out : aut->out(i))
-        {
-          res_support &= bdd_support(out.cond);
-          res_compat |= out.cond;
-        }
-        support_[i] = res_support;
-        compat_[i] = res_compat;
-        // is_accepting_[i] = accepting && has_transitions;
-      }
-      is_semi_det_ = spot::is_semi_deterministic(aut);
+      is_semi_det_ = ctx.is_limit_deterministic();
       // Compute which SCCs are part of the deterministic set.
       if (is_semi_det_)
       {
@@ -646,7 +597,7 @@ namespace cola
         is_deter_ = get_accepting_reachable_sccs(si_);
       }
       // optimize with the fact of being unambiguous
-      use_unambiguous_ = use_unambiguous_ && is_unambiguous(aut);
+      use_unambiguous_ = use_unambiguous_ && is_unambiguous(aut_);
       if (show_names_)
       {
         names_ = new std::vector<std::string>();
@@ -655,9 +606,8 @@ namespace cola
       // Because we only handle one initial state, we assume it
       // belongs to the N set. (otherwise the automaton would be
       // deterministic)
-      unsigned init_state = aut->get_init_state_number();
-      mstate new_init_state(nb_states_, RANK_M);
-      new_init_state[init_state] = RANK_N;
+      unsigned init_state = aut_->get_init_state_number();
+      small_mstate new_init_state{label(init_state, RANK_N)};
       // we assume that the initial state is not in deterministic part
       res_->set_init_state(new_state(std::move(new_init_state)));
     }
@@ -667,38 +617,38 @@ namespace cola
     {
       // Main stuff happens here
       // todo_ is a queue for handling states
+      edge_group<unsigned, spot::acc_cond::mark_t> out;
       while (!todo_.empty())
       {
         auto top = todo_.front();
         todo_.pop_front();
         // pop current state, (N, Rnk)
-        mstate ms = top.first;
+        const small_mstate &ms = top.first;
 
         // Compute support of all available states.
         bdd msupport = bddtrue;
         bdd n_s_compat = bddfalse;
         // compute the occurred variables in the outgoing transitions of ms, stored in msupport
-        for (unsigned s = 0; s < nb_states_; ++s)
-          if (ms[s] != RANK_M)
-          {
-            msupport &= support_[s];
-            n_s_compat |= compat_[s];
-          }
+        for (const auto &p : ms)
+        {
+          msupport &= support_[p.first];
+          n_s_compat |= compat_[p.first];
+        }
 
         bdd all = n_s_compat;
         while (all != bddfalse)
         {
           bdd letter = bdd_satoneset(all, msupport, bddfalse);
           all -= letter;
+          budget_.check(res_->num_states(), todo_.size());
           // Compute all new states available from the generated
           // letter.
 
-          mstate succ;
+          small_mstate succ;
           int color = -1;
           //compute_labelling_successors(std::move(ms), top.second, letter, succ, color);
           make_stutter_state(ms, top.second, letter, succ, color);
 
-          unsigned origin = top.second;
           // add transitions
           // Create the automaton states
           unsigned dst = new_state(std::move(succ));
@@ -708,13 +658,18 @@ namespace cola
             unsigned pri = (unsigned)color;
             sets_ = std::max(pri, sets_);
 
-            res_->new_edge(origin, dst, letter, {pri});
+            out.add(dst, {pri}, letter);
           }
           else
           {
-            res_->new_edge(origin, dst, letter);
+            out.add(dst, {}, letter);
           }
         }
+        // one edge per successor and colors
+        out.flush([&](unsigned dst, spot::acc_cond::mark_t acc, const bdd &cond)
+        {
+          res_->new_edge(top.second, dst, cond, acc);
+        });
       }
       // check the number of indices
       unsigned max_odd_pri = -1;
@@ -797,28 +752,21 @@ namespace cola
   };
 
   spot::twa_graph_ptr
-  determinize_tldba(const spot::const_twa_graph_ptr &aut, spot::option_map &om)
+  determinize_tldba(const spot::const_twa_graph_ptr &aut, spot::option_map &om, budget *limits)
   {
-    if (!is_semi_deterministic(aut))
-      throw std::runtime_error("determinize_tldba() requires a semi-deterministic input");
+    analysis ctx(aut);
+    return determinize_tldba(ctx, om, limits);
+  }
 
-    // now we compute the simulator
-        // now we compute the simulator
-    spot::const_twa_graph_ptr aut_reduced;
-    std::vector<bdd> implications;
-    spot::twa_graph_ptr aut_tmp = nullptr;
-    if (om.get(USE_SIMULATION) > 0)
-    {
-      aut_tmp = spot::scc_filter(aut);
-      auto aut2 = spot::simulation(aut_tmp, &implications, om.get(NUM_TRANS_PRUNING));
-      aut_tmp = aut2;
-    }
-    if (aut_tmp)
-      aut_reduced = aut_tmp;
-    else 
-      aut_reduced = aut;
-    spot::scc_info scc(aut_reduced, spot::scc_info_options::ALL);
-    auto det = cola::ldba_determinize(aut_reduced, scc, om, implications);
+  spot::twa_graph_ptr
+  determinize_tldba(analysis &ctx, spot::option_map &om, budget *limits)
+  {
+    if (!ctx.is_limit_deterministic())
+      throw std::runtime_error("determinize_tldba() requires a semi-deterministic input");
+    // the simulator is computed on the reduced automaton
+    analysis &input = om.get(USE_SIMULATION) > 0 ? ctx.get_reduced(om.get(NUM_TRANS_PRUNING)) : ctx;
+    budget local_limits(om);
+    auto det = cola::ldba_determinize(input, om, limits ? *limits : local_limits);
     return det.run();
   }
 }
\ No newline at end of file
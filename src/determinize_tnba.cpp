@@ -19,11 +19,23 @@
 #include "cola.hpp"
 #include "simulation.hpp"
 #include "types.hpp"
+#include "hash.hpp"
+#include "budget.hpp"
+#include "analysis.hpp"
+#include "binary.hpp"
+#include "spill.hpp"
+#include "result_cache.hpp"
+#include "edge_group.hpp"
 // #include "struct.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <deque>
 #include <map>
 #include <set>
+#include <sstream>
+#include <unordered_map>
 
 #include <spot/misc/hashfunc.hh>
 #include <spot/twaalgos/isdet.hh>
@@ -197,11 +209,22 @@ namespace cola
         std::vector<label> copy = other.nondetscc_labels_[i];
         this->nondetscc_labels_.emplace_back(copy);
       }
+      this->reach_ = other.reach_;
+      this->frozen_ = other.frozen_;
     }
 
     std::set<unsigned>
     get_reach_set() const;
 
+    // the states of the macrostate in increasing order
+    const std::vector<unsigned> &
+    get_reach() const;
+
+    // keep the result of get_reach() from now on, the macrostate must not
+    // change afterwards
+    void
+    freeze();
+
     std::set<unsigned>
     get_weak_set() const;
 
@@ -246,11 +269,21 @@ namespace cola
         std::vector<label> copy = other.nondetscc_labels_[i];
         this->nondetscc_labels_.emplace_back(copy);
       }
+      this->reach_ = other.reach_;
+      this->frozen_ = other.frozen_;
       return *this;
     }
 
     size_t hash() const;
 
+    // the bytes of the macrostate, equal macrostates have equal bytes
+    std::string
+    to_bytes() const;
+
+    // read the macrostate back from the bytes of to_bytes()
+    void
+    from_bytes(const std::string &bytes);
+
     // SCC information
     spot::scc_info &si_;
     // 1. NAC states point to its braces
@@ -264,6 +297,11 @@ namespace cola
     // breakpoint construction for weak accepting SCCs
     std::set<unsigned> weak_set_;
     std::set<unsigned> break_set_;
+
+  private:
+    // computed by every call to get_reach() until the macrostate is frozen
+    mutable std::vector<unsigned> reach_;
+    bool frozen_ = false;
   };
 
   struct tnba_mstate_hash
@@ -379,6 +417,31 @@ namespace cola
     }
     return result;
   }
+  const std::vector<unsigned> &
+  tnba_mstate::get_reach() const
+  {
+    if (frozen_)
+      return reach_;
+    reach_.assign(weak_set_.begin(), weak_set_.end());
+    for (auto &vec : detscc_labels_)
+      for (auto &p : vec)
+        reach_.push_back(p.first);
+    for (auto &vec : nondetscc_labels_)
+      for (auto &p : vec)
+        reach_.push_back(p.first);
+    std::sort(reach_.begin(), reach_.end());
+    reach_.erase(std::unique(reach_.begin(), reach_.end()), reach_.end());
+    return reach_;
+  }
+
+  void
+  tnba_mstate::freeze()
+  {
+    get_reach();
+    reach_.shrink_to_fit();
+    frozen_ = true;
+  }
+
   bool tnba_mstate::is_empty() const
   {
     if (! weak_set_.empty())
@@ -442,38 +505,289 @@ namespace cola
   size_t
   tnba_mstate::hash() const
   {
-    size_t res = 0;
-    for (unsigned i : weak_set_)
+    size_t res = hash_combine(hash_values(weak_set_), hash_values(break_set_));
+    for (unsigned i = 0; i < detscc_labels_.size(); i ++)
     {
-      res = (res << 3) ^ i;
+      res = hash_combine(res, hash_pairs(detscc_labels_[i]));
     }
-    for (unsigned i : break_set_)
+    for (unsigned i = 0; i < nondetscc_breaces_.size(); i ++)
     {
-      res ^= (res << 3) ^ i;
+      res = hash_combine(res, hash_pairs(nondetscc_labels_[i]));
+      res = hash_combine(res, hash_values(nondetscc_breaces_[i]));
     }
-    for (unsigned i = 0; i < detscc_labels_.size(); i ++)
+
+    return res;
+  }
+
+  static const char CHECKPOINT_MAGIC[] = {'C', 'O', 'L', 'A', 'C', 'K', 1};
+
+  // ranks and braces may be negative
+  static void
+  write_int(std::string &buf, int value)
+  {
+    write_varint(buf, ((uint64_t)(int64_t)value << 1) ^ (uint64_t)((int64_t)value >> 63));
+  }
+
+  static int
+  read_int(const char *&data, const char *end)
+  {
+    uint64_t value = read_varint(data, end);
+    return (int)(int64_t)((value >> 1) ^ (0 - (value & 1)));
+  }
+
+  static void
+  write_labels(std::string &buf, const std::vector<label> &labels)
+  {
+    write_varint(buf, labels.size());
+    for (const auto &l : labels)
     {
-      for (auto& p : detscc_labels_[i])
+      write_varint(buf, l.first);
+      write_int(buf, l.second);
+    }
+  }
+
+  static void
+  read_labels(const char *&data, const char *end, std::vector<label> &labels)
+  {
+    labels.resize(read_varint(data, end));
+    for (auto &l : labels)
+    {
+      l.first = read_varint(data, end);
+      l.second = read_int(data, end);
+    }
+  }
+
+  std::string
+  tnba_mstate::to_bytes() const
+  {
+    std::string res;
+    write_varint(res, weak_set_.size());
+    for (unsigned s : weak_set_)
+      write_varint(res, s);
+    write_varint(res, break_set_.size());
+    for (unsigned s : break_set_)
+      write_varint(res, s);
+    for (const auto &labels : detscc_labels_)
+      write_labels(res, labels);
+    for (unsigned i = 0; i < nondetscc_labels_.size(); i++)
+    {
+      write_labels(res, nondetscc_labels_[i]);
+      write_varint(res, nondetscc_breaces_[i].size());
+      for (int brace : nondetscc_breaces_[i])
+        write_int(res, brace);
+    }
+    return res;
+  }
+
+  void
+  tnba_mstate::from_bytes(const std::string &bytes)
+  {
+    frozen_ = false;
+    const char *data = bytes.data();
+    const char *end = data + bytes.size();
+    weak_set_.clear();
+    for (uint64_t n = read_varint(data, end); n > 0; n--)
+      weak_set_.insert(read_varint(data, end));
+    break_set_.clear();
+    for (uint64_t n = read_varint(data, end); n > 0; n--)
+      break_set_.insert(read_varint(data, end));
+    for (auto &labels : detscc_labels_)
+      read_labels(data, end, labels);
+    for (unsigned i = 0; i < nondetscc_labels_.size(); i++)
+    {
+      read_labels(data, end, nondetscc_labels_[i]);
+      nondetscc_breaces_[i].resize(read_varint(data, end));
+      for (int &brace : nondetscc_breaces_[i])
+        brace = read_int(data, end);
+    }
+  }
+
+  // a guard as disjoint cubes, each a conjunction of literals, as varints;
+  // a literal is the index of its proposition in the automaton, not the
+  // BDD variable, which depends on the order the propositions are registered
+  static void
+  write_guard(std::string &buf, bdd guard, const std::unordered_map<int, unsigned> &var2ap)
+  {
+    std::vector<bdd> cubes;
+    while (guard != bddfalse)
+    {
+      cubes.push_back(bdd_satone(guard));
+      guard -= cubes.back();
+    }
+    write_varint(buf, cubes.size());
+    for (bdd cube : cubes)
+    {
+      std::vector<uint64_t> literals;
+      while (cube != bddtrue)
       {
-        res ^= (res << 3) ^ (p.first);
-        res ^= (res << 3) ^ (p.second);
+        uint64_t var = var2ap.at(bdd_var(cube));
+        if (bdd_low(cube) == bddfalse)
+        {
+          literals.push_back(var << 1 | 1);
+          cube = bdd_high(cube);
+        }
+        else
+        {
+          literals.push_back(var << 1);
+          cube = bdd_low(cube);
+        }
       }
+      write_varint(buf, literals.size());
+      for (uint64_t l : literals)
+        write_varint(buf, l);
     }
-    for (unsigned i = 0; i < nondetscc_breaces_.size(); i ++)
+  }
+
+  // aps are the variables of the propositions of the automaton
+  static bdd
+  read_guard(const char *&data, const char *end, const std::vector<bdd> &aps)
+  {
+    bdd res = bddfalse;
+    for (uint64_t n = read_varint(data, end); n > 0; n--)
     {
-      for (auto& p : nondetscc_labels_[i])
+      bdd cube = bddtrue;
+      for (uint64_t m = read_varint(data, end); m > 0; m--)
       {
-        res ^= (res << 3) ^ (p.first);
-        res ^= (res << 3) ^ (p.second);
+        uint64_t l = read_varint(data, end);
+        if ((l >> 1) >= aps.size())
+          throw std::runtime_error("cola: invalid proposition in a guard");
+        cube &= (l & 1) ? aps[l >> 1] : !aps[l >> 1];
       }
-      for (int k : nondetscc_breaces_[i])
+      res |= cube;
+    }
+    return res;
+  }
+
+  // A map from the states of the input to int that is cleared in constant
+  // time: an entry is valid only if its stamp is the current epoch.
+  class state_map
+  {
+  private:
+    std::vector<unsigned> stamps_;
+    std::vector<int> values_;
+    // the states inserted since the last clear(), maybe erased since
+    std::vector<unsigned> keys_;
+    unsigned epoch_ = 1;
+
+  public:
+    void
+    resize(unsigned num_states)
+    {
+      stamps_.assign(num_states, 0);
+      values_.assign(num_states, 0);
+      keys_.reserve(num_states);
+    }
+
+    void
+    clear()
+    {
+      if (++epoch_ == 0)
       {
-        res ^= (res << 3) ^ ((unsigned) k);
+        std::fill(stamps_.begin(), stamps_.end(), 0);
+        epoch_ = 1;
       }
+      keys_.clear();
     }
 
-    return res;
-  }
+    bool
+    contains(unsigned s) const
+    {
+      return stamps_[s] == epoch_;
+    }
+
+    // insert s with value, returns false and keeps the old value if s is there
+    bool
+    emplace(unsigned s, int value)
+    {
+      if (contains(s))
+        return false;
+      stamps_[s] = epoch_;
+      values_[s] = value;
+      keys_.push_back(s);
+      return true;
+    }
+
+    // the value of s, which must be there
+    int &
+    operator[](unsigned s)
+    {
+      assert(contains(s));
+      return values_[s];
+    }
+
+    void
+    erase(unsigned s)
+    {
+      stamps_[s] = epoch_ - 1;
+    }
+
+    // the states in the map in increasing order
+    const std::vector<unsigned> &
+    sorted_keys()
+    {
+      return sorted_members(keys_);
+    }
+
+    // sort states and only keep the ones in the map
+    const std::vector<unsigned> &
+    sorted_members(std::vector<unsigned> &states) const
+    {
+      std::sort(states.begin(), states.end());
+      states.erase(std::unique(states.begin(), states.end()), states.end());
+      states.erase(std::remove_if(states.begin(), states.end(),
+                                  [this](unsigned s) { return !contains(s); }),
+                   states.end());
+      return states;
+    }
+  };
+
+  // The buffers of tnba_determinize::compute_successors(), allocated once and
+  // reused for every letter instead of being built for each successor
+  struct successor_scratch
+  {
+    // the states reached by the letter and in which accepting SCC
+    state_map next;
+    std::vector<std::vector<unsigned>> next_det;
+    std::vector<std::vector<unsigned>> next_nondet;
+    // the edges (accepting, successor) taken from each state in an accepting SCC
+    std::vector<std::vector<std::pair<bool, unsigned>>> edges;
+    // the states with an incoming edge, for unambiguous automata
+    state_map incoming;
+    state_map acc_weak_coming;
+    // the labelling of the successors in one accepting SCC
+    state_map nodes;
+    std::vector<int> braces;
+    std::vector<int> new_braces;
+    std::vector<char> empty_green;
+    std::vector<int> highest_green_ancestor;
+    std::vector<unsigned> decr_by;
+
+    // the number of times a buffer had to grow, and of computed successors
+    size_t num_allocations = 0;
+    size_t num_successors = 0;
+
+    void
+    resize(unsigned num_states, unsigned num_det_acc_sccs, unsigned num_nondet_acc_sccs)
+    {
+      next.resize(num_states);
+      incoming.resize(num_states);
+      acc_weak_coming.resize(num_states);
+      nodes.resize(num_states);
+      next_det.resize(num_det_acc_sccs);
+      next_nondet.resize(num_nondet_acc_sccs);
+      edges.resize(num_states);
+    }
+
+    // fill buf with n copies of value, counting the allocations
+    template <typename T>
+    void
+    reuse(std::vector<T> &buf, size_t n, const T &value)
+    {
+      if (n > buf.capacity())
+        num_allocations++;
+      buf.assign(n, value);
+    }
+  };
 
   // determinization of elevator automata
   class tnba_determinize
@@ -489,7 +803,7 @@ namespace cola
     unsigned nb_states_;
 
     // state_simulator
-    state_simulator simulator_;
+    const state_simulator &simulator_;
 
     // delayed simulation
     delayed_simulation delayed_simulator_;
@@ -504,6 +818,9 @@ namespace cola
 
     spot::option_map &om_;
 
+    // limits on the number of states, time and memory
+    budget &budget_;
+
     // use ambiguous
     bool use_unambiguous_;
 
@@ -512,6 +829,9 @@ namespace cola
     // use stutter
     bool use_stutter_;
 
+    // one successor per letter class instead of per letter
+    bool use_letter_classes_;
+
     bool use_simulation_;
 
     // Association between labelling states and state numbers of the
@@ -525,14 +845,42 @@ namespace cola
     std::vector<int> max_colors_;
     std::vector<int> min_colors_;
 
+    // the first acceptance set of each accepting SCC (-1 if unused) and the
+    // set of the weak SCCs (-1 if none), laid out by finalize_acceptance()
+    std::vector<int> color_bases_;
+    int weak_set_ = -1;
+
     // States to process.
     std::deque<std::pair<tnba_mstate, unsigned>> todo_;
 
-    // Support for each state of the source automaton.
-    std::vector<bdd> support_;
+    // the visited macrostates and their numbers after run_external(),
+    // replacing rank2n_
+    std::unique_ptr<record_file> visited_;
+
+    // periodic checkpoints of the exploration, see save_checkpoint()
+    std::string checkpoint_file_;
+    std::chrono::steady_clock::time_point last_checkpoint_;
+
+    // Support for each state of the source automaton, extended by
+    // analysis::get_stutter_support() for the stutter steps.
+    const std::vector<bdd> &support_;
+
+    // buffers of compute_successors()
+    successor_scratch scratch_;
 
     // Propositions compatible with all transitions of a state.
-    std::vector<bdd> compat_;
+    const std::vector<bdd> &compat_;
+
+    // support_ and compat_ of the sets of states of the macrostates
+    reach_letters reach_letters_;
+
+    // the letter classes of the sets of states of the macrostates
+    letter_classes letter_classes_;
+
+    // the BDD variable of each proposition of aut_ and back, for the guards
+    // in the checkpoints and the spill files
+    std::vector<bdd> ap_vars_;
+    std::unordered_map<int, unsigned> var2ap_;
 
     // Whether a SCC is deterministic or not
     std::string scc_types_;
@@ -609,6 +957,7 @@ namespace cola
     new_state(tnba_mstate &s)
     {
       tnba_mstate dup(s);
+      dup.freeze();
       auto p = rank2n_.emplace(dup, 0);
       if (p.second) // This is a new state
       {
@@ -690,7 +1039,7 @@ namespace cola
     void
     make_simulation_state(tnba_mstate &ms)
     {
-      const std::set<unsigned> reached_states = ms.get_reach_set();
+      const std::vector<unsigned> &reached_states = ms.get_reach();
       std::vector<std::set<unsigned>> det_remove(acc_detsccs_.size(), std::set<unsigned>());
       std::vector<std::set<unsigned>> nondet_remove(acc_nondetsccs_.size(), std::set<unsigned>());
       for (unsigned i : reached_states)
@@ -733,15 +1082,15 @@ namespace cola
     }
 
     // Runs with higher labelling may be merged by those with lower labelling
-    void compute_deterministic_successors(const tnba_mstate &ms, tnba_mstate &succ, std::vector<std::set<unsigned>>& next_detstates
-    , std::unordered_map<unsigned, std::vector<std::pair<bool, unsigned>>>& det_cache)
+    void compute_deterministic_successors(const tnba_mstate &ms, tnba_mstate &succ)
     {
       for (unsigned i = 0; i < acc_detsccs_.size(); i++)
       {
         unsigned curr_scc = acc_detsccs_[i];
         // list of deterministic states, already ordered by its labelling
         const std::vector<label> &acc_det_states = ms.detscc_labels_[i];
-        std::map<unsigned, int> succ_nodes;
+        state_map &succ_nodes = scratch_.nodes;
+        succ_nodes.clear();
         int max_rnk = -1;
         // print_label_vec(acc_det_states);
         for (unsigned j = 0; j < acc_det_states.size(); j++)
@@ -751,41 +1100,39 @@ namespace cola
           max_rnk = std::max(max_rnk, curr_label);
           assert (curr_label == j);
           // states and ranking
-          for (const auto &t : det_cache[s])
+          for (const auto &t : scratch_.edges[s])
           {
             unsigned succ_scc = si_.scc_of(t.second);
             // ignore the states that go to other SCCs
             if (curr_scc != succ_scc)
               continue;
-            next_detstates[i].erase(t.second);
+            scratch_.next.erase(t.second);
             // Stay in the same accepting deterministic SCC or just enter this SCC
             // All DAC-states already have assigned with MAX_RANK
-            auto it = succ_nodes.emplace(t.second, curr_label);
-            if (! it.second) // already there
+            if (! succ_nodes.emplace(t.second, curr_label)) // already there
             {
-              int prev_label = it.first->second;
-              it.first->second = std::min(curr_label, prev_label);
+              int &prev_label = succ_nodes[t.second];
+              prev_label = std::min(curr_label, prev_label);
             }
           }
         }
         ++ max_rnk ;
         // put them into succ
-        for (unsigned p : next_detstates[i])
+        for (unsigned p : scratch_.next.sorted_members(scratch_.next_det[i]))
         {
           // insertion failed is possible
           succ_nodes.emplace(p, max_rnk);
           ++ max_rnk;
         }
         //succ.detscc_labels_[i].clear();
-        for (auto& node : succ_nodes)
+        for (unsigned node : succ_nodes.sorted_keys())
         {
-          succ.detscc_labels_[i].emplace_back(node.first, node.second);
+          succ.detscc_labels_[i].emplace_back(node, succ_nodes[node]);
         }
       }
     }
 
-    void compute_deterministic_color(const tnba_mstate &ms, tnba_mstate &succ, std::vector<std::pair<int, int>> &min_labellings
-    , std::unordered_map<unsigned, std::vector<std::pair<bool, unsigned>>>& det_cache)
+    void compute_deterministic_color(const tnba_mstate &ms, tnba_mstate &succ, std::vector<std::pair<int, int>> &min_labellings)
     {
       // record the numbers
       for (unsigned i = 0; i < acc_detsccs_.size(); i++)
@@ -795,14 +1142,15 @@ namespace cola
         int min_dcc = MAX_RANK_;
         // list of deterministic states, already ordered by its labelling
         const std::vector<label> &acc_det_states = ms.detscc_labels_[i];
-        std::map<unsigned, int> succ_nodes;
+        state_map &succ_nodes = scratch_.nodes;
+        succ_nodes.clear();
         for (auto & p : succ.detscc_labels_[i])
         {
-          succ_nodes[p.first] = p.second;
+          succ_nodes.emplace(p.first, p.second);
         }
 
-        std::vector<unsigned> decr_by;
-        decr_by.assign(acc_det_states.size(), 0);
+        std::vector<unsigned> &decr_by = scratch_.decr_by;
+        scratch_.reuse(decr_by, acc_det_states.size(), 0u);
         unsigned decr = 0;
         for (unsigned j = 0; j < acc_det_states.size(); j++)
         {
@@ -811,10 +1159,10 @@ namespace cola
           unsigned s = acc_det_states[j].first;
           int curr_label = acc_det_states[j].second;
           assert(curr_label == j);
-          for (const auto &t : det_cache[s])
+          for (const auto &t : scratch_.edges[s])
           {
             // ignore the states that are not existing any more
-            if (succ_nodes.find(t.second) == succ_nodes.end())
+            if (!succ_nodes.contains(t.second))
             {
               continue;
             }
@@ -856,23 +1204,26 @@ namespace cola
     }
 
   void
-  compute_nondeterministic_successors(const tnba_mstate &ms, tnba_mstate &succ
-  , std::vector<std::set<unsigned>> &next_nondetstates, std::unordered_map<unsigned, std::vector<std::pair<bool, unsigned>>>& nondet_cache)
+  compute_nondeterministic_successors(const tnba_mstate &ms, tnba_mstate &succ)
   {
     for (unsigned i = 0; i < acc_nondetsccs_.size(); i++)
     {
       unsigned curr_scc = acc_nondetsccs_[i];
       // list of nondeterministic states, already ordered by its labelling (not necessary)
       const std::vector<label> &acc_nondet_states = ms.nondetscc_labels_[i];
-      std::vector<int> braces = ms.nondetscc_breaces_[i]; //copy
+      std::vector<int> &braces = scratch_.braces;
+      if (ms.nondetscc_breaces_[i].size() > braces.capacity())
+        scratch_.num_allocations++;
+      braces.assign(ms.nondetscc_breaces_[i].begin(), ms.nondetscc_breaces_[i].end());
       const int min_new_brace = braces.size();
       // unsigned topbrace = braces.size();
-      std::map<unsigned, int> succ_nodes;
+      state_map &succ_nodes = scratch_.nodes;
+      succ_nodes.clear();
       // nodes are pair of states and labelling, ordered according to
       // labels and then state number
       for (const auto &node : acc_nondet_states)
       {
-        for (const auto &t : nondet_cache[node.first])
+        for (const auto &t : scratch_.edges[node.first])
         {
           unsigned dst = t.second;
           unsigned succ_scc = si_.scc_of(dst);
@@ -881,7 +1232,7 @@ namespace cola
           if (curr_scc == succ_scc)
           {
             // Delete a newincoming state who is already a successor from the same SCC
-            next_nondetstates[i].erase(dst);
+            scratch_.next.erase(dst);
             if (t.first)
             {
               // Step A1: Accepting edges generate new braces
@@ -889,14 +1240,13 @@ namespace cola
               // put current brace node.second as the parent of newb
               braces.emplace_back(node.second);
             }
-            auto i = succ_nodes.emplace(dst, newb);
-            if (!i.second) // dst already exists
+            if (!succ_nodes.emplace(dst, newb)) // dst already exists
             {
               // Step A2: Only keep the smallest nesting pattern.
-              if (compare_braces(braces, newb, i.first->second))
+              if (compare_braces(braces, newb, succ_nodes[dst]))
               {
                 // newb is smaller
-                i.first->second = newb;
+                succ_nodes[dst] = newb;
               }
               else
               {
@@ -912,17 +1262,16 @@ namespace cola
       // New incoming states
       // Top level is 0, if we enter the SCC, we need more braces
       // Order each entry states since each run can have accepting runs
-      for (unsigned dst : next_nondetstates[i])
+      for (unsigned dst : scratch_.next.sorted_members(scratch_.next_nondet[i]))
       {
         // put them all in top brace 0
         int newb = braces.size();
         // Step A1
-        auto i = succ_nodes.emplace(dst, newb);
         // If the state has not been added
-        if (i.second || i.first->second == -1)
+        if (succ_nodes.emplace(dst, newb) || succ_nodes[dst] == -1)
         {
           braces.push_back(RANK_TOP_BRACE);
-          i.first->second = newb;
+          succ_nodes[dst] = newb;
         }
       }
       // rearrange the labelling of states
@@ -931,9 +1280,9 @@ namespace cola
         if (om_.get(VERBOSE_LEVEL) >= 1)
         {
           std::cout << "previous: ";
-          for (auto &node : succ_nodes)
+          for (unsigned node : succ_nodes.sorted_keys())
           {
-            std::cout << " " << node.first << ": " << node.second;
+            std::cout << " " << node << ": " << succ_nodes[node];
           }
           std::cout << "\n";
         }
@@ -942,14 +1291,14 @@ namespace cola
         state_set states_from_acc_trans;
         std::map<int, int> parent_braces;
 
-        for (auto &node : succ_nodes)
+        for (unsigned node : succ_nodes.sorted_keys())
         {
-          if (node.second >= min_new_brace)
+          if (succ_nodes[node] >= min_new_brace)
           {
             // this state must come from accepting transition, use a set for canonical order
-            states_from_acc_trans.insert(node.first);
+            states_from_acc_trans.insert(node);
             // store the parent
-            parent_braces.emplace(node.second, braces[node.second]);
+            parent_braces.emplace(succ_nodes[node], braces[succ_nodes[node]]);
           }
         }
         // now we need to rearrange the braces in states_from_acc_trans
@@ -966,21 +1315,21 @@ namespace cola
         if (om_.get(VERBOSE_LEVEL) >= 1)
         {
           std::cout << "after: ";
-          for (auto &node : succ_nodes)
+          for (unsigned node : succ_nodes.sorted_keys())
           {
-            std::cout << " " << node.first << ": " << node.second;
+            std::cout << " " << node << ": " << succ_nodes[node];
           }
           std::cout << "\n";
         }
       }
       // now store the results to succ
       succ.nondetscc_labels_[i].clear();
-      for (auto &node : succ_nodes)
+      for (unsigned node : succ_nodes.sorted_keys())
       {
-        succ.nondetscc_labels_[i].emplace_back(node.first, node.second);
+        succ.nondetscc_labels_[i].emplace_back(node, succ_nodes[node]);
       }
       // replace the braces
-      succ.nondetscc_breaces_[i] = braces;
+      succ.nondetscc_breaces_[i].assign(braces.begin(), braces.end());
     }
   }
 
@@ -993,7 +1342,7 @@ namespace cola
     {
       unsigned curr_scc = acc_nondetsccs_[i];
       std::vector<label>& nodes = succ.nondetscc_labels_[i];
-      std::vector<int> braces = succ.nondetscc_breaces_[i]; // copy the vector
+      const std::vector<int> &braces = succ.nondetscc_breaces_[i];
 
       int min_dcc = MAX_RANK_;
       int min_acc = MAX_RANK_;
@@ -1001,9 +1350,9 @@ namespace cola
       int topbrace = braces.size();
       constexpr char is_empty = 1;
       constexpr char is_green = 2;
-      std::vector<char> empty_green;
+      std::vector<char> &empty_green = scratch_.empty_green;
       // initially both empty and green for a brace
-      empty_green.assign(braces.size(), is_empty | is_green);
+      scratch_.reuse(empty_green, braces.size(), (char)(is_empty | is_green));
 
       for (const auto &n : nodes)
         if (n.second >= 0) // not top level, top level will not have red or good events?
@@ -1025,11 +1374,11 @@ namespace cola
       // 0 cannot be in a green pair, its highest green ancestor is itself
       // Also find red and green signals to emit
       // And compute the number of braces to remove for renumbering
-      std::vector<int> highest_green_ancestor;
-      highest_green_ancestor.assign(braces.size(), 0);
+      std::vector<int> &highest_green_ancestor = scratch_.highest_green_ancestor;
+      scratch_.reuse(highest_green_ancestor, braces.size(), 0);
 
-      std::vector<unsigned> decr_by;
-      decr_by.assign(braces.size(), 0);
+      std::vector<unsigned> &decr_by = scratch_.decr_by;
+      scratch_.reuse(decr_by, braces.size(), 0u);
       unsigned decr = 0;
       
       for (int b = 0; b < braces.size(); ++b)
@@ -1070,7 +1419,8 @@ namespace cola
       // drease the values
 
       // Update nodes with new braces numbers
-      std::vector<int> newbs = std::vector<int>(braces.size() - decr, -1);
+      std::vector<int> &newbs = scratch_.new_braces;
+      scratch_.reuse(newbs, braces.size() - decr, -1);
       for (auto& n : nodes)
         {
           // if the brace is not -1
@@ -1086,7 +1436,7 @@ namespace cola
               newbs[n.second] = j;
             }
         }
-      succ.nondetscc_breaces_[i] = newbs;
+      succ.nondetscc_breaces_[i].assign(newbs.begin(), newbs.end());
     }
 
   }
@@ -1125,67 +1475,40 @@ namespace cola
   {
     // std::cout << "current state: " << get_name(ms) << std::endl;
     tnba_mstate succ(si_, acc_detsccs_.size(), acc_nondetsccs_.size());
+    scratch_.num_successors++;
     // used for unambiguous automaton
-    std::vector<bool> incoming(nb_states_, false);
-    std::vector<bool> ignores(nb_states_, false);
+    state_map &incoming = scratch_.incoming;
+    incoming.clear();
 
     // this function is used for unambiguous NBAs
-    auto can_ignore = [&incoming, &ignores](bool use_ambiguous, unsigned dst) -> bool
+    auto can_ignore = [&incoming](bool use_ambiguous, unsigned dst) -> bool
     {
-      if (use_ambiguous)
-      {
-        if (incoming[dst])
-        {
-          // this is the second incoming transitions
-          ignores[dst] = true;
-        }
-        else
-        {
-          incoming[dst] = true;
-        }
-        return ignores[dst];
-      }
-      else
-      {
-        return false;
-      }
+      // ignore every incoming transition after the first one
+      return use_ambiguous && !incoming.emplace(dst, 0);
     };
 
-    std::set<unsigned> acc_weak_coming_states;
+    state_map &acc_weak_coming_states = scratch_.acc_weak_coming;
+    acc_weak_coming_states.clear();
     // states at current level
-    std::set<unsigned> current_states = ms.get_reach_set();
+    const std::vector<unsigned> &current_states = ms.get_reach();
     // states at next level
-    std::vector<std::set<unsigned>> next_nondetstates;
-    for (unsigned i = 0; i < acc_nondetsccs_.size(); i++)
-    {
-      std::set<unsigned> states;
-      next_nondetstates.emplace_back(states);
-    }
-    std::vector<std::set<unsigned>> next_detstates;
-    for (unsigned i = 0; i < acc_detsccs_.size(); i++)
-    {
-      std::set<unsigned> states;
-      next_detstates.emplace_back(states);
-    }
+    scratch_.next.clear();
+    for (auto &states : scratch_.next_nondet)
+      states.clear();
+    for (auto &states : scratch_.next_det)
+      states.clear();
     int max_rnk = INT_MAX;
 
-    std::unordered_map<unsigned, std::vector<std::pair<bool, unsigned>>> det_cache;
-    std::unordered_map<unsigned, std::vector<std::pair<bool, unsigned>>> nondet_cache;
-
     //1. first handle inherently weak states
     for (unsigned s : current_states)
     {
       // nondeterministic states or states in nonaccepting SCCs
       bool in_break_set = (ms.break_set_.find(s) != ms.break_set_.end());
       bool in_acc_det = is_accepting_detscc(scc_types_, si_.scc_of(s));
-      if (in_acc_det)
-      {
-        det_cache.emplace(s, std::vector<std::pair<bool, unsigned>>());
-      }
       bool in_acc_nondet = is_accepting_nondetscc(scc_types_, si_.scc_of(s));
-      if (in_acc_nondet)
+      if (in_acc_det || in_acc_nondet)
       {
-        nondet_cache.emplace(s, std::vector<std::pair<bool, unsigned>>());
+        scratch_.edges[s].clear();
       }
       for (const auto &t : aut_->out(s))
       {
@@ -1202,10 +1525,11 @@ namespace cola
           int det_scc_index = get_detscc_index(scc_id); 
           assert(det_scc_index != -1);
           // incoming states
-          next_detstates[det_scc_index].insert(t.dst);
+          if (scratch_.next.emplace(t.dst, 0))
+            scratch_.next_det[det_scc_index].push_back(t.dst);
           if (in_acc_det)
           {
-            det_cache[s].emplace_back(t.acc.has(0), t.dst);
+            scratch_.edges[s].emplace_back(t.acc.has(0), t.dst);
           }
         }
         else if (is_weakscc(scc_types_, scc_id))
@@ -1222,7 +1546,7 @@ namespace cola
           // in accepting weak SCCs
           if (in_acc_set)
           {
-            acc_weak_coming_states.insert(t.dst);
+            acc_weak_coming_states.emplace(t.dst, 0);
           }
         }
         else if (is_accepting_nondetscc(scc_types_, scc_id))
@@ -1230,10 +1554,11 @@ namespace cola
           int nondet_scc_index = get_nondetscc_index(scc_id);
           assert(nondet_scc_index != -1);
           // reached states for each NAC
-          next_nondetstates[nondet_scc_index].insert(t.dst);
+          if (scratch_.next.emplace(t.dst, 0))
+            scratch_.next_nondet[nondet_scc_index].push_back(t.dst);
           if (in_acc_nondet)
           {
-            nondet_cache[s].emplace_back(t.acc.has(0), t.dst);
+            scratch_.edges[s].emplace_back(t.acc.has(0), t.dst);
           }
         }
         else
@@ -1244,11 +1569,11 @@ namespace cola
     }
     // std::cout << "After nondeterministic: " << get_name(succ) << std::endl;
     //2. Compute the labelling successors for deterministic SCCs
-    compute_deterministic_successors(ms, succ, next_detstates, det_cache);
+    compute_deterministic_successors(ms, succ);
 
     // std::cout << "After deterministic part = " << get_name(succ) << std::endl;
     //3. Compute the successors for nondeterministic SCCs
-    compute_nondeterministic_successors(ms, succ, next_nondetstates, nondet_cache);
+    compute_nondeterministic_successors(ms, succ);
     // std::cout << "After nondeterministic part = " << get_name(succ) << std::endl;
 
     // remove redudant states
@@ -1260,7 +1585,7 @@ namespace cola
     //now compute the labels
     std::vector<std::pair<int, int>> det_min_labellings;
     //4. decide the color for deterministic SCCs
-    compute_deterministic_color(ms, succ, det_min_labellings, det_cache);
+    compute_deterministic_color(ms, succ, det_min_labellings);
     //5. decide the color for nondeterministic SCCs
     std::vector<std::pair<int, int>> nondet_min_labellings;
     compute_nondeterministic_color(ms, succ, nondet_min_labellings);
@@ -1270,10 +1595,9 @@ namespace cola
     if (break_empty)
     {
       // if the breakpoint is empty, then fill it with newly-incoming accepting weak SCC states
-      std::set<unsigned> result;
-      std::set<unsigned> reach_sucss = succ.weak_set_; // copy
-      std::set_intersection(reach_sucss.begin(), reach_sucss.end(), acc_weak_coming_states.begin(), acc_weak_coming_states.end(), std::inserter(result, result.begin()));
-      succ.break_set_ = result;
+      for (unsigned s : succ.weak_set_)
+        if (acc_weak_coming_states.contains(s))
+          succ.break_set_.insert(s);
     }
 
     std::vector<int> colors;
@@ -1412,29 +1736,33 @@ namespace cola
   }
 
 public:
-  tnba_determinize(const spot::const_twa_graph_ptr &aut, spot::scc_info &si, spot::option_map &om, std::vector<bdd> &implications)
-      : aut_(aut),
+  tnba_determinize(analysis &ctx, spot::option_map &om, budget &limits)
+      : aut_(ctx.get_aut()),
         om_(om),
+        budget_(limits),
         use_simulation_(om.get(USE_SIMULATION) > 0),
         use_scc_(om.get(USE_SCC_INFO) > 0),
         use_stutter_(om.get(USE_STUTTER) > 0),
+        use_letter_classes_(om.get(LETTER_CLASSES) > 0),
         use_unambiguous_(om.get(USE_UNAMBIGUITY) > 0),
-        si_(si),
-        nb_states_(aut->num_states()),
-        support_(nb_states_),
-        compat_(nb_states_),
-        MAX_RANK_(aut->num_states() + 2),
-        simulator_(aut, si, implications, om.get(USE_SIMULATION) > 0),
-        delayed_simulator_(aut, om),
+        si_(ctx.get_scc_info()),
+        nb_states_(aut_->num_states()),
+        support_(use_stutter_ && aut_->prop_stutter_invariant() ? ctx.get_stutter_support() : ctx.get_support()),
+        compat_(ctx.get_compat()),
+        reach_letters_(support_, compat_),
+        letter_classes_(aut_),
+        MAX_RANK_(aut_->num_states() + 2),
+        simulator_(ctx.get_simulator()),
+        delayed_simulator_(aut_, om),
         show_names_(om.get(VERBOSE_LEVEL) >= 1)
   {
     if (om.get(VERBOSE_LEVEL) >= 2)
     {
       simulator_.output_simulation();
     }
-    res_ = spot::make_twa_graph(aut->get_dict());
-    res_->copy_ap_of(aut);
-    res_->prop_copy(aut,
+    res_ = spot::make_twa_graph(aut_->get_dict());
+    res_->copy_ap_of(aut_);
+    res_->prop_copy(aut_,
                     {
                         false,        // state based
                         false,        // inherently_weak
@@ -1442,34 +1770,12 @@ public:
                         true,         // complete
                         false         // stutter inv
                     });
-    // Generate bdd supports and compatible options for each state.
-    // Also check if all its transitions are accepting.
-    for (unsigned i = 0; i < nb_states_; ++i)
-    {
-      bdd res_support = bddtrue;
-      bdd res_compat = bddfalse;
-      for (const auto &out : aut->out(i))
-      {
-        res_support &= bdd_support(out.cond);
-        res_compat |= out.cond;
-      }
-      support_[i] = res_support;
-      compat_[i] = res_compat;
-    }
-    // need to add support of reachable states 
+    // the stutter steps go on from the successors, whose edges do not
+    // respect the classes of the current macrostate
     if (use_stutter_ && aut_->prop_stutter_invariant())
-    {
-      for (unsigned c = 0; c != si_.scc_count(); ++c)
-          {
-            bdd c_supp = si_.scc_ap_support(c);
-            for (const auto& su: si_.succ(c))
-              c_supp &= support_[si_.one_state_of(su)];
-            for (unsigned st: si_.states_of(c))
-              support_[st] = c_supp;
-          }
-    }
+      use_letter_classes_ = false;
     // obtain the types of each SCC
-    scc_types_ = get_scc_types(si_);
+    scc_types_ = ctx.get_scc_types();
     // find out the DACs and NACs
     for (unsigned i = 0; i < scc_types_.size(); i++)
     {
@@ -1490,16 +1796,31 @@ public:
       }
     }
 
+    scratch_.resize(nb_states_, acc_detsccs_.size(), acc_nondetsccs_.size());
+
+    for (unsigned i = 0; i < aut_->ap().size(); i++)
+    {
+      int var = aut_->get_dict()->varnum(aut_->ap()[i]);
+      var2ap_.emplace(var, i);
+      ap_vars_.push_back(bdd_ithvar(var));
+    }
+
     // optimize with the fact of being unambiguous
-    use_unambiguous_ = use_unambiguous_ && is_unambiguous(aut);
+    use_unambiguous_ = use_unambiguous_ && is_unambiguous(aut_);
     if (show_names_)
     {
       names_ = new std::vector<std::string>();
       res_->set_named_prop("state-names", names_);
     }
 
+    checkpoint_file_ = om.get_str(CHECKPOINT_FILE);
+    last_checkpoint_ = std::chrono::steady_clock::now();
+    std::string resume_file = om.get_str(RESUME_FILE);
+    if (!resume_file.empty() && load_checkpoint(resume_file))
+      return;
+
     // we only handle one initial state
-    unsigned init_state = aut->get_init_state_number();
+    unsigned init_state = aut_->get_init_state_number();
     tnba_mstate new_init_state(si_, acc_detsccs_.size(), acc_nondetsccs_.size());
     unsigned init_scc = si_.scc_of(init_state);
     if ((scc_types_[init_scc] & SCC_WEAK_TYPE))
@@ -1523,6 +1844,157 @@ public:
     res_->set_init_state(new_state(new_init_state));
   }
 
+  // the input and the options that the exploration depends on
+  std::string
+  checkpoint_key()
+  {
+    std::string settings;
+    // every option read by the exploration, the input covers the others
+    for (const char *key : {USE_SIMULATION, USE_DELAYED_SIMULATION, USE_STUTTER, USE_UNAMBIGUITY, USE_SCC_INFO,
+                            MSTATE_REARRANGE, LETTER_CLASSES, NUM_TRANS_PRUNING, EXTERNAL_BFS})
+      settings += std::string(key) + '=' + std::to_string(om_.get(key)) + ' ';
+    return result_cache::compute_key(aut_, settings);
+  }
+
+  // Write the whole exploration state: the macrostates in the order of their
+  // numbers, the edges of res_ with their colors in the order of the edges,
+  // the frontier and the ranges of colors. Everything else is computed again
+  // from the input, so a resumed run ends with the same result. The file is
+  // written next to its final name and then renamed.
+  void
+  save_checkpoint()
+  {
+    std::string buf(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    std::string key = checkpoint_key();
+    write_varint(buf, key.size());
+    buf += key;
+    std::vector<const tnba_mstate *> mstates(rank2n_.size());
+    for (auto &p : rank2n_)
+      mstates[p.second] = &p.first;
+    write_varint(buf, mstates.size());
+    for (const tnba_mstate *ms : mstates)
+    {
+      std::string bytes = ms->to_bytes();
+      write_varint(buf, bytes.size());
+      buf += bytes;
+    }
+    write_varint(buf, res_->get_init_state_number());
+    write_varint(buf, res_->num_edges());
+    for (auto &t : res_->edges())
+    {
+      write_varint(buf, t.src);
+      write_varint(buf, t.dst);
+      write_guard(buf, t.cond, var2ap_);
+      const std::vector<int> &colors = trans2colors_.at(std::make_pair(t.src, t.cond));
+      for (int c : colors)
+        write_int(buf, c);
+    }
+    write_varint(buf, todo_.size());
+    for (auto &p : todo_)
+      write_varint(buf, p.second);
+    for (unsigned i = 0; i < max_colors_.size(); i++)
+    {
+      write_int(buf, max_colors_[i]);
+      write_int(buf, min_colors_[i]);
+    }
+
+    std::string tmp = checkpoint_file_ + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary);
+      out.write(buf.data(), buf.size());
+      out.close();
+      if (!out)
+      {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("cola: cannot write the checkpoint " + tmp);
+      }
+    }
+    if (std::rename(tmp.c_str(), checkpoint_file_.c_str()) != 0)
+      throw std::runtime_error("cola: cannot write the checkpoint " + checkpoint_file_);
+    if (om_.get(VERBOSE_LEVEL) >= 1)
+      std::cout << "Checkpoint with " << mstates.size() << " macrostates and " << todo_.size()
+                << " to explore written to " << checkpoint_file_ << std::endl;
+  }
+
+  // Restore the state written by save_checkpoint(). Returns false if the file
+  // has been written for another input or other options, e.g., for another
+  // part of a decomposed automaton, and the exploration then starts afresh.
+  bool
+  load_checkpoint(const std::string &file)
+  {
+    std::ifstream in(file, std::ios::binary);
+    if (!in)
+      throw std::runtime_error("cola: cannot read the checkpoint " + file);
+    std::ostringstream content;
+    content << in.rdbuf();
+    std::string buf = content.str();
+    const char *data = buf.data();
+    const char *end = data + buf.size();
+    if (buf.size() < sizeof(CHECKPOINT_MAGIC) || buf.compare(0, sizeof(CHECKPOINT_MAGIC), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0)
+      throw std::runtime_error("cola: " + file + " is not a checkpoint");
+    data += sizeof(CHECKPOINT_MAGIC);
+    uint64_t key_size = read_varint(data, end);
+    if (key_size > (uint64_t)(end - data) || std::string(data, key_size) != checkpoint_key())
+    {
+      if (om_.get(VERBOSE_LEVEL) >= 1)
+        std::cout << "The checkpoint " << file << " is for another automaton, starting from scratch" << std::endl;
+      return false;
+    }
+    data += key_size;
+
+    uint64_t num_states = read_varint(data, end);
+    for (uint64_t i = 0; i < num_states; i++)
+    {
+      uint64_t size = read_varint(data, end);
+      if (size > (uint64_t)(end - data))
+        throw std::runtime_error("cola: truncated checkpoint " + file);
+      tnba_mstate ms(si_, acc_detsccs_.size(), acc_nondetsccs_.size());
+      ms.from_bytes(std::string(data, size));
+      ms.freeze();
+      data += size;
+      // in the order of the numbers, as new_state() has inserted them
+      rank2n_.emplace(ms, res_->new_state());
+      if (show_names_)
+        names_->push_back(get_name(ms));
+    }
+    std::vector<const tnba_mstate *> mstates(num_states);
+    for (auto &p : rank2n_)
+      mstates[p.second] = &p.first;
+    uint64_t init = read_varint(data, end);
+    if (init >= num_states)
+      throw std::runtime_error("cola: invalid checkpoint " + file);
+    res_->set_init_state(init);
+    for (uint64_t n = read_varint(data, end); n > 0; n--)
+    {
+      unsigned src = read_varint(data, end);
+      unsigned dst = read_varint(data, end);
+      bdd cond = read_guard(data, end, ap_vars_);
+      std::vector<int> colors(acc_detsccs_.size() + acc_nondetsccs_.size() + 1);
+      for (int &c : colors)
+        c = read_int(data, end);
+      if (src >= num_states || dst >= num_states)
+        throw std::runtime_error("cola: invalid checkpoint " + file);
+      res_->new_edge(src, dst, cond);
+      trans2colors_.emplace(std::make_pair(src, cond), colors);
+    }
+    for (uint64_t n = read_varint(data, end); n > 0; n--)
+    {
+      uint64_t id = read_varint(data, end);
+      if (id >= num_states)
+        throw std::runtime_error("cola: invalid checkpoint " + file);
+      todo_.emplace_back(*mstates[id], id);
+    }
+    for (unsigned i = 0; i < max_colors_.size(); i++)
+    {
+      max_colors_[i] = read_int(data, end);
+      min_colors_[i] = read_int(data, end);
+    }
+    if (om_.get(VERBOSE_LEVEL) >= 1)
+      std::cout << "Resumed from " << file << " with " << num_states << " macrostates and "
+                << todo_.size() << " to explore" << std::endl;
+    return true;
+  }
+
   // by default, the number of colors for each set is even
   spot::acc_cond::acc_code
   make_parity_condition(int base, bool odd, int num_colors)
@@ -1642,69 +2114,346 @@ public:
     unsigned num_sets = has_weak_acc && has_weak ? weak_base + 1 : weak_base;
     // the final one
     res_->set_acceptance(num_sets, acceptance);
+    // keep the layout for make_parity()
+    color_bases_.assign(max_colors_.size(), -1);
+    for (unsigned i = 0; i < max_colors_.size(); i++)
+      if (max_colors_[i] >= 0)
+        color_bases_[i] = color_bases[i];
+    weak_set_ = has_weak_acc && has_weak ? (int)weak_base : -1;
+  }
+
+  // the color of the accepting SCC i on an edge, even colors are accepting
+  int
+  color_of(spot::acc_cond::mark_t acc, unsigned i)
+  {
+    for (int c = min_colors_[i]; c < max_colors_[i]; c++)
+      if (acc.has((unsigned)(color_bases_[i] + c - min_colors_[i])))
+        return c;
+    return max_colors_[i];
+  }
+
+  // Replace the disjunction of parity conditions (and Fin of the weak set) by
+  // a single parity min even condition. Inside an SCC of res_, only one of the
+  // disjuncts may be satisfiable: its colors are then renumbered from 0 or 1,
+  // merging consecutive colors of the same parity, so all SCCs share the
+  // same small range of colors. Returns false and keeps res_ as is if an SCC
+  // needs several disjuncts, e.g., two accepting SCCs tracked at once.
+  bool
+  make_parity()
+  {
+    static const int REJECTING = -1;
+    static const int ACCEPTING = -2;
+    static const int MIXED = -3;
+    spot::scc_info si(res_, spot::scc_info_options::NONE);
+    // the disjunct used by each SCC
+    std::vector<int> disjunct(si.scc_count(), REJECTING);
+    std::vector<bool> has_weak(si.scc_count(), false);
+    std::vector<bool> has_non_weak(si.scc_count(), false);
+    for (auto &t : res_->edges())
+    {
+      unsigned scc = si.scc_of(t.src);
+      if (scc != si.scc_of(t.dst))
+        continue;
+      if (weak_set_ >= 0 && t.acc.has((unsigned)weak_set_))
+        has_weak[scc] = true;
+      else
+        has_non_weak[scc] = true;
+      for (unsigned i = 0; i < color_bases_.size(); i++)
+      {
+        if (color_bases_[i] < 0 || (color_of(t.acc, i) & 1))
+          continue;
+        if (disjunct[scc] == REJECTING || disjunct[scc] == (int)i)
+          disjunct[scc] = i;
+        else
+          disjunct[scc] = MIXED;
+      }
+    }
+    for (unsigned scc = 0; scc < si.scc_count(); scc++)
+    {
+      // Fin of the weak set holds on every cycle
+      if (weak_set_ >= 0 && !has_weak[scc])
+        disjunct[scc] = ACCEPTING;
+      else if (weak_set_ >= 0 && has_non_weak[scc])
+        disjunct[scc] = MIXED;
+      if (disjunct[scc] == MIXED)
+      {
+        if (om_.get(VERBOSE_LEVEL) >= 1)
+          std::cout << "SCC " << scc << " needs several accepting SCCs, keep the Emerson-Lei condition" << std::endl;
+        return false;
+      }
+    }
+    // the colors of the chosen disjunct in each SCC
+    std::vector<std::map<int, unsigned>> new_colors(si.scc_count());
+    for (auto &t : res_->edges())
+    {
+      unsigned scc = si.scc_of(t.src);
+      if (scc == si.scc_of(t.dst) && disjunct[scc] >= 0)
+        new_colors[scc].emplace(color_of(t.acc, disjunct[scc]), 0);
+    }
+    unsigned num_colors = 1;
+    for (auto &colors : new_colors)
+    {
+      unsigned color = 0;
+      int prev = -1;
+      for (auto &p : colors)
+      {
+        if (prev < 0)
+          color = p.first & 1;
+        else if ((p.first & 1) != (prev & 1))
+          color++;
+        p.second = color;
+        prev = p.first;
+      }
+      num_colors = std::max(num_colors, color + 1);
+    }
+    for (auto &t : res_->edges())
+    {
+      unsigned scc = si.scc_of(t.src);
+      spot::acc_cond::mark_t acc = {};
+      if (scc == si.scc_of(t.dst))
+      {
+        if (disjunct[scc] == ACCEPTING)
+          acc.set(0);
+        else if (disjunct[scc] == REJECTING)
+          acc.set(1);
+        else
+          acc.set(new_colors[scc][color_of(t.acc, disjunct[scc])]);
+      }
+      t.acc = acc;
+    }
+    num_colors = std::max(num_colors, 2u);
+    res_->set_acceptance(num_colors, spot::acc_cond::acc_code::parity_min_even(num_colors));
+    if (om_.get(VERBOSE_LEVEL) >= 1)
+      std::cout << "Parity condition with " << num_colors << " colors built per SCC" << std::endl;
+    return true;
+  }
+
+  // call f(letter, succ, colors) for each nonempty successor succ of ms,
+  // letter is a whole letter class with LETTER_CLASSES
+  template <typename F>
+  void
+  for_each_successor(const tnba_mstate &ms, size_t frontier, F f)
+  {
+    // the occurred variables in the outgoing transitions of ms and the
+    // letters that have some of them
+    const std::pair<bdd, bdd> &letters = reach_letters_.get(ms.get_reach());
+    bdd msupport = letters.first;
+    bdd all = letters.second;
+    // a letter class either implies or contradicts every guard of the
+    // states of ms, so compute_successors() can take it as one letter
+    const std::vector<bdd> *classes = nullptr;
+    if (use_letter_classes_)
+      classes = &letter_classes_.get(ms.get_reach(), all);
+    size_t next_class = 0;
+    while (classes ? next_class < classes->size() : all != bddfalse)
+    {
+      bdd letter;
+      if (classes)
+        letter = (*classes)[next_class++];
+      else
+      {
+        letter = bdd_satoneset(all, msupport, bddfalse);
+        all -= letter;
+      }
+      budget_.check(res_->num_states(), frontier);
+
+      // std::cout << "Current state = " << get_name(ms) << " letter = "<< letter << std::endl;
+      tnba_mstate succ(si_, acc_detsccs_.size(), acc_nondetsccs_.size());
+      // the number of SCCs we care is the accepting det SCCs and the weak SCCs
+      std::vector<int> colors(acc_detsccs_.size() + acc_nondetsccs_.size() + 1, -1);
+      //compute_labelling_successors(std::move(ms), top.second, letter, succ, color);
+      make_stutter_state(ms, letter, succ, colors);
+
+      if (succ.is_empty())
+        continue;
+      f(letter, succ, colors);
+    }
+  }
+
+  // update the range of colors of each accepting SCC
+  void
+  record_colors(const std::vector<int> &colors)
+  {
+    for (unsigned i = 0; i < colors.size() && i < max_colors_.size(); i++)
+    {
+      if (colors[i] < 0)
+        continue;
+      max_colors_[i] = std::max(max_colors_[i], colors[i]);
+      min_colors_[i] = std::min(min_colors_[i], colors[i]);
+    }
+  }
+
+  // Breadth-first exploration with the macrostates on the disk, for state
+  // spaces that do not fit in memory. The successors of a whole layer are
+  // sorted in runs of EXTERNAL_BFS MB and then merged with the sorted file of
+  // the visited macrostates, which finds the duplicates of the layer at once
+  // and gives the next layer. The edges go to a file and are only loaded
+  // into res_ at the end.
+  void
+  run_external()
+  {
+    size_t max_bytes = (size_t)om_.get(EXTERNAL_BFS) << 20;
+    // the initial macrostate has been created by the constructor
+    std::unique_ptr<record_file> layer(new record_file());
+    for (auto &p : todo_)
+    {
+      std::string id;
+      write_varint(id, p.second);
+      layer->write(p.first.to_bytes(), id);
+    }
+    todo_.clear();
+    visited_.reset(new record_file());
+    for (auto &p : rank2n_)
+    {
+      std::string id;
+      write_varint(id, p.second);
+      visited_->write(p.first.to_bytes(), id);
+    }
+    rank2n_.clear();
+    record_file edges;
+    std::string key, payload;
+    unsigned num_layers = 0;
+    edge_group<std::string, std::vector<int>> out;
+    while (layer->size() > 0)
+    {
+      external_sorter succs(max_bytes);
+      size_t frontier = layer->size();
+      layer->rewind();
+      while (layer->read(key, payload))
+      {
+        tnba_mstate ms(si_, acc_detsccs_.size(), acc_nondetsccs_.size());
+        ms.from_bytes(key);
+        const char *data = payload.data();
+        unsigned origin = read_varint(data, data + payload.size());
+        for_each_successor(ms, --frontier, [&](bdd letter, tnba_mstate &succ, std::vector<int> &colors)
+        {
+          record_colors(colors);
+          out.add(succ.to_bytes(), colors, letter);
+        });
+        out.flush([&](const std::string &succ, const std::vector<int> &colors, const bdd &cond)
+        {
+          // the edge without its successor
+          std::string edge;
+          write_varint(edge, origin);
+          write_guard(edge, cond, var2ap_);
+          for (int c : colors)
+            write_int(edge, c);
+          succs.add(succ, std::move(edge));
+        });
+      }
+
+      // delayed duplicate detection against the visited macrostates
+      std::unique_ptr<record_file> next(new record_file());
+      std::unique_ptr<record_file> visited(new record_file());
+      std::string vkey, vpayload;
+      visited_->rewind();
+      bool has_visited = visited_->read(vkey, vpayload);
+      std::string last;
+      unsigned dst = 0;
+      bool first = true;
+      size_t num_runs = succs.num_runs();
+      succs.merge([&](const std::string &succ, const std::string &edge)
+      {
+        if (first || succ != last)
+        {
+          while (has_visited && vkey < succ)
+          {
+            visited->write(vkey, vpayload);
+            has_visited = visited_->read(vkey, vpayload);
+          }
+          if (has_visited && vkey == succ)
+          {
+            const char *data = vpayload.data();
+            dst = read_varint(data, data + vpayload.size());
+            visited->write(vkey, vpayload);
+            has_visited = visited_->read(vkey, vpayload);
+          }
+          else
+          {
+            dst = res_->new_state();
+            std::string id;
+            write_varint(id, dst);
+            visited->write(succ, id);
+            next->write(succ, id);
+            if (show_names_)
+            {
+              tnba_mstate ms(si_, acc_detsccs_.size(), acc_nondetsccs_.size());
+              ms.from_bytes(succ);
+              names_->push_back(get_name(ms));
+            }
+          }
+          last = succ;
+          first = false;
+        }
+        std::string rec;
+        write_varint(rec, dst);
+        rec += edge;
+        edges.write(std::string(), rec);
+      });
+      while (has_visited)
+      {
+        visited->write(vkey, vpayload);
+        has_visited = visited_->read(vkey, vpayload);
+      }
+      visited_ = std::move(visited);
+      layer = std::move(next);
+      num_layers++;
+      if (om_.get(VERBOSE_LEVEL) >= 1)
+        std::cout << "Layer " << num_layers << ": " << layer->size() << " new macrostates, "
+                  << num_runs << " sorted runs on the disk" << std::endl;
+    }
+
+    edges.rewind();
+    while (edges.read(key, payload))
+    {
+      const char *data = payload.data();
+      const char *end = data + payload.size();
+      unsigned dst = read_varint(data, end);
+      unsigned origin = read_varint(data, end);
+      bdd cond = read_guard(data, end, ap_vars_);
+      std::vector<int> colors(acc_detsccs_.size() + acc_nondetsccs_.size() + 1);
+      for (int &c : colors)
+        c = read_int(data, end);
+      res_->new_edge(origin, dst, cond);
+      trans2colors_.emplace(std::make_pair(origin, cond), colors);
+    }
   }
 
   spot::twa_graph_ptr
   run()
   {
+    if (om_.get(EXTERNAL_BFS) > 0)
+      run_external();
     // Main stuff happens here
     // todo_ is a queue for handling states
+    edge_group<unsigned, std::vector<int>> out;
     while (!todo_.empty())
     {
       auto top = todo_.front();
       todo_.pop_front();
       // pop current state, (N, Rnk)
       tnba_mstate ms = top.first;
-
-      // Compute support of all available states.
-      bdd msupport = bddtrue;
-      bdd n_s_compat = bddfalse;
-      const std::set<unsigned>& reach_set = ms.get_reach_set();
-      // compute the occurred variables in the outgoing transitions of ms, stored in msupport
-      for (unsigned s : reach_set)
-        {
-          msupport &= support_[s];
-          n_s_compat |= compat_[s];
-        }
-
-      bdd all = n_s_compat;
-      while (all != bddfalse)
+      unsigned origin = top.second;
+      for_each_successor(ms, todo_.size(), [&](bdd letter, tnba_mstate &succ, std::vector<int> &colors)
       {
-        bdd letter = bdd_satoneset(all, msupport, bddfalse);
-        all -= letter;
-
-        // std::cout << "Current state = " << get_name(ms) << " letter = "<< letter << std::endl;
-        tnba_mstate succ(si_, acc_detsccs_.size(), acc_nondetsccs_.size());
-        // the number of SCCs we care is the accepting det SCCs and the weak SCCs
-        std::vector<int> colors(acc_detsccs_.size() + acc_nondetsccs_.size() + 1, -1);
-        //compute_labelling_successors(std::move(ms), top.second, letter, succ, color);
-        make_stutter_state(ms, letter, succ, colors);
-
-        if (succ.is_empty())
-          continue;
-
-        unsigned origin = top.second;
-        // add transitions
         // Create the automaton states
         unsigned dst = new_state(succ);
-        // first add this transition
-        res_->new_edge(origin, dst, letter);
         // handle with colors
-        // std::cout << "max_color_size = " << max_colors_.size() << " colors_size = " << colors.size() << "\n";  
-        for (unsigned i = 0; i < colors.size(); i++)
-        {
-          // std::cout << "color: " << colors[i] << std::endl;
-          if (colors[i] < 0)
-            continue;
-          int color = colors[i];
-          if (i < max_colors_.size())
-          {
-            max_colors_[i] = std::max(max_colors_[i], color);
-            min_colors_[i] = std::min(min_colors_[i], color);
-          }
-          // record this color
-        }
-        auto r = trans2colors_.emplace(std::make_pair(origin, letter), colors);
+        record_colors(colors);
+        out.add(dst, colors, letter);
+      });
+      // add transitions, one per successor and colors
+      out.flush([&](unsigned dst, const std::vector<int> &colors, const bdd &cond)
+      {
+        res_->new_edge(origin, dst, cond);
+        trans2colors_.emplace(std::make_pair(origin, cond), colors);
+      });
+      // only between two macrostates, when all edges of origin are there
+      if (!checkpoint_file_.empty() && std::chrono::steady_clock::now() - last_checkpoint_
+                                           >= std::chrono::seconds(om_.get(CHECKPOINT_INTERVAL)))
+      {
+        save_checkpoint();
+        last_checkpoint_ = std::chrono::steady_clock::now();
       }
     }
     finalize_acceptance();
@@ -1717,6 +2466,8 @@ public:
     {
       output_file(res_, "dpa.hoa");
       std::cout << "Before simplification #States: " << res_->num_states() << " #Colors: " << res_->num_sets() << std::endl;
+      std::cout << "Scratch buffers grown " << scratch_.num_allocations << " times for "
+                << scratch_.num_successors << " successors" << std::endl;
       if (om_.get(VERBOSE_LEVEL) >= 2) check_equivalence(aut_, res_);
     }
     if (om_.get(USE_SCC_INFO) > 0)
@@ -1727,7 +2478,9 @@ public:
       output_file(res_, "dpa1.hoa");
       if (om_.get(VERBOSE_LEVEL) >= 2) check_equivalence(aut_, res_);
     }
-    simplify_acceptance_here(res_);
+    // a parity condition saves acd_transform() on the whole result
+    if (om_.get(REQUIRE_PARITY) == 0 || !make_parity())
+      simplify_acceptance_here(res_);
 
     return res_;
   }
@@ -1739,9 +2492,22 @@ public:
     // set of states -> the forest of reachability in the states.
     mstate_equiv_map set2scc;
     // record the representative of every SCC
+    if (visited_)
+    {
+      std::string key, payload;
+      visited_->rewind();
+      while (visited_->read(key, payload))
+      {
+        tnba_mstate ms(si_, acc_detsccs_.size(), acc_nondetsccs_.size());
+        ms.from_bytes(key);
+        const char *data = payload.data();
+        set2scc.emplace(ms.get_reach_set(), state_set()).first->second.insert(read_varint(data, data + payload.size()));
+      }
+    }
     for (auto p = rank2n_.begin(); p != rank2n_.end(); p++)
     {
-      const std::set<unsigned> set = p->first.get_reach_set();
+      const std::vector<unsigned> &reach = p->first.get_reach();
+      const std::set<unsigned> set(reach.begin(), reach.end());
       // first the set of reached states
       auto val = set2scc.emplace(set, state_set());
       // no matter whether the insertion has happened
@@ -1758,27 +2524,21 @@ public:
 };
 
 spot::twa_graph_ptr
-determinize_tnba(const spot::const_twa_graph_ptr &aut, spot::option_map &om)
+determinize_tnba(const spot::const_twa_graph_ptr &aut, spot::option_map &om, budget *limits)
 {
-  if (!aut->acc().is_buchi())
+  analysis ctx(aut);
+  return determinize_tnba(ctx, om, limits);
+}
+
+spot::twa_graph_ptr
+determinize_tnba(analysis &ctx, spot::option_map &om, budget *limits)
+{
+  if (!ctx.get_aut()->acc().is_buchi())
     throw std::runtime_error("determinize_tnba() requires a Buchi input");
-  const int trans_pruning = om.get(NUM_TRANS_PRUNING);
-  // now we compute the simulator
-  spot::const_twa_graph_ptr aut_reduced;
-  std::vector<bdd> implications;
-  spot::twa_graph_ptr aut_tmp = nullptr;
-  if (om.get(USE_SIMULATION) > 0)
-  {
-    aut_tmp = spot::scc_filter(aut);
-    auto aut2 = spot::simulation(aut_tmp, &implications, trans_pruning);
-    aut_tmp = aut2;
-  }
-  if (aut_tmp)
-    aut_reduced = aut_tmp;
-  else
-    aut_reduced = aut;
-  spot::scc_info scc(aut_reduced, spot::scc_info_options::ALL);
-  auto det = cola::tnba_determinize(aut_reduced, scc, om, implications);
+  // the simulator is computed on the reduced automaton
+  analysis &input = om.get(USE_SIMULATION) > 0 ? ctx.get_reduced(om.get(NUM_TRANS_PRUNING)) : ctx;
+  budget local_limits(om);
+  auto det = cola::tnba_determinize(input, om, limits ? *limits : local_limits);
   return det.run();
 }
 }
\ No newline at end of file
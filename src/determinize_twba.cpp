@@ -17,6 +17,10 @@
 #include "cola.hpp"
 #include "simulation.hpp"
 #include "types.hpp"
+#include "hash.hpp"
+#include "budget.hpp"
+#include "analysis.hpp"
+#include "edge_group.hpp"
 //#include "struct.hpp"
 
 #include <deque>
@@ -94,17 +98,7 @@ namespace cola
   size_t
   wmstate::hash() const
   {
-    size_t res = 0;
-    for (unsigned i : reach_set_) // not sure how you're storing them
-    {
-      res = (res << 3) ^ (i);
-    }
-    for (unsigned i : break_set_)
-    {
-      res ^= (res << 3) ^ i;
-    }
-    
-    return res;
+    return hash_combine(hash_values(reach_set_), hash_values(break_set_));
   }
 
   std::string
@@ -138,7 +132,7 @@ namespace cola
     unsigned nb_states_;
 
     // unsigned nb_det_states_;
-    state_simulator simulator_;
+    const state_simulator &simulator_;
 
     // delayed simulator
     delayed_simulation delayed_simulator_;
@@ -151,6 +145,9 @@ namespace cola
 
     spot::option_map &om_;
 
+    // limits on the number of states, time and memory
+    budget &budget_;
+
     // number of colors used
     unsigned num_colors_;
 
@@ -172,11 +169,12 @@ namespace cola
     // States to process.
     std::deque<std::pair<wmstate, unsigned>> todo_;
 
-    // Support for each state of the source automaton.
-    std::vector<bdd> support_;
+    // Support for each state of the source automaton, extended by
+    // analysis::get_stutter_support() for the stutter steps.
+    const std::vector<bdd> &support_;
 
     // Propositions compatible with all transitions of a state.
-    std::vector<bdd> compat_;
+    const std::vector<bdd> &compat_;
 
     // State names for graphviz display
     std::vector<std::string> *names_;
@@ -382,24 +380,25 @@ namespace cola
     }
 
   public:
-    twba_determinize(const spot::const_twa_graph_ptr &aut, spot::scc_info &si, spot::option_map &om, std::vector<bdd> &implications)
-        : aut_(aut),
+    twba_determinize(analysis &ctx, spot::option_map &om, budget &limits)
+        : aut_(ctx.get_aut()),
           om_(om),
+          budget_(limits),
           use_simulation_(om.get(USE_SIMULATION) > 0),
           use_scc_(om.get(USE_SCC_INFO) > 0),
           use_stutter_(om.get(USE_STUTTER) > 0),
           use_unambiguous_(om.get(USE_UNAMBIGUITY) > 0),
-          si_(si),
-          nb_states_(aut->num_states()),
-          support_(nb_states_),
-          compat_(nb_states_),
-          simulator_(aut_, si, implications, om.get(USE_SIMULATION) > 0),
-          delayed_simulator_(aut, om),
+          si_(ctx.get_scc_info()),
+          nb_states_(aut_->num_states()),
+          support_(use_stutter_ && aut_->prop_stutter_invariant() ? ctx.get_stutter_support() : ctx.get_support()),
+          compat_(ctx.get_compat()),
+          simulator_(ctx.get_simulator()),
+          delayed_simulator_(aut_, om),
           show_names_(om.get(VERBOSE_LEVEL) >= 1)
     {
-      res_ = spot::make_twa_graph(aut->get_dict());
-      res_->copy_ap_of(aut);
-      res_->prop_copy(aut,
+      res_ = spot::make_twa_graph(aut_->get_dict());
+      res_->copy_ap_of(aut_);
+      res_->prop_copy(aut_,
                       {
                           false,        // state based
                           false,        // inherently_weak
@@ -407,45 +406,20 @@ namespace cola
                           true,         // complete
                           false         // stutter inv
                       });
-      // Generate bdd supports and compatible options for each state.
-      // Also check if all its transitions are accepting.
-      for (unsigned i = 0; i < nb_states_; ++i)
-      {
-        bdd res_support = bddtrue;
-        bdd res_compat = bddfalse;
-        for (const auto &out : aut->out(i))
-        {
-          res_support &= bdd_support(out.cond);
-          res_compat |= out.cond;
-        }
-        support_[i] = res_support;
-        compat_[i] = res_compat;
-      }
 
-      if (use_stutter_ && aut_->prop_stutter_invariant())
-      {
-        for (unsigned c = 0; c != si_.scc_count(); ++c)
-            {
-              bdd c_supp = si_.scc_ap_support(c);
-              for (const auto& su: si_.succ(c))
-                c_supp &= support_[si_.one_state_of(su)];
-              for (unsigned st: si_.states_of(c))
-                support_[st] = c_supp;
-            }
-      }
 
       //std::cout << "Simulator\n";
       //simulator_.output_simulation();
       // is_entering_ = get_accepting_reachable_sccs(si_);
       // optimize with the fact of being unambiguous
-      use_unambiguous_ = use_unambiguous_ && is_unambiguous(aut);
+      use_unambiguous_ = use_unambiguous_ && is_unambiguous(aut_);
       if (show_names_)
       {
         names_ = new std::vector<std::string>();
         res_->set_named_prop("state-names", names_);
       }
 
-      unsigned init_state = aut->get_init_state_number();
+      unsigned init_state = aut_->get_init_state_number();
       wmstate new_init_state(init_state);
       unsigned index = new_state(new_init_state);
       // we assume that the initial state is not in deterministic part
@@ -457,6 +431,7 @@ namespace cola
     {
       // Main stuff happens here
       // todo_ is a queue for handling states
+      edge_group<unsigned, spot::acc_cond::mark_t> out;
       while (!todo_.empty())
       {
         auto top = todo_.front();
@@ -478,6 +453,7 @@ namespace cola
         {
           bdd letter = bdd_satoneset(all, msupport, bddfalse);
           all -= letter;
+          budget_.check(res_->num_states(), todo_.size());
           // Compute all new states available from the generated
           // letter.
 
@@ -486,7 +462,6 @@ namespace cola
           //rank_successors(std::move(ms), top.second, letter, succ, color);
           make_stutter_state(ms, top.second, letter, succ, color);
 
-          unsigned origin = top.second;
           // add transitions
           // Create the automaton states
           unsigned dst = new_state(succ);
@@ -495,13 +470,18 @@ namespace cola
           {
             unsigned pri = (unsigned)color;
             //sets_ = std::max(pri, sets_);
-            res_->new_edge(origin, dst, letter, { 0});
+            out.add(dst, {0}, letter);
           }
           else
           {
-            res_->new_edge(origin, dst, letter);
+            out.add(dst, {}, letter);
           }
         }
+        // one edge per successor and colors
+        out.flush([&](unsigned dst, spot::acc_cond::mark_t acc, const bdd &cond)
+        {
+          res_->new_edge(top.second, dst, cond, acc);
+        });
       }
       // Acceptance is now min(odd) since we can emit Red on paths 0 with new opti
       res_->set_acceptance(1, spot::acc_cond::acc_code::fin({0}));
@@ -561,27 +541,21 @@ namespace cola
   };
 
   spot::twa_graph_ptr
-  determinize_twba(const spot::const_twa_graph_ptr &aut, spot::option_map &om)
+  determinize_twba(const spot::const_twa_graph_ptr &aut, spot::option_map &om, budget *limits)
   {
-    if (!aut->acc().is_buchi())
-      throw std::runtime_error("determinize_twba() requires a Buchi input");
-    // now we compute the simulator
-    spot::const_twa_graph_ptr aut_reduced;
-    std::vector<bdd> implications;
-    spot::twa_graph_ptr aut_tmp = nullptr;
-    if (om.get(USE_SIMULATION) > 0)
-    {
-      aut_tmp = spot::scc_filter(aut);
-      auto aut2 = spot::simulation(aut_tmp, &implications, om.get(NUM_TRANS_PRUNING));
-      aut_tmp = aut2;
-    }
-    if (aut_tmp)
-      aut_reduced = aut_tmp;
-    else
-      aut_reduced = aut;
-    spot::scc_info scc(aut_reduced, spot::scc_info_options::ALL);
+    analysis ctx(aut);
+    return determinize_twba(ctx, om, limits);
+  }
 
-    auto det = cola::twba_determinize(aut_reduced, scc, om, implications);
+  spot::twa_graph_ptr
+  determinize_twba(analysis &ctx, spot::option_map &om, budget *limits)
+  {
+    if (!ctx.get_aut()->acc().is_buchi())
+      throw std::runtime_error("determinize_twba() requires a Buchi input");
+    // the simulator is computed on the reduced automaton
+    analysis &input = om.get(USE_SIMULATION) > 0 ? ctx.get_reduced(om.get(NUM_TRANS_PRUNING)) : ctx;
+    budget local_limits(om);
+    auto det = cola::twba_determinize(input, om, limits ? *limits : local_limits);
     return det.run();
   }
 }
\ No newline at end of file
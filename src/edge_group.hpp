@@ -0,0 +1,63 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <bddx.h>
+
+namespace cola
+{
+  /// \brief The outgoing edges of one state, merged while its letters are
+  /// enumerated
+  ///
+  /// The constructions compute the successors of a macrostate letter by
+  /// letter. Instead of one edge per letter, the letters with the same
+  /// successor and the same colors are or-ed into one guard, and flush()
+  /// gives the merged edges once all letters have been seen, in the order
+  /// of their first letter.
+  template <typename Dst, typename Colors>
+  class edge_group
+  {
+  private:
+    std::vector<std::tuple<Dst, Colors, bdd>> edges_;
+    std::map<std::pair<Dst, Colors>, unsigned> index_;
+
+  public:
+    void
+    add(const Dst &dst, const Colors &colors, const bdd &letter)
+    {
+      auto it = index_.emplace(std::make_pair(dst, colors), edges_.size());
+      if (it.second)
+        edges_.emplace_back(dst, colors, letter);
+      else
+        std::get<2>(edges_[it.first->second]) |= letter;
+    }
+
+    // call f(dst, colors, guard) on every edge and forget them
+    template <typename F>
+    void
+    flush(F f)
+    {
+      for (const auto &e : edges_)
+        f(std::get<0>(e), std::get<1>(e), std::get<2>(e));
+      edges_.clear();
+      index_.clear();
+    }
+  };
+}
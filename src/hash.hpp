@@ -0,0 +1,90 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// hash functions for the macrostates of all constructions
+namespace cola
+{
+  // the finalizer of MurmurHash3, every bit of h affects every bit of the result
+  inline uint64_t
+  mix64(uint64_t h)
+  {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  // a (state, value) pair as one word, distinct pairs give distinct words
+  template <typename Pair>
+  inline uint64_t
+  pack_pair(const Pair &p)
+  {
+    return ((uint64_t)(uint32_t)p.first << 32) | (uint32_t)(int64_t)p.second;
+  }
+
+  /// \brief Hash of a vector of (state, value) pairs
+  ///
+  /// The pairs are consumed by four independent lanes that only
+  /// multiply and shift, so the loop can be vectorized by the compiler.
+  template <typename Pairs>
+  inline size_t
+  hash_pairs(const Pairs &pairs, uint64_t seed = 0)
+  {
+    const uint64_t k = 0x9e3779b97f4a7c15ULL;
+    uint64_t lanes[4] = {seed, seed + k, seed + 2 * k, seed + 3 * k};
+    const size_t n = pairs.size();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+      for (unsigned l = 0; l < 4; l++)
+      {
+        uint64_t h = (lanes[l] ^ pack_pair(pairs[i + l])) * k;
+        lanes[l] = h ^ (h >> 32);
+      }
+    }
+    for (unsigned l = 0; i < n; i++, l++)
+    {
+      uint64_t h = (lanes[l] ^ pack_pair(pairs[i])) * k;
+      lanes[l] = h ^ (h >> 32);
+    }
+    uint64_t res = n;
+    for (unsigned l = 0; l < 4; l++)
+      res = mix64(res ^ lanes[l]);
+    return res;
+  }
+
+  // hash of a sequence of values, e.g., a set of states
+  template <typename Values>
+  inline size_t
+  hash_values(const Values &values, uint64_t seed = 0)
+  {
+    uint64_t res = seed;
+    for (const auto &v : values)
+      res = mix64((res ^ (uint64_t)(int64_t)v) + 0x9e3779b97f4a7c15ULL);
+    return res;
+  }
+
+  inline size_t
+  hash_combine(size_t seed, size_t h)
+  {
+    return mix64(seed ^ (h + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+  }
+}
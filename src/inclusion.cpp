@@ -0,0 +1,341 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "cola.hpp"
+#include "analysis.hpp"
+#include "budget.hpp"
+#include "hash.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include <spot/twaalgos/complement.hh>
+
+// Language inclusion L(A) ⊆ L(B) by searching for an accepting cycle in the
+// product of A with the complement of B, i.e., a word in L(A) \ L(B).
+// The product is explored with the SCC-based emptiness check of Couvreur,
+// and the states of closed SCCs, which have no accepting runs, are kept in
+// an antichain: a new state (q, M) is not explored if there is such a dead
+// state (p, M') with p simulating q and L(M) ⊆ L(M'), since
+// L(q) ∩ L(M) ⊆ L(p) ∩ L(M') = ∅.
+
+namespace cola
+{
+  // a state of the product, the macrostate belongs to the complement
+  typedef std::pair<unsigned, const spot::state *> product_state;
+
+  struct product_state_hash
+  {
+    size_t
+    operator()(const product_state &s) const noexcept
+    {
+      return hash_combine(s.first, s.second->hash());
+    }
+  };
+
+  struct product_state_equal
+  {
+    bool
+    operator()(const product_state &s, const product_state &t) const
+    {
+      return s.first == t.first && s.second->compare(t.second) == 0;
+    }
+  };
+
+  class inclusion_checker
+  {
+  private:
+    // the dfs number of the states whose SCCs are closed
+    static const int DEAD = -1;
+
+    // A
+    const spot::const_twa_graph_ptr aut_;
+
+    // the complement of B from complement_tnba_onthefly()
+    const spot::const_twa_ptr comp_;
+
+    spot::option_map &om_;
+
+    // limits on the number of states, time and memory
+    budget &budget_;
+
+    // the explored part of the product, an accepting cycle is read from it
+    spot::twa_graph_ptr res_;
+
+    // all acceptance sets of the product, the one of A and then the two of the complement
+    spot::acc_cond::mark_t all_sets_;
+
+    std::unordered_map<product_state, unsigned, product_state_hash, product_state_equal> state2n_;
+    std::vector<product_state> n2state_;
+
+    // dfs number of the states, 0 if the state has not been visited yet
+    std::vector<int> num_;
+
+    // the states of A that simulate a state, including itself
+    std::vector<std::vector<unsigned>> simulators_;
+
+    // the macrostates of the dead states for each state of A, none of them
+    // accepts a subset of the words of another
+    std::vector<std::vector<const spot::state *>> dead_;
+
+    bool
+    is_subsumed(unsigned q, const spot::state *m)
+    {
+      for (unsigned p : simulators_[q])
+        for (const spot::state *d : dead_[p])
+          if (complement_tnba_included(comp_, m, d))
+            return true;
+      return false;
+    }
+
+    void
+    add_dead(unsigned n)
+    {
+      const product_state &s = n2state_[n];
+      std::vector<const spot::state *> &dead = dead_[s.first];
+      // keep the antichain
+      auto it = dead.begin();
+      while (it != dead.end())
+      {
+        if (complement_tnba_included(comp_, *it, s.second))
+          it = dead.erase(it);
+        else
+          ++it;
+      }
+      dead.push_back(s.second);
+    }
+
+    // the number of the product state (q, m), -1 if it is subsumed by a dead state
+    int
+    get_state(unsigned q, const spot::state *m)
+    {
+      auto it = state2n_.find(product_state(q, m));
+      if (it != state2n_.end())
+        return it->second;
+      if (is_subsumed(q, m))
+        return -1;
+      unsigned n = res_->new_state();
+      n2state_.emplace_back(q, m->clone());
+      state2n_.emplace(n2state_.back(), n);
+      num_.push_back(0);
+      return n;
+    }
+
+    // add the edges of n to the explored product
+    void
+    compute_successors(unsigned n, std::vector<std::pair<unsigned, spot::acc_cond::mark_t>> &succs)
+    {
+      unsigned q = n2state_[n].first;
+      spot::twa_succ_iterator *it = comp_->succ_iter(n2state_[n].second);
+      for (it->first(); !it->done(); it->next())
+      {
+        bdd letter = it->cond();
+        const spot::state *m = nullptr;
+        for (const auto &t : aut_->out(q))
+        {
+          bdd cond = t.cond & letter;
+          if (cond == bddfalse)
+            continue;
+          if (m == nullptr)
+            m = it->dst();
+          int dst = get_state(t.dst, m);
+          if (dst < 0)
+            continue;
+          spot::acc_cond::mark_t acc = t.acc | (it->acc() << 1);
+          res_->new_edge(n, dst, cond, acc);
+          succs.emplace_back(dst, acc);
+        }
+        if (m != nullptr)
+          m->destroy();
+      }
+      comp_->release_iter(it);
+    }
+
+  public:
+    inclusion_checker(analysis &ctx, const spot::const_twa_ptr &comp, spot::option_map &om, budget &limits)
+        : aut_(ctx.get_aut()),
+          comp_(comp),
+          om_(om),
+          budget_(limits),
+          all_sets_({0, 1, 2}),
+          simulators_(aut_->num_states()),
+          dead_(aut_->num_states())
+    {
+      res_ = spot::make_twa_graph(aut_->get_dict());
+      res_->copy_ap_of(aut_);
+      for (const auto &ap : comp_->ap())
+        res_->register_ap(ap);
+      res_->set_generalized_buchi(3);
+      bool use_simulation = om.get(USE_SIMULATION) > 0;
+      for (unsigned q = 0; q < aut_->num_states(); q++)
+      {
+        simulators_[q].push_back(q);
+        if (!use_simulation)
+          continue;
+        for (unsigned p = 0; p < aut_->num_states(); p++)
+          if (p != q && ctx.get_simulator().simulate(p, q))
+            simulators_[q].push_back(p);
+      }
+    }
+
+    ~inclusion_checker()
+    {
+      for (const product_state &s : n2state_)
+        s.second->destroy();
+    }
+
+    // a word accepted by the product, nullptr if there is none
+    spot::twa_word_ptr
+    run()
+    {
+      // a path of the dfs, with the successors of each state
+      struct dfs_entry
+      {
+        unsigned n;
+        std::vector<std::pair<unsigned, spot::acc_cond::mark_t>> succs;
+        size_t pos = 0;
+      };
+      // the root of an SCC on the path, with the sets seen inside and on the edge entering it
+      struct root_entry
+      {
+        int num;
+        spot::acc_cond::mark_t acc;
+        spot::acc_cond::mark_t in;
+      };
+      std::vector<dfs_entry> dfs;
+      std::vector<root_entry> roots;
+      // the states of the SCCs that are not closed yet
+      std::vector<unsigned> live;
+      int count = 0;
+
+      auto push = [&](unsigned n, spot::acc_cond::mark_t in)
+      {
+        num_[n] = ++count;
+        roots.push_back({count, {}, in});
+        live.push_back(n);
+        dfs.emplace_back();
+        dfs.back().n = n;
+        compute_successors(n, dfs.back().succs);
+      };
+
+      const spot::state *init = comp_->get_init_state();
+      unsigned init_n = get_state(aut_->get_init_state_number(), init);
+      init->destroy();
+      res_->set_init_state(init_n);
+      push(init_n, {});
+
+      while (!dfs.empty())
+      {
+        budget_.check(res_->num_states(), dfs.size());
+        dfs_entry &top = dfs.back();
+        if (top.pos < top.succs.size())
+        {
+          unsigned dst = top.succs[top.pos].first;
+          spot::acc_cond::mark_t acc = top.succs[top.pos].second;
+          top.pos++;
+          if (num_[dst] == 0)
+          {
+            // a dead state found since dst has been created may subsume it
+            if (is_subsumed(n2state_[dst].first, n2state_[dst].second))
+              num_[dst] = DEAD;
+            else
+              push(dst, acc);
+            continue;
+          }
+          if (num_[dst] == DEAD)
+            continue;
+          // dst is on the path, merge the SCCs on the cycle
+          while (roots.back().num > num_[dst])
+          {
+            acc |= roots.back().acc | roots.back().in;
+            roots.pop_back();
+          }
+          roots.back().acc |= acc;
+          if (roots.back().acc == all_sets_)
+          {
+            if (om_.get(VERBOSE_LEVEL) > 0)
+              std::cout << "Found an accepting cycle after exploring " << res_->num_states() << " product states" << std::endl;
+            spot::twa_word_ptr word = res_->accepting_word();
+            word->simplify();
+            return word;
+          }
+        }
+        else
+        {
+          unsigned n = top.n;
+          dfs.pop_back();
+          if (roots.back().num != num_[n])
+            continue;
+          // n is the root of a closed SCC without accepting cycles
+          roots.pop_back();
+          unsigned s;
+          do
+          {
+            s = live.back();
+            live.pop_back();
+            num_[s] = DEAD;
+            add_dead(s);
+          } while (s != n);
+        }
+      }
+      if (om_.get(VERBOSE_LEVEL) > 0)
+        std::cout << "No accepting cycle in " << res_->num_states() << " product states" << std::endl;
+      return nullptr;
+    }
+  };
+
+  bool
+  contains(const spot::const_twa_graph_ptr &A, const spot::const_twa_graph_ptr &B, spot::option_map &om
+  , spot::twa_word_ptr *counterexample, budget *limits)
+  {
+    if (A->get_dict() != B->get_dict())
+      throw std::runtime_error("contains() requires automata sharing the same BDD dictionary");
+    if (!A->acc().is_buchi() || !B->acc().is_buchi())
+      throw std::runtime_error("contains() requires Buchi inputs");
+    spot::twa_word_ptr word;
+    analysis ctx_b(B);
+    if (!ctx_b.is_elevator())
+    {
+      // complement_tnba() only handles elevator automata
+      word = A->intersecting_word(spot::complement(B));
+    }
+    else
+    {
+      analysis ctx_a(A);
+      analysis &input = om.get(USE_SIMULATION) > 0 ? ctx_a.get_reduced(om.get(NUM_TRANS_PRUNING)) : ctx_a;
+      budget local_limits(om);
+      inclusion_checker checker(input, complement_tnba_onthefly(B, om), om, limits ? *limits : local_limits);
+      word = checker.run();
+    }
+    if (counterexample)
+      *counterexample = word;
+    return word == nullptr;
+  }
+
+  bool
+  is_universal(const spot::const_twa_graph_ptr &A, spot::option_map &om
+  , spot::twa_word_ptr *counterexample, budget *limits)
+  {
+    // L(A) = Σ^ω iff the automaton accepting every word is included in A
+    spot::twa_graph_ptr all = spot::make_twa_graph(A->get_dict());
+    all->copy_ap_of(A);
+    all->set_buchi();
+    all->new_state();
+    all->new_edge(0, 0, bddtrue, {0});
+    all->set_init_state(0);
+    return contains(all, A, om, counterexample, limits);
+  }
+}
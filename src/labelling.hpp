@@ -0,0 +1,143 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "cola.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace cola
+{
+  // state and the labelling value
+  typedef std::pair<unsigned, int> label;
+
+  // the states of a macrostate with their labelling values, sorted by state;
+  // missing states (RANK_M) are not stored
+  typedef std::vector<label> sparse_labelling;
+
+  // the entry of s, ms.end() if s is missing
+  inline sparse_labelling::iterator
+  find_label(sparse_labelling &ms, unsigned s)
+  {
+    auto it = std::lower_bound(ms.begin(), ms.end(), label(s, RANK_M),
+                               [](const label &a, const label &b) { return a.first < b.first; });
+    if (it == ms.end() || it->first != s)
+      return ms.end();
+    return it;
+  }
+
+  // the labelling value of s, RANK_M if s is missing
+  inline int
+  label_of(const sparse_labelling &ms, unsigned s)
+  {
+    auto it = std::lower_bound(ms.begin(), ms.end(), label(s, RANK_M),
+                               [](const label &a, const label &b) { return a.first < b.first; });
+    if (it == ms.end() || it->first != s)
+      return RANK_M;
+    return it->second;
+  }
+
+  // the lexicographic order of the dense vectors, i.e., with RANK_M for the missing states
+  inline bool
+  dense_less(const sparse_labelling &lhs, const sparse_labelling &rhs)
+  {
+    auto l = lhs.begin();
+    auto r = rhs.begin();
+    while (l != lhs.end() || r != rhs.end())
+    {
+      if (r == rhs.end() || (l != lhs.end() && l->first < r->first))
+        return l->second < RANK_M;
+      if (l == lhs.end() || r->first < l->first)
+        return RANK_M < r->second;
+      if (l->second != r->second)
+        return l->second < r->second;
+      ++l;
+      ++r;
+    }
+    return false;
+  }
+
+  /// \brief A dense array of labelling values for computing a successor
+  ///
+  /// Only the touched states are reset after a successor has been collected,
+  /// so a successor costs time in the number of reached states rather than
+  /// the number of states of the input automaton.
+  class labelling_scratch
+  {
+  private:
+    std::vector<int> values_;
+    std::vector<bool> is_touched_;
+    std::vector<unsigned> touched_;
+
+  public:
+    labelling_scratch(unsigned num_states)
+        : values_(num_states, RANK_M), is_touched_(num_states, false)
+    {
+    }
+
+    int
+    get(unsigned s) const
+    {
+      return values_[s];
+    }
+
+    void
+    set(unsigned s, int value)
+    {
+      if (!is_touched_[s])
+      {
+        is_touched_[s] = true;
+        touched_.push_back(s);
+      }
+      values_[s] = value;
+    }
+
+    // the states set since the last collect(), in no particular order
+    const std::vector<unsigned> &
+    touched() const
+    {
+      return touched_;
+    }
+
+    // the reached states sorted by state, then reset the array
+    void
+    collect(sparse_labelling &res)
+    {
+      res.clear();
+      // a scan is cheaper than sorting once most of the states are reached
+      if (touched_.size() * 16 > values_.size())
+      {
+        for (unsigned s = 0; s < values_.size(); s++)
+          if (values_[s] != RANK_M)
+            res.emplace_back(s, values_[s]);
+      }
+      else
+      {
+        std::sort(touched_.begin(), touched_.end());
+        for (unsigned s : touched_)
+          if (values_[s] != RANK_M)
+            res.emplace_back(s, values_[s]);
+      }
+      for (unsigned s : touched_)
+      {
+        values_[s] = RANK_M;
+        is_touched_[s] = false;
+      }
+      touched_.clear();
+    }
+  };
+}
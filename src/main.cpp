@@ -24,10 +24,19 @@
 #include "optimizer.hpp"
 #include "decomposer.hpp"
 #include "simulation.hpp"
+#include "budget.hpp"
+#include "portfolio.hpp"
+#include "selector.hpp"
+#include "analysis.hpp"
+#include "server.hpp"
+#include "result_cache.hpp"
+#include "binary.hpp"
+#include "batch.hpp"
 // #include "postproc.hpp"
 
 #include <unistd.h>
 #include <fstream>
+#include <memory>
 #include <ctime>
 #include <string>
 #include <sstream>
@@ -63,18 +72,38 @@ and converts it into deterministic automata.
 
 Input options:
     -f FILENAME reads the input from FILENAME instead of stdin
-    --determinize=[spot|ba|cola]
+    --determinize=[spot|ba|cola|portfolio]
             Use Spot or our algorithm for TBA or let cola decide which one to obtain deterministic automata
-    --algo=[det|comp]
+            portfolio runs cola and Spot at the same time and keeps the first (smaller) result
+    --determinize=auto
+            Choose the construction and the decomposition with a cost model on the SCCs of the input,
+            whose coefficients are placeholders unless --calibration is given
+    --calibration=FILE
+            Read the coefficients of the cost model for --determinize=auto from FILE
+    --calibrate=FILE
+            Run every applicable construction on the inputs and write the fitted cost model to FILE
+    --portfolio-ratio=[INT]
+            Stop cola once it has INT% of the states of the finished Spot result (default=100)
+    --algo=[det|comp|ncsb|ncsb-lazy|ncb|nsbc]
             Use determinization or complementation algorithms to obtain the output
+            comp outputs a Buchi complement, elevator automata are complemented directly
+            and the other inputs through the determinization
+            ncsb, ncsb-lazy and nsbc complement semi-deterministic inputs, ncb unambiguous inputs,
+            the other inputs are complemented as with comp
     --type 
             Output the type of the input Buchi automaton: limit-deterministic, cut-deterministic, unambiguous or none of them
     --print-scc
             Output the information about the SCCs in the input NBA
+    --inclusion
+            Read the input automata in pairs (A, B) and check whether L(A) is included in L(B),
+            a word of L(A) \ L(B) is printed otherwise
+    --universality
+            Check whether the input automata accept every word, a rejected word is printed otherwise
 
 Output options:
     --verbose=[INT] Output verbose level (0 = minimal level, 1 = meduim level, 2 = debug level)
     -o FILENAME     Write the output to FILENAME instead of stdout
+    --binary        Write the output in the binary format of COLA, which is also accepted as input
     --generic       Output the automaton with Emenson-Lei acceptance condition (Default)
     --rabin         Output the automaton with Rabin acceptance condition
     --parity        Output the automaton with Pairty acceptance condition
@@ -91,12 +120,52 @@ Optimizations:
     --delayed-sim         Use delayed simulation for determinization
     --trans-pruning=[INT] Number to limit the transition pruning in simulation (default=512) 
     --decompose=[NUM-SCC] Use SCC decomposition to determinizing small BAs (deprecated)
+    --decompose-post      Simplify the pieces of --decompose with Spot before determinizing them
+    --decompose-jobs=[INT] Determinize the pieces of --decompose in INT processes (default=1)
     --unambiguous         Check whether the input is unambiguous and use this fact in determinization
+    --letter-classes      Compute one successor per class of letters with the same edges in --determinize=cola
+            Ignored on stutter-invariant inputs with --stutter
 
 Pre- and Post-processing:
     --preprocess=[0|1|2|3]       Level for simplifying the input automaton (default=1)
     --postprocess-det[=0|1|2|3]  Level for simplifying the output of the determinization (default=1)
     --num-states=[INT]           Simplify the output with number of states less than INT (default=30000)
+    --post-time=[INT]            Milliseconds for simplifying larger outputs SCC by SCC (default=1000, 0 = no limit)
+    --bisim                      Merge the bisimilar states of the deterministic output, independently of --postprocess-det
+
+Resource limits:
+    --max-states=[INT]  Abort a construction creating more than INT states
+    --timeout=[INT]     Abort after INT seconds spent on one automaton
+    --max-memory=[INT]  Abort once the process uses more than INT MB of memory
+    --budget-report     Print the partial exploration when aborting
+            An aborted run exits with status 3
+    --external-bfs=[INT] Keep the macrostates of --determinize=cola on the disk, sorting at most INT MB in memory
+            The spill files are created in $TMPDIR (default /tmp)
+
+Checkpoints:
+    --checkpoint=FILE            Save the exploration of --determinize=cola to FILE from time to time
+    --checkpoint-interval=[INT]  Seconds between two checkpoints (default=600)
+    --resume=FILE                Continue the exploration saved in FILE, with the same input and options
+            The result is the same as without interruption, and the checkpoints
+            go on to FILE unless --checkpoint is given
+
+Batch mode:
+    --jobs=[INT]        Process the automata of an input file in INT processes (default=1)
+            The file is mapped in memory and split at the end of each automaton,
+            the results are printed in the order of the input
+
+Result cache:
+    --result-cache=DIR          Keep the results in DIR and reuse them for the same input and options
+    --result-cache-size=[INT]   Remove the least recently used results beyond INT MB (default=1024, 0 = no bound)
+
+Server mode:
+    --serve[=SOCKET]    Answer requests on stdin/stdout or on the Unix domain socket SOCKET
+            A request is "<length>\n" followed by a line of options and the input automata,
+            a response is "ok <length>\n" or "error <length>\n" followed by the statistics
+            and the result. The options on the command line are the defaults of the requests,
+            a request of length 0 stops the server
+    --cache-size=[INT]  Keep the analysis of the last INT inputs (default=64)
+    --gc-interval=[INT] Collect the unused BDDs every INT requests (default=100)
 
 Miscellaneous options:
   -h, --help    Print this help
@@ -135,53 +204,210 @@ enum determinize_t
   COLA,
   LDBA,
   EBA, // elevator Buchi automata
-  Spot
+  Spot,
+  Portfolio, // cola against Spot
+  Auto // chosen by the cost model
 };
 
 // determinization
 enum complement_t
 {
   NoComplement = 0,
-  NCSB,
+  NCSB, // semi-deterministic inputs
+  NCSB_LAZY,
+  NCB,  // unambiguous inputs
+  NSBC, // semi-deterministic inputs
   SCC,
 };
 
 spot::twa_graph_ptr
-to_deterministic(spot::twa_graph_ptr aut, spot::option_map &om, unsigned aut_type, determinize_t algo)
+to_deterministic(cola::analysis &ctx, spot::option_map &om, determinize_t algo, cola::budget &limits)
 {
+  const spot::const_twa_graph_ptr &aut = ctx.get_aut();
   // determinization
   spot::twa_graph_ptr res;
   if (algo == COLA)
   {
-    if (aut_type & INHERENTLY_WEAK)
-      res = cola::determinize_twba(aut, om);
+    if (ctx.is_weak())
+      res = cola::determinize_twba(ctx, om, &limits);
     else
-      res = cola::determinize_tnba(aut, om);
+      res = cola::determinize_tnba(ctx, om, &limits);
   }
   else if (algo == LDBA)
   {
-    res = cola::determinize_tldba(aut, om);
+    res = cola::determinize_tldba(ctx, om, &limits);
   }else if (algo == EBA)
   {
-    res = cola::determinize_televator(aut, om);
+    res = cola::determinize_televator(ctx, om, &limits);
   }
   else if (algo == NBA)
   {
-    res = cola::determinize_tnba(aut, om);
+    res = cola::determinize_tnba(ctx, om, &limits);
   }
   else if (algo == Spot)
   {
+    // Spot can only be stopped by the number of states
+    spot::output_aborter aborter(limits.get_max_states());
     // pretty_print, use_scc, use_simulation, use_stutter, aborter
     res = spot::tgba_determinize(aut, om.get(VERBOSE_LEVEL) >= 2, om.get(USE_SCC_INFO) > 0
-    , om.get(USE_SIMULATION) > 0, om.get(USE_STUTTER), nullptr, om.get(NUM_TRANS_PRUNING));
+    , om.get(USE_SIMULATION) > 0, om.get(USE_STUTTER), limits.get_max_states() > 0 ? &aborter : nullptr, om.get(NUM_TRANS_PRUNING));
+    if (!res)
+      throw cola::budget_exceeded("max-states", limits.get_max_states(), 0, cola::budget::current_memory_kb(), limits.elapsed_ms());
     if (om.get(VERBOSE_LEVEL) >= 2)
     {
       cola::output_file(res, "dpa_spot.hoa");
     }
   }
+  else if (algo == Portfolio)
+  {
+    cola::portfolio racer(aut, om, limits);
+    res = racer.run([&](cola::budget &b)
+    {
+      if (ctx.is_weak())
+        return cola::determinize_twba(ctx, om, &b);
+      return cola::determinize_tnba(ctx, om, &b);
+    });
+    std::cerr << "cola: portfolio winner: " << racer.winner() << " with " << res->num_states() << " states\n";
+  }
   return res;
 }
 
+// determinize every piece from the decomposer and compose the results
+spot::twa_graph_ptr
+decompose_to_deterministic(spot::twa_graph_ptr aut, spot::option_map &om, determinize_t algo, cola::budget &limits)
+{
+  cola::decomposer nba_decomposer(aut, om);
+  std::vector<spot::twa_graph_ptr> subnbas = nba_decomposer.run();
+  std::vector<spot::twa_graph_ptr> dpas(subnbas.size());
+  if (om.get(DECOMPOSE_JOBS) <= 1 || subnbas.size() <= 1)
+  {
+    for (unsigned i = 0; i < subnbas.size(); i++)
+    {
+      cola::analysis piece(subnbas[i]);
+      dpas[i] = to_deterministic(piece, om, algo, limits);
+    }
+    cola::composer dpa_composer(dpas, om);
+    return dpa_composer.run();
+  }
+  // the budget or the error of the first piece that has failed
+  int failed = 0;
+  std::string failure;
+  // each worker has its own copy of the budget, and sends its pieces back
+  // in the binary format, or the report of the exceeded budget
+  cola::run_batch(subnbas.size(), om.get(DECOMPOSE_JOBS), [&](size_t i, std::string &res)
+  {
+    cola::analysis piece(subnbas[i]);
+    std::ostringstream out;
+    try
+    {
+      cola::print_binary(out, to_deterministic(piece, om, algo, limits));
+    }
+    catch (const cola::budget_exceeded &e)
+    {
+      out << e.num_states() << ' ' << e.frontier() << ' ' << e.memory_kb() << ' ' << e.elapsed_ms() << ' ' << e.reason();
+      res = out.str();
+      return 3;
+    }
+    res = out.str();
+    return 0;
+  },
+  [&](size_t i, int status, const std::string &res)
+  {
+    if (status == 0)
+    {
+      const char *data = res.data();
+      dpas[i] = cola::parse_binary(data, data + res.size(), aut->get_dict());
+    }
+    else if (failed == 0)
+    {
+      failed = status;
+      failure = res;
+    }
+  });
+  if (failed == 3)
+  {
+    unsigned num_states;
+    size_t frontier, memory_kb;
+    double elapsed_ms;
+    std::istringstream report(failure);
+    report >> num_states >> frontier >> memory_kb >> elapsed_ms >> std::ws;
+    std::string reason;
+    std::getline(report, reason);
+    throw cola::budget_exceeded(reason, num_states, frontier, memory_kb, elapsed_ms);
+  }
+  if (failed != 0)
+  {
+    // the message of the exception in the worker
+    if (!failure.empty() && failure.back() == '\n')
+      failure.pop_back();
+    throw std::runtime_error(failure);
+  }
+  cola::composer dpa_composer(dpas, om);
+  return dpa_composer.run();
+}
+
+determinize_t
+engine_to_algo(cola::det_engine engine)
+{
+  switch (engine)
+  {
+  case cola::ENGINE_TWBA:
+    return COLA;
+  case cola::ENGINE_TLDBA:
+    return LDBA;
+  case cola::ENGINE_TEBA:
+    return EBA;
+  case cola::ENGINE_SPOT:
+    return Spot;
+  default:
+    return NBA;
+  }
+}
+
+// run every applicable construction on aut and record the sizes of the results
+void
+calibrate_on(cola::analysis &ctx, spot::option_map &om, const cola::scc_stats &stats, cola::algorithm_selector &selector)
+{
+  spot::twa_graph_ptr aut = std::const_pointer_cast<spot::twa_graph>(ctx.get_aut());
+  for (unsigned e = 0; e < cola::NUM_ENGINES; e++)
+  {
+    cola::det_engine engine = (cola::det_engine)e;
+    for (int k : cola::algorithm_selector::decomposition_choices(engine))
+    {
+      if (selector.predict(engine, stats, k) < 0)
+        continue;
+      cola::budget limits(om);
+      unsigned num_states = 0;
+      try
+      {
+        spot::twa_graph_ptr res;
+        if (engine == cola::ENGINE_TNBA_DECOMPOSED)
+        {
+          // the number of pieces is only for this sample
+          spot::option_map sample_om = om;
+          sample_om.set(NUM_NBA_DECOMPOSED, k);
+          res = decompose_to_deterministic(aut, sample_om, NBA, limits);
+        }
+        else
+        {
+          res = to_deterministic(ctx, om, engine_to_algo(engine), limits);
+        }
+        num_states = res->num_states();
+      }
+      catch (const cola::budget_exceeded &e)
+      {
+        // the limit is still a lower bound on the size
+        num_states = e.num_states();
+      }
+      selector.add_sample(engine, stats, k, num_states);
+      if (om.get(VERBOSE_LEVEL) > 0)
+        std::cout << "Calibration: " << cola::algorithm_selector::engine_name(engine)
+                  << " predicted " << selector.predict(engine, stats, k)
+                  << " obtained " << num_states << " states" << std::endl;
+    }
+  }
+}
+
 spot::twa_graph_ptr
 to_tba(spot::twa_graph_ptr aut)
 {
@@ -193,7 +419,23 @@ to_tba(spot::twa_graph_ptr aut)
   return aut;
 }
 
-int main(int argc, char *argv[])
+enum postprocess_level
+{
+  None = 0,
+  Low,
+  Medium,
+  High
+};
+
+enum output_aut_type
+{
+  Generic = 0,
+  Rabin,
+  Parity
+};
+
+// the options of a run, from the command line or from a request of --serve
+struct cola_settings
 {
   // Declaration for input options. The rest is in cola.hpp
   // as they need to be included in other files.
@@ -202,24 +444,6 @@ int main(int argc, char *argv[])
   std::vector<std::string> path_to_files;
 
   spot::option_map om;
-  // default setting
-  om.set(USE_SIMULATION, 0);
-  om.set(USE_STUTTER, 0);
-  om.set(USE_UNAMBIGUITY, 0);
-  om.set(USE_SCC_INFO, 0);
-  om.set(VERBOSE_LEVEL, 0);
-  om.set(USE_DELAYED_SIMULATION, 0);
-  om.set(MORE_ACC_EDGES, 0);
-  om.set(NUM_TRANS_PRUNING, 512);
-  om.set(MSTATE_REARRANGE, 0);
-
-  // Will be deleted
-  //  --scc-mem-limit=[INT] 
-  //          The memory limit (MB) for computing the SCC reachability (default = 0, no limit)
-  //  --scc-num-limit=[INT] 
-  //          The largest number of SCCs in the deterministic automaton for merging macrostates (default = 0, no limit)
-  om.set(SCC_REACH_MEMORY_LIMIT, 0);
-  om.set(NUM_SCC_LIMIT_MERGER, 0);
 
   determinize_t determinize = NoDeterminize;
 
@@ -236,195 +460,351 @@ int main(int argc, char *argv[])
   bool use_acd = false;
   bool print_scc = false;
   bool comp = false;
+  bool budget_report = false;
+  bool inclusion = false;
+  bool universality = false;
+  bool bisim = false;
+  // output in the binary format of binary.hpp
+  bool binary = false;
+  // processes for the automata of a file
+  unsigned jobs = 1;
 
-  enum postprocess_level
-  {
-    None = 0,
-    Low,
-    Medium,
-    High
-  };
   postprocess_level preprocess = Low;
   postprocess_level post_process = Low;
   bool use_scc = false;
   unsigned num_post = 30000;
 
-  enum output_aut_type
-  {
-    Generic = 0,
-    Rabin,
-    Parity
-  };
-
   output_aut_type output_type = Generic; 
 
   std::string output_filename = "";
+  // cost model for --determinize=auto
+  cola::algorithm_selector selector;
+  std::string calibrate_filename = "";
+
+  // server mode, on stdin/stdout if there is no socket
+  bool serve = false;
+  std::string socket_path = "";
+  unsigned cache_size = 64;
+  // requests between two garbage collections of the BDDs
+  unsigned gc_interval = 100;
+
+  // results of previous runs on disk, shared by the requests of --serve
+  std::string result_cache_dir = "";
+  unsigned result_cache_mb = 1024;
+  std::shared_ptr<cola::result_cache> result_cache;
 
-  for (int i = 1; i < argc; i++)
+  cola_settings()
   {
-    std::string arg = argv[i];
+    // default setting
+    om.set(USE_SIMULATION, 0);
+    om.set(USE_STUTTER, 0);
+    om.set(USE_UNAMBIGUITY, 0);
+    om.set(USE_SCC_INFO, 0);
+    om.set(VERBOSE_LEVEL, 0);
+    om.set(USE_DELAYED_SIMULATION, 0);
+    om.set(MORE_ACC_EDGES, 0);
+    om.set(NUM_TRANS_PRUNING, 512);
+    om.set(MSTATE_REARRANGE, 0);
+    om.set(LETTER_CLASSES, 0);
+    om.set(DECOMPOSE_POSTPROCESS, 0);
+    om.set(DECOMPOSE_JOBS, 1);
+    om.set(MAX_STATES, 0);
+    om.set(TIMEOUT, 0);
+    om.set(MAX_MEMORY, 0);
+    om.set(PORTFOLIO_RATIO, 100);
+    om.set(POST_TIME_LIMIT, 1000);
+    om.set(EXTERNAL_BFS, 0);
+    om.set(CHECKPOINT_INTERVAL, 600);
+
+    // Will be deleted
+    //  --scc-mem-limit=[INT] 
+    //          The memory limit (MB) for computing the SCC reachability (default = 0, no limit)
+    //  --scc-num-limit=[INT] 
+    //          The largest number of SCCs in the deterministic automaton for merging macrostates (default = 0, no limit)
+    om.set(SCC_REACH_MEMORY_LIMIT, 0);
+    om.set(NUM_SCC_LIMIT_MERGER, 0);
+  }
+};
+
+// returns the exit status if the program has to stop, -1 otherwise
+int
+parse_options(const std::vector<std::string> &args, cola_settings &cfg)
+{
+  for (int i = 1; i < (int)args.size(); i++)
+  {
+    std::string arg = args[i];
     if (arg.find("--preprocess=") != std::string::npos)
     {
       unsigned level = parse_int(arg);
       if (level == 0)
       {
-        preprocess = None;
+        cfg.preprocess = None;
       }else if (level == 1)
       {
-        preprocess = Low;
+        cfg.preprocess = Low;
       }else if (level == 2)
       {
-        preprocess = Medium;
+        cfg.preprocess = Medium;
       }else if (level == 3)
       {
-        preprocess = High;
+        cfg.preprocess = High;
       }
     }else if (arg == "--print-scc")
     {
-      print_scc = true;
+      cfg.print_scc = true;
     }else if (arg == "--postprocess-det=0")
-      post_process = None;
+      cfg.post_process = None;
     else if (arg == "--postprocess-det=1")
-      post_process = Low;
+      cfg.post_process = Low;
     else if (arg == "--postprocess-det=2")
-      post_process = Medium;
+      cfg.post_process = Medium;
     else if (arg == "--postprocess-det=3")
-      post_process = High;
+      cfg.post_process = High;
+    else if (arg == "--bisim")
+      cfg.bisim = true;
+    else if (arg == "--binary")
+      cfg.binary = true;
     else if (arg == "--generic")
     {
-      output_type = Generic;
+      cfg.output_type = Generic;
     }else if (arg == "--parity")
     {
-      output_type = Parity;
+      cfg.output_type = Parity;
     }else if (arg == "--rabin")
     {
-      output_type = Rabin;
+      cfg.output_type = Rabin;
     }else if (arg == "--complement")
     {
-      comp = true;
-      use_acd = true;
-      output_type = Parity;
+      cfg.comp = true;
+      cfg.use_acd = true;
+      cfg.output_type = Parity;
     }
     else if (arg == "--simulation")
     {
-      use_simulation = true;
-      om.set(USE_SIMULATION, 1);
+      cfg.use_simulation = true;
+      cfg.om.set(USE_SIMULATION, 1);
     }else if (arg.find("--trans-pruning=") != std::string::npos)
     {
       int trans_pruning = parse_int(arg);
-      om.set(NUM_TRANS_PRUNING, trans_pruning);
+      cfg.om.set(NUM_TRANS_PRUNING, trans_pruning);
     }
     else if (arg == "--delayed-sim")
     {
-      om.set(USE_DELAYED_SIMULATION, 1);
+      cfg.om.set(USE_DELAYED_SIMULATION, 1);
     }
     else if (arg == "--use-scc")
     {
-      use_scc = true;
-      om.set(USE_SCC_INFO, 1);
+      cfg.use_scc = true;
+      cfg.om.set(USE_SCC_INFO, 1);
     }
     else if (arg == "--more-acc-edges")
     {
-      om.set(MORE_ACC_EDGES, 1);
+      cfg.om.set(MORE_ACC_EDGES, 1);
     }else if (arg == "--rerank")
     { 
-      om.set(MSTATE_REARRANGE, 1);
+      cfg.om.set(MSTATE_REARRANGE, 1);
     }else if (arg == "--decompose")
     {
-      decompose = true;
-      om.set(NUM_NBA_DECOMPOSED, -1);
+      cfg.decompose = true;
+      cfg.om.set(NUM_NBA_DECOMPOSED, -1);
     }
     else if (arg.find("--decompose=") != std::string::npos)
     {
-      decompose = true;
+      cfg.decompose = true;
       unsigned num_scc = parse_int(arg);
-      om.set(NUM_NBA_DECOMPOSED, num_scc);
+      cfg.om.set(NUM_NBA_DECOMPOSED, num_scc);
+    }
+    else if (arg == "--decompose-post")
+    {
+      cfg.om.set(DECOMPOSE_POSTPROCESS, 1);
+    }
+    else if (arg.find("--decompose-jobs=") != std::string::npos)
+    {
+      cfg.om.set(DECOMPOSE_JOBS, parse_int(arg));
     }else if (arg == "--acd")
     {
-      use_acd = true;
+      cfg.use_acd = true;
     }
     // Prefered output
     else if (arg == "--d")
-      debug = true;
+      cfg.debug = true;
     // else if (arg == "--merge-transitions")
     //   merge_transitions = true;
     else if (arg == "--type")
-      aut_type = true;
+      cfg.aut_type = true;
     else if (arg == "--unambiguous")
     {
-      use_unambiguous = true;
-      om.set(USE_UNAMBIGUITY, 1);
+      cfg.use_unambiguous = true;
+      cfg.om.set(USE_UNAMBIGUITY, 1);
     }
     else if (arg == "--stutter")
     {
-      use_stutter = true;
-      om.set(USE_STUTTER, 1);
+      cfg.use_stutter = true;
+      cfg.om.set(USE_STUTTER, 1);
     }
+    else if (arg == "--letter-classes")
+      cfg.om.set(LETTER_CLASSES, 1);
     else if (arg == "--determinize=ba")
-      determinize = NBA;
+      cfg.determinize = NBA;
     else if (arg == "--determinize=ldba")
-      determinize = LDBA;
+      cfg.determinize = LDBA;
     else if (arg == "--determinize=eba")
-      determinize = EBA;
+      cfg.determinize = EBA;
     else if (arg == "--determinize=spot")
-      determinize = Spot;
-    else if (arg == "--determinize=cola")
+      cfg.determinize = Spot;
+    else if (arg == "--determinize=cola" || arg == "--determinize=portfolio" || arg == "--determinize=auto")
     {
-      determinize = COLA;
+      if (arg == "--determinize=cola")
+        cfg.determinize = COLA;
+      else if (arg == "--determinize=portfolio")
+        cfg.determinize = Portfolio;
+      else
+        cfg.determinize = Auto;
       // default settings
-      om.set(USE_SIMULATION, 1);
-      om.set(USE_SCC_INFO, 1);
-      om.set(USE_STUTTER, 1);
-      use_acd = true;
-      output_type = Parity;
+      cfg.om.set(USE_SIMULATION, 1);
+      cfg.om.set(USE_SCC_INFO, 1);
+      cfg.om.set(USE_STUTTER, 1);
+      cfg.use_acd = true;
+      cfg.output_type = Parity;
+    }else if (arg.find("--calibration=") != std::string::npos)
+    {
+      cfg.selector.load(arg.substr(arg.find('=') + 1));
+    }else if (arg.find("--calibrate=") != std::string::npos)
+    {
+      cfg.calibrate_filename = arg.substr(arg.find('=') + 1);
+    }else if (arg.find("--portfolio-ratio=") != std::string::npos)
+    {
+      cfg.om.set(PORTFOLIO_RATIO, parse_int(arg));
     }else if (arg == "--algo=comp")
     {
-      complement_algo = SCC;
+      cfg.complement_algo = SCC;
+    }else if (arg == "--algo=ncsb")
+    {
+      cfg.complement_algo = NCSB;
+    }else if (arg == "--algo=ncsb-lazy")
+    {
+      cfg.complement_algo = NCSB_LAZY;
+    }else if (arg == "--algo=ncb")
+    {
+      cfg.complement_algo = NCB;
+    }else if (arg == "--algo=nsbc")
+    {
+      cfg.complement_algo = NSBC;
+    }
+    else if (arg == "--serve" || arg.find("--serve=") != std::string::npos)
+    {
+      cfg.serve = true;
+      if (arg != "--serve")
+        cfg.socket_path = arg.substr(arg.find('=') + 1);
+    }
+    else if (arg.find("--result-cache=") != std::string::npos)
+    {
+      cfg.result_cache_dir = arg.substr(arg.find('=') + 1);
+    }
+    else if (arg.find("--result-cache-size=") != std::string::npos)
+    {
+      cfg.result_cache_mb = parse_int(arg);
+    }
+    else if (arg.find("--jobs=") != std::string::npos)
+    {
+      cfg.jobs = parse_int(arg);
+    }
+    else if (arg.find("--cache-size=") != std::string::npos)
+    {
+      cfg.cache_size = parse_int(arg);
+    }
+    else if (arg.find("--gc-interval=") != std::string::npos)
+    {
+      cfg.gc_interval = parse_int(arg);
     }
     else if (arg == "-f")
     {
-      if (argc < i + 1)
+      if (i + 1 >= (int)args.size())
       {
         std::cerr << "cola: Option -f requires an argument.\n";
         return 1;
       }
       else
       {
-        path_to_files.emplace_back(argv[i + 1]);
+        cfg.path_to_files.emplace_back(args[i + 1]);
         i++;
       }
     }
     else if (arg == "-o")
     {
-      if (argc < i + 1)
+      if (i + 1 >= (int)args.size())
       {
         std::cerr << "cola: Option -o requires an argument.\n";
         return 1;
       }
       else
       {
-        std::string str(argv[i + 1]);
-        output_filename = str;
+        std::string str(args[i + 1]);
+        cfg.output_filename = str;
         i++;
       }
     }
     else if (arg.find("--num-states=") != std::string::npos)
     {
       // obtain the substring after '='
-      num_post = parse_int(arg);
-      //std::cout << "Input number : " << num_post << std::endl;
+      cfg.num_post = parse_int(arg);
+      //std::cout << "Input number : " << cfg.num_post << std::endl;
+    }
+    else if (arg.find("--post-time=") != std::string::npos)
+    {
+      cfg.om.set(POST_TIME_LIMIT, parse_int(arg));
+    }
+    else if (arg.find("--max-states=") != std::string::npos)
+    {
+      cfg.om.set(MAX_STATES, parse_int(arg));
+    }
+    else if (arg.find("--timeout=") != std::string::npos)
+    {
+      cfg.om.set(TIMEOUT, parse_int(arg));
+    }
+    else if (arg.find("--max-memory=") != std::string::npos)
+    {
+      cfg.om.set(MAX_MEMORY, parse_int(arg));
+    }
+    else if (arg.find("--external-bfs=") != std::string::npos)
+    {
+      cfg.om.set(EXTERNAL_BFS, parse_int(arg));
+    }
+    else if (arg.find("--checkpoint=") != std::string::npos)
+    {
+      cfg.om.set_str(CHECKPOINT_FILE, arg.substr(arg.find('=') + 1));
+    }
+    else if (arg.find("--checkpoint-interval=") != std::string::npos)
+    {
+      cfg.om.set(CHECKPOINT_INTERVAL, parse_int(arg));
+    }
+    else if (arg.find("--resume=") != std::string::npos)
+    {
+      cfg.om.set_str(RESUME_FILE, arg.substr(arg.find('=') + 1));
+    }
+    else if (arg == "--inclusion")
+    {
+      cfg.inclusion = true;
+    }
+    else if (arg == "--universality")
+    {
+      cfg.universality = true;
+    }
+    else if (arg == "--budget-report")
+    {
+      cfg.budget_report = true;
     }
     else if (arg.find("--verbose=") != std::string::npos)
     {
-      om.set(VERBOSE_LEVEL, parse_int(arg));
+      cfg.om.set(VERBOSE_LEVEL, parse_int(arg));
     }
     else if (arg.find("--scc-mem-limit=") !=  std::string::npos)
     {
-      om.set(SCC_REACH_MEMORY_LIMIT, parse_int(arg));
+      cfg.om.set(SCC_REACH_MEMORY_LIMIT, parse_int(arg));
     }
     else if (arg.find("--scc-num-limit=") !=  std::string::npos)
     {
-      om.set(NUM_SCC_LIMIT_MERGER, parse_int(arg));
+      cfg.om.set(NUM_SCC_LIMIT_MERGER, parse_int(arg));
     }
     else if ((arg == "--help") || (arg == "-h"))
     {
@@ -461,365 +841,809 @@ int main(int argc, char *argv[])
     }
     else
     {
-      path_to_files.emplace_back(argv[i]);
+      cfg.path_to_files.emplace_back(args[i]);
     }
   }
-  //path_to_files.push_back("base_formula_130_0.hoa");
-  //determinize = Parity;
-  if (path_to_files.empty())
+  // let the determinization emit the parity condition itself
+  if (cfg.output_type == Parity)
+    cfg.om.set(REQUIRE_PARITY, 1);
+  // a resumed run goes on saving its progress
+  if (cfg.om.get_str(CHECKPOINT_FILE).empty() && !cfg.om.get_str(RESUME_FILE).empty())
+    cfg.om.set_str(CHECKPOINT_FILE, cfg.om.get_str(RESUME_FILE));
+  if (cfg.result_cache_dir != "" && (!cfg.result_cache || cfg.result_cache->get_dir() != cfg.result_cache_dir))
+    cfg.result_cache = std::make_shared<cola::result_cache>(cfg.result_cache_dir, (size_t)cfg.result_cache_mb << 20);
+  return -1;
+}
+
+// everything in the settings that may change the result of an input
+std::string
+result_settings(const cola_settings &cfg)
+{
+  // not the resource limits: a run that hits one of them is not stored, and
+  // a run that does not has the same result without them
+  static const char *keys[] = {
+      USE_SIMULATION, USE_DELAYED_SIMULATION, USE_STUTTER, USE_SCC_INFO, USE_UNAMBIGUITY,
+      MORE_ACC_EDGES, NUM_NBA_DECOMPOSED, DECOMPOSE_POSTPROCESS, NUM_SCC_LIMIT_MERGER, SCC_REACH_MEMORY_LIMIT,
+      REQUIRE_PARITY, NUM_TRANS_PRUNING, MSTATE_REARRANGE, LETTER_CLASSES, EXTERNAL_BFS,
+      PORTFOLIO_RATIO, POST_TIME_LIMIT};
+  std::ostringstream res;
+  for (const char *key : keys)
+    res << key << '=' << cfg.om.get(key) << ' ';
+  res << "determinize=" << cfg.determinize << " complement=" << cfg.complement_algo
+      << " decompose=" << cfg.decompose << " acd=" << cfg.use_acd << " comp=" << cfg.comp
+      << " preprocess=" << cfg.preprocess << " postprocess=" << cfg.post_process
+      << " num-post=" << cfg.num_post << " output=" << cfg.output_type << " bisim=" << cfg.bisim << " binary=" << cfg.binary;
+  return res.str();
+}
+
+// transform one input automaton and print the result to out, returns the
+// result or nullptr if only some information or a stored result has been printed.
+// The analysis of the preprocessed input is looked up in the cache if given.
+spot::twa_graph_ptr
+process_automaton(spot::twa_graph_ptr aut, cola_settings &cfg, cola::budget &limits, std::ostream &out
+, cola::analysis_cache *cache = nullptr, const std::string &cache_key = "")
+{
+  // the cost model may be recalibrated, so its choices are not stored
+  std::string result_input;
+  if (cfg.result_cache && !cfg.aut_type && !cfg.print_scc && cfg.determinize != Auto && cfg.calibrate_filename == "")
   {
-    if (isatty(STDIN_FILENO))
+    result_input = cola::result_cache::canonical_text(aut, result_settings(cfg));
+    std::string result;
+    if (cfg.result_cache->find(result_input, result))
     {
-      std::cerr << "cola: No automaton to process? "
-                   "Run 'cola --help' for more help.\n";
-      print_usage(std::cerr);
-      return 1;
-    }
-    else
-    {
-      // Process stdin by default.
-      path_to_files.emplace_back("-");
+      if (cfg.om.get(VERBOSE_LEVEL) > 0)
+        std::cout << "Found the result in the cache: " << cola::result_cache::compute_key(result_input) << std::endl;
+      if (cfg.output_filename != "")
+        std::ofstream(cfg.output_filename, std::ios::binary) << result;
+      else
+        out << result;
+      return nullptr;
     }
   }
-  //path_to_files.push_back("formula_52_nba.hoa");
 
-  auto dict = spot::make_bdd_dict();
+  // may be changed by the cost model, only for this automaton
+  bool use_decompose = cfg.decompose;
+  spot::option_map decompose_om = cfg.om;
+  // may be changed by the complementation, only for this automaton
+  bool comp = cfg.comp;
+  bool use_acd = cfg.use_acd;
+  postprocess_level post_process = cfg.post_process;
 
-  for (std::string &path_to_file : path_to_files)
+  // Check if input is TGBA
+  if (aut->acc().is_generalized_buchi())
   {
-    if (om.get(VERBOSE_LEVEL))
-      std::cout << "File: " << path_to_file << " Algo: " << determinize << std::endl;
-    spot::automaton_stream_parser parser(path_to_file);
-
-    for (;;)
-    {
-      spot::parsed_aut_ptr parsed_aut = parser.parse(dict);
+    aut = spot::degeneralize_tba(aut);
+  }
 
-      if (parsed_aut->format_errors(std::cerr))
-        return 1;
+  if (!aut->acc().is_buchi())
+  {
+    throw std::runtime_error("cola requires Buchi condition on input.");
+  }
 
-      // input automata
-      spot::twa_graph_ptr aut = parsed_aut->aut;
+  if (cfg.aut_type)
+  {
+    cola::analysis ctx(aut);
+    bool type = false;
+    if (ctx.is_deterministic())
+    {
+      type = true;
+      out << "deterministic" << std::endl;
+    }
+    if (ctx.is_limit_deterministic())
+    {
+      type = true;
+      out << "limit-deterministic" << std::endl;
+    }
+    if (ctx.is_elevator())
+    {
+      out << "elevator" << std::endl;
+    }
+    if (ctx.is_weak())
+    {
+      out << "inherently weak" << std::endl;
+    }
+    if (spot::is_unambiguous(aut))
+    {
+      out << "unambiguous" << std::endl;
+    }
+    if (!type)
+    {
+      out << "nondeterministic" << std::endl;
+    }
+    return nullptr;
+  }
 
-      if (!aut)
-        break;
+  if (cfg.print_scc)
+  {
+    // strengther
+    spot::scc_info si(aut, spot::scc_info_options::ALL);
+    unsigned num_iwcs = 0;
+    unsigned num_acc_iwcs = 0;
+    unsigned num_iwcs_states = 0;
+    unsigned num_max_iwcs_states = 0;
+    unsigned num_acciwcs_states = 0;
+    unsigned num_max_acciwcs_states = 0;
+    unsigned num_dacs = 0;
+    unsigned num_dacs_states = 0;
+    unsigned num_max_dacs_states = 0;
+    unsigned num_nacs = 0;
+    unsigned num_nacs_states = 0;
+    unsigned num_max_nacs_states = 0;
 
-      // Check if input is TGBA
-      if (aut->acc().is_generalized_buchi())
+    std::string types = cola::get_scc_types(si);
+    for (unsigned sc = 0; sc < si.scc_count(); sc++)
+    {
+      unsigned num = si.states_of(sc).size();
+      if (cola::is_weakscc(types, sc))
       {
-        aut = spot::degeneralize_tba(aut);
+        num_iwcs_states += num;
+        num_iwcs ++;
+        num_max_iwcs_states = std::max(num_max_iwcs_states, num);
       }
-
-      if (!aut->acc().is_buchi())
+      if (cola::is_accepting_weakscc(types, sc))
       {
-        std::cerr << "cola requires Buchi condition on input.\n";
-        return 1;
+        num_acciwcs_states += num;
+        num_acc_iwcs ++;
+        num_max_acciwcs_states = std::max(num_max_acciwcs_states, num);
+      }
+    
+      if (cola::is_accepting_detscc(types, sc))
+      {
+        num_dacs_states += num;
+        num_dacs ++;
+        num_max_dacs_states = std::max(num_max_dacs_states, num);
       }
+      if (cola::is_accepting_nondetscc(types, sc))
+      {
+        num_nacs_states += num;
+        num_nacs ++;
+        num_max_nacs_states = std::max(num_max_nacs_states, num);
+      }
+    }
+    out << "Number of IWCs: " << num_iwcs << " with " << num_iwcs_states << " states, in which max IWC with " << num_max_iwcs_states << " states\n";
+    out << "Number of ACC_IWCs: " << num_acc_iwcs << " with " << num_acciwcs_states << " states, in which max IWC with " << num_max_acciwcs_states << " states\n";
+    out << "Number of DACs: " << num_dacs << " with " << num_dacs_states << " states, in which max DAC with " << num_max_dacs_states << " states\n";
+    out << "Number of NACs: " << num_nacs << " with " << num_nacs_states << " states, in which max NAC with " << num_max_nacs_states << " states\n";
+    return nullptr;
+  }
 
-      if (aut_type)
+  if (cfg.om.get(MORE_ACC_EDGES) > 0)
+  {
+    const unsigned num = 200;
+    // strengther
+    spot::scc_info si(aut, spot::scc_info_options::ALL);
+    cola::edge_strengther e_strengther(aut, si, 200);
+    for (unsigned sc = 0; sc < si.scc_count(); sc++)
+    {
+      if (si.is_accepting_scc(sc))
       {
-        bool type = false;
-        if (spot::is_deterministic(aut))
-        {
-          type = true;
-          std::cout << "deterministic" << std::endl;
-        }
-        if (spot::is_semi_deterministic(aut))
-        {
-          type = true;
-          std::cout << "limit-deterministic" << std::endl;
-        }
-        if (cola::is_elevator_automaton(aut))
-        {
-          std::cout << "elevator" << std::endl;
-        }
-        if (cola::is_weak_automaton(aut))
-        {
-          std::cout << "inherently weak" << std::endl;
-        }
-        if (spot::is_unambiguous(aut))
-        {
-          std::cout << "unambiguous" << std::endl;
-        }
-        if (!type)
-        {
-          std::cout << "nondeterministic" << std::endl;
-        }
-        break;
+        e_strengther.fix_scc(sc);
       }
+    }
+  }
+  if (!spot::is_deterministic(aut))
+  {
+    // spot::scc_info si(aut);
+    // std::string scc_types = cola::get_scc_types(si);
+    // cola::print_scc_types(scc_types, si);
+    // //std::cout << "scc types: " << scc_types << "\n";
+    // std::cout << "weak: " << cola::is_weak_automaton(si, scc_types) << " " << cola::is_weak_automaton(aut) << std::endl;
+    // std::cout << "elevator: " << cola::is_elevator_automaton(si, scc_types) << " " << cola::is_elevator_automaton(aut) << std::endl;
+    // std::cout << "ldba: " << cola::is_limit_deterministic_automaton(si, scc_types) << " " << spot::is_semi_deterministic(aut) << std::endl;
+    // // exit(1);
+    clock_t c_start = clock();
+    // bool is_semi_det = is_semi_deterministic(aut);
+    // the SCCs and the type of the preprocessed automaton, shared by
+    // the selection and the constructions
+    std::shared_ptr<cola::analysis> ctx;
+    // only the determinization reads the analysis, and it does not modify the input
+    if (cache && cfg.determinize != NoDeterminize)
+      ctx = cache->find(cache_key);
+    if (ctx)
+      aut = std::const_pointer_cast<spot::twa_graph>(ctx->get_aut());
+    else
+    {
+      // preprocessing for the input.
+      if (cfg.preprocess)
+      {
+        spot::postprocessor preprocessor;
+        // only a very low level of preprocessing is allowed
+        if (cfg.preprocess == Low)
+          preprocessor.set_level(spot::postprocessor::Low);
+        else if (cfg.preprocess == Medium)
+          preprocessor.set_level(spot::postprocessor::Medium);
+        else if (cfg.preprocess == High)
+          preprocessor.set_level(spot::postprocessor::High);
+        aut = preprocessor.run(aut);
+      }
+    }
+    if (cfg.om.get(VERBOSE_LEVEL) >= 2)
+    {
+      cola::output_file(aut, "sim_aut.hoa");
+      std::cout << "Output processed automaton (" << aut->num_states() << ", " << aut->num_edges() << ") to sim_aut.hoa\n";
+    }
+    clock_t c_end = clock();
+    if (cfg.om.get(VERBOSE_LEVEL) > 0)
+    {
+      std::cout << "Done for preprocessing the input automaton in " << 1000.0 * (c_end - c_start) / CLOCKS_PER_SEC << " ms..." << std::endl;
+    }
 
-      if (print_scc)
-      {
-        // strengther
-        spot::scc_info si(aut, spot::scc_info_options::ALL);
-        unsigned num_iwcs = 0;
-        unsigned num_acc_iwcs = 0;
-        unsigned num_iwcs_states = 0;
-        unsigned num_max_iwcs_states = 0;
-        unsigned num_acciwcs_states = 0;
-        unsigned num_max_acciwcs_states = 0;
-        unsigned num_dacs = 0;
-        unsigned num_dacs_states = 0;
-        unsigned num_max_dacs_states = 0;
-        unsigned num_nacs = 0;
-        unsigned num_nacs_states = 0;
-        unsigned num_max_nacs_states = 0;
-
-        std::string types = cola::get_scc_types(si);
-        for (unsigned sc = 0; sc < si.scc_count(); sc++)
-        {
-          unsigned num = si.states_of(sc).size();
-          if (cola::is_weakscc(types, sc))
-          {
-            num_iwcs_states += num;
-            num_iwcs ++;
-            num_max_iwcs_states = std::max(num_max_iwcs_states, num);
-          }
-          if (cola::is_accepting_weakscc(types, sc))
-          {
-            num_acciwcs_states += num;
-            num_acc_iwcs ++;
-            num_max_acciwcs_states = std::max(num_max_acciwcs_states, num);
-          }
-          
-          if (cola::is_accepting_detscc(types, sc))
-          {
-            num_dacs_states += num;
-            num_dacs ++;
-            num_max_dacs_states = std::max(num_max_dacs_states, num);
-          }
-          if (cola::is_accepting_nondetscc(types, sc))
-          {
-            num_nacs_states += num;
-            num_nacs ++;
-            num_max_nacs_states = std::max(num_max_nacs_states, num);
-          }
-        }
-        std::cout << "Number of IWCs: " << num_iwcs << " with " << num_iwcs_states << " states, in which max IWC with " << num_max_iwcs_states << " states\n";
-        std::cout << "Number of ACC_IWCs: " << num_acc_iwcs << " with " << num_acciwcs_states << " states, in which max IWC with " << num_max_acciwcs_states << " states\n";
-        std::cout << "Number of DACs: " << num_dacs << " with " << num_dacs_states << " states, in which max DAC with " << num_max_dacs_states << " states\n";
-        std::cout << "Number of NACs: " << num_nacs << " with " << num_nacs_states << " states, in which max NAC with " << num_max_nacs_states << " states\n";
-        continue;
+    if (!ctx && aut->acc().is_buchi())
+    {
+      ctx = std::make_shared<cola::analysis>(aut);
+      if (cache && cfg.determinize != NoDeterminize)
+        cache->insert(cache_key, ctx);
+    }
+
+    determinize_t algo = cfg.determinize;
+    if ((cfg.determinize == Auto || cfg.calibrate_filename != "") && ctx)
+    {
+      cola::scc_stats stats = cola::algorithm_selector::compute_stats(*ctx);
+      if (cfg.calibrate_filename != "")
+      {
+        calibrate_on(*ctx, cfg.om, stats, cfg.selector);
+        return nullptr;
       }
+      int num_decomposed = 0;
+      cola::det_engine engine = cfg.selector.select(stats, num_decomposed);
+      algo = engine_to_algo(engine);
+      // a --decompose given by the user is kept
+      if (engine == cola::ENGINE_TNBA_DECOMPOSED && !cfg.decompose)
+      {
+        use_decompose = true;
+        decompose_om.set(NUM_NBA_DECOMPOSED, num_decomposed);
+      }
+      if (cfg.om.get(VERBOSE_LEVEL) > 0)
+        std::cout << "Selected construction: " << cola::algorithm_selector::engine_name(engine)
+                  << " with predicted cost " << cfg.selector.predict(engine, stats, num_decomposed) << std::endl;
+    }
 
-      if (om.get(MORE_ACC_EDGES) > 0)
+    if (algo != NoDeterminize && use_decompose && aut->acc().is_buchi() && !spot::is_deterministic(aut))
+    {
+      aut = decompose_to_deterministic(aut, decompose_om, algo, limits);
+    }
+    else if (algo != NoDeterminize && aut->acc().is_buchi())
+    {
+      spot::twa_graph_ptr res = nullptr;
+      c_start = clock();
+      res = to_deterministic(*ctx, cfg.om, algo, limits);
+      c_end = clock();
+      if (cfg.om.get(VERBOSE_LEVEL) > 0)
       {
-        const unsigned num = 200;
-        // strengther
-        spot::scc_info si(aut, spot::scc_info_options::ALL);
-        cola::edge_strengther e_strengther(aut, si, 200);
-        for (unsigned sc = 0; sc < si.scc_count(); sc++)
-        {
-          if (si.is_accepting_scc(sc))
-          {
-            e_strengther.fix_scc(sc);
-          }
-        }
+        std::cout << "Done for determinizing the input automaton in " << 1000.0 * (c_end - c_start) / CLOCKS_PER_SEC << " ms..." << std::endl;
       }
-      if (!spot::is_deterministic(aut))
-      {
-        // spot::scc_info si(aut);
-        // std::string scc_types = cola::get_scc_types(si);
-        // cola::print_scc_types(scc_types, si);
-        // //std::cout << "scc types: " << scc_types << "\n";
-        // std::cout << "weak: " << cola::is_weak_automaton(si, scc_types) << " " << cola::is_weak_automaton(aut) << std::endl;
-        // std::cout << "elevator: " << cola::is_elevator_automaton(si, scc_types) << " " << cola::is_elevator_automaton(aut) << std::endl;
-        // std::cout << "ldba: " << cola::is_limit_deterministic_automaton(si, scc_types) << " " << spot::is_semi_deterministic(aut) << std::endl;
-        // // exit(1);
-        clock_t c_start = clock();
-        unsigned aut_type = NONDETERMINISTIC;
-        if (cola::is_weak_automaton(aut))
-        {
-          aut_type |= INHERENTLY_WEAK;
-        }
-        if (spot::is_semi_deterministic(aut))
-        {
-          aut_type |= LIMIT_DETERMINISTIC;
-        }
-        if (cola::is_elevator_automaton(aut))
-        {
-          aut_type |= ELEVATOR;
-        }
-        // bool is_semi_det = is_semi_deterministic(aut);
-        {
-          // preprocessing for the input.
-          if (preprocess)
-          {
-            spot::postprocessor preprocessor;
-            // only a very low level of preprocessing is allowed
-            if (preprocess == Low)
-              preprocessor.set_level(spot::postprocessor::Low);
-            else if (preprocess == Medium)
-              preprocessor.set_level(spot::postprocessor::Medium);
-            else if (preprocess == High)
-              preprocessor.set_level(spot::postprocessor::High);
-            aut = preprocessor.run(aut);
-          }
-        }
-        if (om.get(VERBOSE_LEVEL) >= 2)
+      aut = res;
+    }
+    else if (aut->acc().is_all())
+    {
+      // trivial acceptance condition
+      aut = spot::minimize_monitor(aut);
+    }
+    if (cfg.bisim && algo != NoDeterminize)
+    {
+      aut = cola::bisimulation_quotient(aut, cfg.om);
+    }
+  }
+  if (cfg.complement_algo && cfg.determinize == NoDeterminize)
+  {
+    cola::analysis ctx(aut);
+    bool show_names = cfg.om.get(VERBOSE_LEVEL) >= 1;
+    spot::twa_graph_ptr res = nullptr;
+    clock_t c_start = clock();
+    if ((cfg.complement_algo == NCSB || cfg.complement_algo == NCSB_LAZY || cfg.complement_algo == NSBC)
+        && spot::is_semi_deterministic(aut))
+    {
+      if (cfg.complement_algo == NCSB)
+        res = cola::complement_semidet_opt(aut, show_names, &limits);
+      else if (cfg.complement_algo == NCSB_LAZY)
+        res = cola::complement_semidet_lazy(aut, show_names, &limits);
+      else
+        res = cola::new_complement_semidet(aut, show_names, &limits);
+    }
+    else if (cfg.complement_algo == NCB && spot::is_unambiguous(aut))
+    {
+      res = cola::complement_unambiguous(aut, show_names, &limits);
+    }
+    else if (ctx.is_elevator())
+    {
+      res = cola::complement_tnba(ctx, cfg.om, &limits);
+    }
+    if (res)
+    {
+      aut = res;
+      spot::postprocessor p;
+      p.set_level(spot::postprocessor::Low);
+      p.set_type(spot::postprocessor::Buchi);
+      aut = p.run(aut);
+      clock_t c_end = clock();
+      if (cfg.om.get(VERBOSE_LEVEL) > 0)
+        std::cout << "Done for complementing the input automaton in " << 1000.0 * (c_end - c_start) / CLOCKS_PER_SEC << " ms..." << std::endl;
+      comp = false;
+      post_process = None;
+    }else
+    {
+      // no complementation construction applies, so complement the
+      // deterministic automaton instead
+      aut = spot::dualize(to_deterministic(ctx, cfg.om, COLA, limits));
+      comp = true;
+      use_acd = true;
+    }
+  }else if (comp && cfg.determinize)
+  {
+    // complement the automaton
+    aut = spot::dualize(aut);
+    // make it
+    use_acd = true;
+  }
+  const char *opts = nullptr;
+  aut->merge_edges();
+  if (cfg.om.get(VERBOSE_LEVEL) > 0)
+    std::cout << "Number of (states, transitions, colors) in the result automaton: ("
+              << aut->num_states() << "," << aut->num_edges() << "," << aut->num_sets() << ")" << std::endl;
+  // postprocessing, remove dead states
+  //aut->purge_unreachable_states();
+  // the determinization may already have built a parity condition per SCC,
+  // then neither acd_transform() nor a generic postprocessing is needed
+  bool is_parity = cfg.output_type == Parity && aut->acc().is_parity();
+  if (post_process != None && !use_decompose)
+  {
+    clock_t c_start = clock();
+    if (aut->acc().is_all())
+    {
+      aut = spot::minimize_monitor(aut);
+    }
+    else if (aut->num_states() < cfg.num_post && !is_parity)
+    {
+      spot::postprocessor p;
+      if (cfg.output_type == Parity)
+      {
+        if (use_acd)
         {
-          cola::output_file(aut, "sim_aut.hoa");
-          std::cout << "Output processed automaton (" << aut->num_states() << ", " << aut->num_edges() << ") to sim_aut.hoa\n";
-        }
-        clock_t c_end = clock();
-        if (om.get(VERBOSE_LEVEL) > 0)
+          p.set_type(spot::postprocessor::Generic);
+        }else
         {
-          std::cout << "Done for preprocessing the input automaton in " << 1000.0 * (c_end - c_start) / CLOCKS_PER_SEC << " ms..." << std::endl;
-        }
+          p.set_type(spot::postprocessor::Parity);
+        } 
+      }else if (cfg.output_type == Generic || cfg.output_type == Rabin)
+      {
+        p.set_type(spot::postprocessor::Generic);
+      }
+      p.set_pref(spot::postprocessor::Deterministic);
+      // set postprocess level
+      if (post_process == Low)
+      {
+        p.set_level(spot::postprocessor::Low);
+      }
+      else if (post_process == Medium)
+      {
+        p.set_level(spot::postprocessor::Medium);
+      }
+      else if (post_process == High)
+      {
+        p.set_level(spot::postprocessor::High);
+      }
+      aut = p.run(aut);
+    }
+    if (cfg.output_type == Rabin)
+    {
+      aut = spot::to_generalized_rabin(aut, true);
+    }else if (cfg.output_type == Parity && use_acd && !is_parity)
+    {
+      // call the alternating cycle decomposition to translate our rabin automaton 
+      // to parity automaton
+      aut = spot::acd_transform(aut);
+    }
+    // now post processing again since we may not do postprocessing above
+    if (aut->num_states() >= cfg.num_post)
+    {
+      // too large for the postprocessor, only reduce SCC by SCC within a time budget
+      aut = cola::postprocess_sccs(aut, cfg.om);
+    }
+    else
+    {
+      spot::postprocessor p;
+      if (post_process == Low)
+      {
+        p.set_level(spot::postprocessor::Low);
+      }
+      else if (post_process == Medium)
+      {
+        p.set_level(spot::postprocessor::Medium);
+      }
+      else if (post_process == High)
+      {
+        p.set_level(spot::postprocessor::High);
+      }
+      p.set_pref(spot::postprocessor::Deterministic);
+      if (cfg.output_type == Generic)
+      {
+        p.set_type(spot::postprocessor::Generic);
+      }else if (cfg.output_type == Parity)
+      {
+        p.set_type(spot::postprocessor::Parity);
+      }
+      aut = p.run(aut);
+    }
+    clock_t c_end = clock();
+    if (cfg.om.get(VERBOSE_LEVEL) > 0)
+      std::cout << "Done for postprocessing the result automaton in " << 1000.0 * (c_end - c_start) / CLOCKS_PER_SEC << " ms..." << std::endl;
+  }else if (cfg.output_type == Parity && !is_parity)
+  {
+    aut = spot::acd_transform(aut);
+  }
+  if (comp)
+  {
+    // automaton is already complemented now
+    aut = to_tba(aut);
+  }
+  auto print_result = [&](std::ostream &os)
+  {
+    if (cfg.binary)
+    {
+      cola::print_binary(os, aut);
+    }
+    else
+    {
+      spot::print_hoa(os, aut, opts);
+      os << "\n";
+    }
+  };
+  if (result_input != "")
+  {
+    std::ostringstream result;
+    print_result(result);
+    cfg.result_cache->insert(result_input, result.str());
+  }
+  if (cfg.output_filename != "" && cfg.binary)
+  {
+    cola::output_binary_file(aut, cfg.output_filename.c_str());
+  }
+  else if (cfg.output_filename != "")
+  {
+    cola::output_file(aut, cfg.output_filename.c_str());
+  }
+  else
+  {
+    print_result(out);
+  }
+  return aut;
+}
 
-        if (determinize != NoDeterminize && decompose && aut->acc().is_buchi() && !spot::is_deterministic(aut))
-        {
-          cola::decomposer nba_decomposer(aut, om);
-          std::vector<spot::twa_graph_ptr> subnbas = nba_decomposer.run();
-          std::vector<spot::twa_graph_ptr> dpas;
-          for (unsigned i = 0; i < subnbas.size(); i++)
-          {
-            spot::twa_graph_ptr dpa = to_deterministic(subnbas[i], om, aut_type, determinize);
-            dpas.push_back(dpa);
-          }
-          cola::composer dpa_composer(dpas, om);
-          aut = dpa_composer.run();
-        }
-        else if (determinize != NoDeterminize && aut->acc().is_buchi())
+spot::twa_graph_ptr
+to_buchi_input(spot::twa_graph_ptr aut)
+{
+  if (aut->acc().is_generalized_buchi())
+    aut = spot::degeneralize_tba(aut);
+  if (!aut->acc().is_buchi())
+  {
+    throw std::runtime_error("cola requires Buchi condition on input.");
+  }
+  return aut;
+}
+
+// check L(A) ⊆ L(B) and print the answer to out
+void
+check_inclusion(spot::twa_graph_ptr A, spot::twa_graph_ptr B, cola_settings &cfg, cola::budget &limits, std::ostream &out)
+{
+  clock_t c_start = clock();
+  spot::twa_word_ptr word;
+  bool included = cola::contains(to_buchi_input(A), to_buchi_input(B), cfg.om, &word, &limits);
+  clock_t c_end = clock();
+  if (included)
+    out << "included" << std::endl;
+  else
+    out << "not included, counterexample: " << *word << std::endl;
+  if (cfg.om.get(VERBOSE_LEVEL) > 0)
+    std::cout << "Done for checking the inclusion in " << 1000.0 * (c_end - c_start) / CLOCKS_PER_SEC << " ms..." << std::endl;
+}
+
+// check L(A) = Σ^ω and print the answer to out
+void
+check_universality(spot::twa_graph_ptr A, cola_settings &cfg, cola::budget &limits, std::ostream &out)
+{
+  clock_t c_start = clock();
+  spot::twa_word_ptr word;
+  bool universal = cola::is_universal(to_buchi_input(A), cfg.om, &word, &limits);
+  clock_t c_end = clock();
+  if (universal)
+    out << "universal" << std::endl;
+  else
+    out << "not universal, counterexample: " << *word << std::endl;
+  if (cfg.om.get(VERBOSE_LEVEL) > 0)
+    std::cout << "Done for checking the universality in " << 1000.0 * (c_end - c_start) / CLOCKS_PER_SEC << " ms..." << std::endl;
+}
+
+// answer the requests of --serve, the command line gives the default options
+int
+serve(const cola_settings &defaults)
+{
+  // the dictionary and the BDD tables are set up once for all requests
+  auto dict = spot::make_bdd_dict();
+  cola::analysis_cache cache(defaults.cache_size);
+  std::unique_ptr<cola::request_server> server(defaults.socket_path == ""
+                                               ? new cola::request_server()
+                                               : new cola::request_server(defaults.socket_path));
+  // the responses are written to stdout, so the messages go to stderr
+  std::streambuf *cout_buf = std::cout.rdbuf();
+  if (defaults.socket_path == "")
+    std::cout.rdbuf(std::cerr.rdbuf());
+
+  unsigned num_requests = 0;
+  server->run([&](const std::string &options, const std::string &input, std::string &response)
+  {
+    cola_settings cfg = defaults;
+    std::vector<std::string> args = {"cola"};
+    std::istringstream iss(options);
+    std::string arg;
+    while (iss >> arg)
+      args.push_back(arg);
+    if (parse_options(args, cfg) >= 0 || cfg.serve)
+    {
+      response = "invalid options: " + options;
+      return false;
+    }
+
+    if (defaults.gc_interval > 0 && ++num_requests % defaults.gc_interval == 0)
+      bdd_gbc();
+
+    clock_t c_start = clock();
+    std::ostringstream out;
+    unsigned num_auts = 0, num_states = 0, num_edges = 0;
+    spot::automaton_stream_parser parser(input.c_str(), "request");
+    try
+    {
+      for (;;)
+      {
+        spot::parsed_aut_ptr parsed_aut = parser.parse(dict);
+        std::ostringstream errors;
+        if (parsed_aut->format_errors(errors))
         {
-          spot::twa_graph_ptr res = nullptr;
-          c_start = clock();
-          res = to_deterministic(aut, om, aut_type, determinize);
-          c_end = clock();
-          if (om.get(VERBOSE_LEVEL) > 0)
-          {
-            std::cout << "Done for determinizing the input automaton in " << 1000.0 * (c_end - c_start) / CLOCKS_PER_SEC << " ms..." << std::endl;
-          }
-          aut = res;
+          response = errors.str();
+          return false;
         }
-        else if (aut->acc().is_all())
+        if (!parsed_aut->aut)
+          break;
+        // the same automaton with the same options has the same analysis
+        std::string key = options + '\n' + std::to_string(num_auts++) + '\n' + input;
+        cola::budget limits(cfg.om);
+        spot::twa_graph_ptr res = process_automaton(parsed_aut->aut, cfg, limits, out, &cache, key);
+        if (res)
         {
-          // trivial acceptance condition
-          aut = spot::minimize_monitor(aut);
+          num_states += res->num_states();
+          num_edges += res->num_edges();
         }
+        if (cfg.aut_type)
+          break;
       }
-      if (complement_algo && determinize == NoDeterminize)
+      if (cfg.calibrate_filename != "")
       {
-        throw std::runtime_error("Complementation algorithm under construction and not available yet");
-        aut = cola::complement_tnba(aut, om);
-        spot::postprocessor p;
-        p.set_level(spot::postprocessor::Low);
-        p.set_type(spot::postprocessor::Buchi);
-        aut = p.run(aut);
-        comp = false;
-        post_process = None;
-      }else if (comp && determinize)
-      {
-        // complement the automaton
-        aut = spot::dualize(aut);
-        // make it
-        use_acd = true;
+        cfg.selector.calibrate();
+        cfg.selector.save(cfg.calibrate_filename);
       }
-      const char *opts = nullptr;
-      aut->merge_edges();
-      if (om.get(VERBOSE_LEVEL) > 0)
-        std::cout << "Number of (states, transitions, colors) in the result automaton: ("
-                  << aut->num_states() << "," << aut->num_edges() << "," << aut->num_sets() << ")" << std::endl;
-      // postprocessing, remove dead states
-      //aut->purge_unreachable_states();
-      if (post_process != None && !decompose)
-      {
-        clock_t c_start = clock();
-        if (aut->acc().is_all())
+    }
+    catch (const cola::budget_exceeded &e)
+    {
+      std::ostringstream report;
+      report << e.what() << '\n';
+      if (cfg.budget_report)
+        e.print_report(report);
+      response = report.str();
+      return false;
+    }
+    clock_t c_end = clock();
+    std::ostringstream stats;
+    stats << "automata=" << num_auts << " states=" << num_states << " edges=" << num_edges
+          << " time_ms=" << 1000.0 * (c_end - c_start) / CLOCKS_PER_SEC
+          << " memory_kb=" << cola::budget::current_memory_kb()
+          << " cached=" << cache.size() << '\n';
+    response = stats.str() + out.str();
+    return true;
+  });
+
+  std::cout.rdbuf(cout_buf);
+  return 0;
+}
+
+// process the automata of a HOA file in cfg.jobs processes; the exit status
+// of the first automaton that has failed, 3 if it has exceeded its budget
+int
+process_file_parallel(const std::string &path_to_file, cola_settings &cfg, const spot::bdd_dict_ptr &dict)
+{
+  cola::hoa_batch batch(path_to_file, cfg.jobs);
+  if (cfg.om.get(VERBOSE_LEVEL) > 0)
+    std::cout << "Found " << batch.size() << " automata in " << path_to_file << std::endl;
+  int status = 0;
+  cola::run_batch(batch.size(), cfg.jobs, [&](size_t i, std::string &res)
+  {
+    std::string text = batch.get(i);
+    spot::automaton_stream_parser parser(text.c_str(), path_to_file);
+    spot::parsed_aut_ptr parsed_aut = parser.parse(dict);
+    std::ostringstream errors;
+    if (parsed_aut->format_errors(errors))
+    {
+      res = errors.str();
+      return 1;
+    }
+    // an aborted automaton
+    if (!parsed_aut->aut)
+      return 0;
+    std::ostringstream out;
+    try
+    {
+      cola::budget limits(cfg.om);
+      process_automaton(parsed_aut->aut, cfg, limits, out);
+    }
+    catch (const cola::budget_exceeded &e)
+    {
+      std::ostringstream report;
+      report << "cola: " << e.what() << '\n';
+      if (cfg.budget_report)
+        e.print_report(report);
+      res = report.str();
+      return 3;
+    }
+    res = out.str();
+    return 0;
+  },
+  [&](size_t, int item_status, const std::string &res)
+  {
+    if (item_status == 0)
+    {
+      std::cout << res;
+    }
+    else
+    {
+      std::cerr << res;
+      if (status == 0)
+        status = item_status;
+    }
+  });
+  return status;
+}
+
+int main(int argc, char *argv[])
+{
+  cola_settings cfg;
+  int status = parse_options(std::vector<std::string>(argv, argv + argc), cfg);
+  if (status >= 0)
+    return status;
+
+  if (cfg.serve)
+  {
+    try
+    {
+      return serve(cfg);
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << "cola: " << e.what() << '\n';
+      return 1;
+    }
+  }
+
+  //path_to_files.push_back("base_formula_130_0.hoa");
+  //determinize = Parity;
+  if (cfg.path_to_files.empty())
+  {
+    if (isatty(STDIN_FILENO))
+    {
+      std::cerr << "cola: No automaton to process? "
+                   "Run 'cola --help' for more help.\n";
+      print_usage(std::cerr);
+      return 1;
+    }
+    else
+    {
+      // Process stdin by default.
+      cfg.path_to_files.emplace_back("-");
+    }
+  }
+  //path_to_files.push_back("formula_52_nba.hoa");
+
+  auto dict = spot::make_bdd_dict();
+
+  try
+  {
+    // with --inclusion, the first automaton of the current pair
+    spot::twa_graph_ptr left = nullptr;
+    for (std::string &path_to_file : cfg.path_to_files)
+    {
+      if (cfg.om.get(VERBOSE_LEVEL))
+        std::cout << "File: " << path_to_file << " Algo: " << cfg.determinize << std::endl;
+      // the automata are independent of each other, the binary files are
+      // not split at the HOA markers
+      if (cfg.jobs > 1 && path_to_file != "-" && !cfg.inclusion && !cfg.universality && !cfg.aut_type
+          && cfg.output_filename == "" && cfg.calibrate_filename == "" && !cola::is_binary_file(path_to_file))
+      {
+        int parallel_status = process_file_parallel(path_to_file, cfg, dict);
+        if (parallel_status != 0)
+          return parallel_status;
+        continue;
+      }
+      // files in the binary format are mapped in memory, the others are HOA
+      std::vector<spot::twa_graph_ptr> binary_auts;
+      if (path_to_file != "-")
+        binary_auts = cola::load_binary(path_to_file, dict);
+      size_t next_binary = 0;
+      std::unique_ptr<spot::automaton_stream_parser> parser;
+      if (binary_auts.empty())
+        parser.reset(new spot::automaton_stream_parser(path_to_file));
+
+      for (;;)
+      {
+        // input automata
+        spot::twa_graph_ptr aut = nullptr;
+        if (parser)
         {
-          aut = spot::minimize_monitor(aut);
+          spot::parsed_aut_ptr parsed_aut = parser->parse(dict);
+
+          if (parsed_aut->format_errors(std::cerr))
+            return 1;
+
+          aut = parsed_aut->aut;
         }
-        else if (aut->num_states() < num_post)
+        else if (next_binary < binary_auts.size())
         {
-          spot::postprocessor p;
-          if (output_type == Parity)
-          {
-            if (use_acd)
-            {
-              p.set_type(spot::postprocessor::Generic);
-            }else
-            {
-              p.set_type(spot::postprocessor::Parity);
-            } 
-          }else if (output_type == Generic || output_type == Rabin)
-          {
-            p.set_type(spot::postprocessor::Generic);
-          }
-          p.set_pref(spot::postprocessor::Deterministic);
-          // set postprocess level
-          if (post_process == Low)
-          {
-            p.set_level(spot::postprocessor::Low);
-          }
-          else if (post_process == Medium)
-          {
-            p.set_level(spot::postprocessor::Medium);
-          }
-          else if (post_process == High)
-          {
-            p.set_level(spot::postprocessor::High);
-          }
-          aut = p.run(aut);
+          aut = binary_auts[next_binary++];
         }
-        if (output_type == Rabin)
+
+        if (!aut)
+          break;
+
+        if (cfg.inclusion && !left)
         {
-          aut = spot::to_generalized_rabin(aut, true);
-        }else if (output_type == Parity && use_acd)
+          left = aut;
+          continue;
+        }
+        // the limits apply to each input automaton
+        cola::budget limits(cfg.om);
+        if (cfg.inclusion)
         {
-          // call the alternating cycle decomposition to translate our rabin automaton 
-          // to parity automaton
-          aut = spot::acd_transform(aut);
+          check_inclusion(left, aut, cfg, limits, std::cout);
+          left = nullptr;
+          continue;
         }
-        // now post processing again since we may not do postprocessing above
+        if (cfg.universality)
         {
-          spot::postprocessor p;
-          if (post_process == Low)
-          {
-            p.set_level(spot::postprocessor::Low);
-          }
-          else if (post_process == Medium)
-          {
-            p.set_level(spot::postprocessor::Medium);
-          }
-          else if (post_process == High)
-          {
-            p.set_level(spot::postprocessor::High);
-          }
-          p.set_pref(spot::postprocessor::Deterministic);
-          if (output_type == Generic)
-          {
-            p.set_type(spot::postprocessor::Generic);
-          }else if (output_type == Parity)
-          {
-            p.set_type(spot::postprocessor::Parity);
-          }
-          aut = p.run(aut);
+          check_universality(aut, cfg, limits, std::cout);
+          continue;
         }
-        clock_t c_end = clock();
-        if (om.get(VERBOSE_LEVEL) > 0)
-          std::cout << "Done for postprocessing the result automaton in " << 1000.0 * (c_end - c_start) / CLOCKS_PER_SEC << " ms..." << std::endl;
-      }else if (output_type == Parity)
-      {
-        aut = spot::acd_transform(aut);
-      }
-      if (comp)
-      {
-        // automaton is already complemented now
-        aut = to_tba(aut);
-      }
-      if (output_filename != "")
-      {
-        cola::output_file(aut, output_filename.c_str());
-      }
-      else
-      {
-        spot::print_hoa(std::cout, aut, opts);
-        std::cout << "\n";
+        process_automaton(aut, cfg, limits, std::cout);
+        // only the type of the first automaton is printed
+        if (cfg.aut_type)
+          break;
       }
     }
+
+    if (left)
+    {
+      std::cerr << "cola: --inclusion requires the input automata in pairs\n";
+      return 1;
+    }
+
+    if (cfg.calibrate_filename != "")
+    {
+      cfg.selector.calibrate();
+      cfg.selector.save(cfg.calibrate_filename);
+      return 0;
+    }
+  }
+  catch (const cola::budget_exceeded &e)
+  {
+    std::cout.flush();
+    std::cerr << "cola: " << e.what() << '\n';
+    if (cfg.budget_report)
+      e.print_report(std::cerr);
+    return 3;
+  }
+  catch (const std::runtime_error &e)
+  {
+    std::cout.flush();
+    std::cerr << e.what() << '\n';
+    return 1;
   }
 
   check_cout();
 
   return 0;
-}
\ No newline at end of file
+}
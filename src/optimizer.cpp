@@ -171,9 +171,13 @@ namespace cola
 
   // -------------- state_simulator ----------------------
   state_simulator::state_simulator(const spot::const_twa_graph_ptr &nba, spot::scc_info &si, std::vector<bdd> &implications, bool use_simulation)
-      : nba_(nba), si_(si)
+      : state_simulator(nba, si, implications, find_scc_paths(si), use_simulation)
+  {
+  }
+
+  state_simulator::state_simulator(const spot::const_twa_graph_ptr &nba, spot::scc_info &si, std::vector<bdd> &implications, const std::vector<bool> &is_connected, bool use_simulation)
+      : nba_(nba), si_(si), is_connected_(is_connected)
   {
-    is_connected_ = find_scc_paths(si);
     if (!use_simulation)
     {
       return;
@@ -258,7 +262,7 @@ namespace cola
     }
   }
 
-  void state_simulator::output_simulation()
+  void state_simulator::output_simulation() const
   {
     for (int i = 0; i < is_implies_.size(); i++)
     {
@@ -273,7 +277,7 @@ namespace cola
   }
 
   // state i reach state j
-  char state_simulator::can_reach(unsigned i, unsigned j)
+  char state_simulator::can_reach(unsigned i, unsigned j) const
   {
     unsigned scc_of_i = si_.scc_of(i);
     unsigned scc_of_j = si_.scc_of(j);
@@ -283,14 +287,14 @@ namespace cola
     return is_connected_[scc_of_j + si_.scc_count() * scc_of_i];
   }
 
-  char state_simulator::can_reach_scc(unsigned scc1, unsigned scc2)
+  char state_simulator::can_reach_scc(unsigned scc1, unsigned scc2) const
   {
     if (scc1 < scc2) return 0;
     if (scc1 == scc2) return 1;
     return is_connected_[scc2 + si_.scc_count() * scc1];
   }
   // check whether state i simulates state j
-  bool state_simulator::simulate(unsigned i, unsigned j)
+  bool state_simulator::simulate(unsigned i, unsigned j) const
   {
     if (is_implies_.size() == 0)
     {
@@ -84,15 +84,17 @@ namespace cola
 
   public:
     state_simulator(const spot::const_twa_graph_ptr &nba, spot::scc_info &si, std::vector<bdd>& implications, bool use_simulation = true);
+    // reuse the reachability of SCCs given by find_scc_paths()
+    state_simulator(const spot::const_twa_graph_ptr &nba, spot::scc_info &si, std::vector<bdd>& implications, const std::vector<bool>& is_connected, bool use_simulation = true);
     state_simulator(const state_simulator& other);
     // do nothing constructor
-    void output_simulation();
+    void output_simulation() const;
     //void output_reachability_relation();
     // state i reach state j
-    char can_reach(unsigned i, unsigned j);
+    char can_reach(unsigned i, unsigned j) const;
     // check whether state i simulates state j
-    bool simulate(unsigned i, unsigned j);
-    char can_reach_scc(unsigned scc1, unsigned scc2);
+    bool simulate(unsigned i, unsigned j) const;
+    char can_reach_scc(unsigned scc1, unsigned scc2) const;
   };
 
   // adaped from spot/twaalgos/powerset.cc
@@ -0,0 +1,181 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "portfolio.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <spot/twaalgos/determinize.hh>
+#include <spot/twaalgos/hoa.hh>
+#include <spot/parseaut/public.hh>
+
+namespace cola
+{
+  portfolio::portfolio(const spot::const_twa_graph_ptr &aut, spot::option_map &om, budget &limits)
+      : aut_(aut), om_(om), budget_(limits)
+  {
+  }
+
+  void
+  portfolio::run_spot(int fd)
+  {
+    try
+    {
+      unsigned max_states = budget_.get_max_states();
+      spot::output_aborter aborter(max_states);
+      // pretty_print, use_scc, use_simulation, use_stutter, aborter
+      spot::twa_graph_ptr res = spot::tgba_determinize(aut_, false, om_.get(USE_SCC_INFO) > 0
+      , om_.get(USE_SIMULATION) > 0, om_.get(USE_STUTTER) > 0, max_states > 0 ? &aborter : nullptr, om_.get(NUM_TRANS_PRUNING));
+      if (res)
+      {
+        // the number of states first, so that the parent does not need to parse the automaton
+        std::ostringstream out;
+        out << res->num_states() << '\n';
+        spot::print_hoa(out, res);
+        std::string data = out.str();
+        size_t written = 0;
+        while (written < data.size())
+        {
+          ssize_t n = write(fd, data.data() + written, data.size() - written);
+          if (n < 0 && errno == EINTR)
+            continue;
+          if (n <= 0)
+            break;
+          written += n;
+        }
+      }
+    }
+    catch (...)
+    {
+      // nothing is sent, the parent keeps the result of cola
+    }
+    close(fd);
+    // do not run the destructors of the parent's objects
+    _exit(0);
+  }
+
+  spot::twa_graph_ptr
+  portfolio::run(const std::function<spot::twa_graph_ptr(budget &)> &cola_engine)
+  {
+    int fds[2];
+    if (pipe(fds) != 0)
+      throw std::runtime_error("portfolio: cannot create a pipe");
+    // otherwise the buffered output would be printed twice
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+      close(fds[0]);
+      close(fds[1]);
+      throw std::runtime_error("portfolio: cannot fork the Spot process");
+    }
+    if (pid == 0)
+    {
+      close(fds[0]);
+      run_spot(fds[1]);
+    }
+    close(fds[1]);
+
+    const unsigned max_states = budget_.get_max_states();
+    const unsigned ratio = om_.get(PORTFOLIO_RATIO) > 0 ? om_.get(PORTFOLIO_RATIO) : 100;
+    // the result of Spot, 0 states means that Spot has not finished
+    std::string spot_hoa;
+    std::atomic<unsigned> spot_states(0);
+
+    // only waits for the child, it must not touch any BDD
+    std::thread watcher([&]()
+    {
+      std::string data;
+      char buffer[1 << 16];
+      for (;;)
+      {
+        ssize_t n = read(fds[0], buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR)
+          continue;
+        if (n <= 0)
+          break;
+        data.append(buffer, n);
+      }
+      size_t eol = data.find('\n');
+      // killed or aborted
+      if (eol == std::string::npos)
+        return;
+      unsigned num_states = std::stoul(data.substr(0, eol));
+      spot_hoa = data.substr(eol + 1);
+      spot_states.store(num_states);
+      // cola may continue as long as it can still win
+      unsigned limit = std::max(1ul, (unsigned long)num_states * ratio / 100);
+      if (max_states == 0 || limit < max_states)
+        budget_.set_max_states(limit);
+    });
+
+    auto stop_spot = [&]()
+    {
+      kill(pid, SIGKILL);
+      watcher.join();
+      close(fds[0]);
+      waitpid(pid, nullptr, 0);
+      budget_.set_max_states(max_states);
+    };
+
+    spot::twa_graph_ptr res = nullptr;
+    try
+    {
+      res = cola_engine(budget_);
+    }
+    catch (const budget_exceeded &e)
+    {
+      // cola has lost the race, or ran out of the budget on its own
+      if (spot_states.load() == 0)
+      {
+        stop_spot();
+        throw;
+      }
+      if (om_.get(VERBOSE_LEVEL) > 0)
+        std::cout << "cola stopped at " << e.num_states() << " states" << std::endl;
+    }
+    catch (...)
+    {
+      // the watcher must be joined before it is destroyed
+      stop_spot();
+      throw;
+    }
+    stop_spot();
+
+    unsigned num_spot = spot_states.load();
+    if (num_spot > 0 && (!res || num_spot < res->num_states()))
+    {
+      spot::automaton_stream_parser parser(spot_hoa.c_str(), "portfolio");
+      spot::parsed_aut_ptr parsed = parser.parse(aut_->get_dict());
+      if (parsed->format_errors(std::cerr) || !parsed->aut)
+        throw std::runtime_error("portfolio: cannot read the result of Spot");
+      res = parsed->aut;
+      winner_ = "spot";
+    }
+    else
+    {
+      winner_ = "cola";
+    }
+    return res;
+  }
+}
@@ -0,0 +1,67 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "cola.hpp"
+#include "budget.hpp"
+
+#include <functional>
+#include <string>
+
+#include <spot/misc/optionmap.hh>
+
+namespace cola
+{
+  /// \brief Race a cola construction against spot::tgba_determinize
+  ///
+  /// BuDDy is not thread-safe, so Spot runs in a forked child process with
+  /// its own copy of the BDD dictionary and sends back its result, while
+  /// the cola construction runs in this process.
+  /// Once Spot finishes with n states, the cola construction is stopped as
+  /// soon as it has more than n * PORTFOLIO_RATIO / 100 states; once cola
+  /// finishes first, Spot is killed.
+  class portfolio
+  {
+  private:
+    // the automaton to determinize
+    spot::const_twa_graph_ptr aut_;
+
+    spot::option_map &om_;
+
+    // the budget shared with the cola construction
+    budget &budget_;
+
+    // the engine that has produced the result
+    std::string winner_;
+
+    // run Spot in the child process and write its result to fd
+    void run_spot(int fd);
+
+  public:
+    portfolio(const spot::const_twa_graph_ptr &aut, spot::option_map &om, budget &limits);
+
+    /// \brief Run \a cola_engine in this process and Spot in a child process
+    ///
+    /// Output the smaller of the automata obtained before the other engine is stopped
+    spot::twa_graph_ptr
+    run(const std::function<spot::twa_graph_ptr(budget &)> &cola_engine);
+
+    // "cola" or "spot"
+    const std::string &winner() const
+    {
+      return winner_;
+    }
+  };
+}
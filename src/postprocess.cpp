@@ -0,0 +1,528 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "cola.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <spot/twaalgos/cleanacc.hh>
+#include <spot/twaalgos/isdet.hh>
+#include <spot/twaalgos/sccinfo.hh>
+
+// Postprocessing of the deterministic automata built by cola: an SCC-wise
+// reduction whose cost grows with the size of the SCCs rather than with the
+// size of the whole automaton, and a bisimulation quotient.
+
+namespace cola
+{
+  // an outgoing edge of a state up to the class of its successor
+  typedef std::tuple<unsigned, spot::acc_cond::mark_t, bdd> signature_edge;
+
+  // the edges of a state grouped by (class of the successor, colors)
+  typedef std::vector<signature_edge> signature;
+
+  struct signature_less
+  {
+    bool
+    operator()(const signature &lhs, const signature &rhs) const
+    {
+      if (lhs.size() != rhs.size())
+        return lhs.size() < rhs.size();
+      for (unsigned i = 0; i < lhs.size(); i++)
+      {
+        if (std::get<0>(lhs[i]) != std::get<0>(rhs[i]))
+          return std::get<0>(lhs[i]) < std::get<0>(rhs[i]);
+        if (std::get<1>(lhs[i]) != std::get<1>(rhs[i]))
+          return std::get<1>(lhs[i]) < std::get<1>(rhs[i]);
+        if (std::get<2>(lhs[i]).id() != std::get<2>(rhs[i]).id())
+          return std::get<2>(lhs[i]).id() < std::get<2>(rhs[i]).id();
+      }
+      return false;
+    }
+  };
+
+  // the signature of s, led by its current class so that a round only splits classes
+  static signature
+  compute_signature(const spot::twa_graph_ptr &aut, unsigned s, const std::vector<unsigned> &cls)
+  {
+    std::map<std::pair<unsigned, spot::acc_cond::mark_t>, bdd> succs;
+    for (const auto &t : aut->out(s))
+    {
+      auto it = succs.emplace(std::make_pair(cls[t.dst], t.acc), bddfalse).first;
+      it->second |= t.cond;
+    }
+    signature res;
+    res.emplace_back(cls[s], spot::acc_cond::mark_t(), bddtrue);
+    for (const auto &p : succs)
+      res.emplace_back(p.first.first, p.first.second, p.second);
+    return res;
+  }
+
+  // A partition of {0, ..., n - 1} whose sets can be split by marking some
+  // of their elements, as in the DFA minimization of A. Valmari, "Fast brief
+  // practical DFA minimization", Inf. Process. Lett. 112(6), 2012.
+  class refinable_partition
+  {
+  public:
+    // the number of sets
+    unsigned num_sets_;
+    // the elements, each set is a contiguous range E[F[s]], ..., E[P[s] - 1]
+    std::vector<unsigned> elems_;
+    // the position of each element in elems_
+    std::vector<unsigned> loc_;
+    // the set of each element
+    std::vector<unsigned> set_of_;
+    std::vector<unsigned> first_;
+    std::vector<unsigned> past_;
+    // the number of marked elements of each set, they lead its range
+    std::vector<unsigned> marked_;
+    // the sets with marked elements
+    std::vector<unsigned> touched_;
+
+    refinable_partition(unsigned n)
+        : num_sets_(n > 0), elems_(n), loc_(n), set_of_(n, 0),
+          first_(n + 1, 0), past_(n + 1, 0), marked_(n + 1, 0)
+    {
+      for (unsigned i = 0; i < n; i++)
+        elems_[i] = loc_[i] = i;
+      past_[0] = n;
+    }
+
+    void
+    mark(unsigned e)
+    {
+      unsigned s = set_of_[e];
+      unsigned i = loc_[e];
+      unsigned j = first_[s] + marked_[s];
+      elems_[i] = elems_[j];
+      loc_[elems_[i]] = i;
+      elems_[j] = e;
+      loc_[e] = j;
+      if (marked_[s]++ == 0)
+        touched_.push_back(s);
+    }
+
+    // split the touched sets into their marked and unmarked elements, the
+    // smaller part gets the new set number
+    void
+    split()
+    {
+      while (!touched_.empty())
+      {
+        unsigned s = touched_.back();
+        touched_.pop_back();
+        unsigned j = first_[s] + marked_[s];
+        if (j == past_[s])
+        {
+          marked_[s] = 0;
+          continue;
+        }
+        unsigned z = num_sets_++;
+        if (marked_[s] <= past_[s] - j)
+        {
+          first_[z] = first_[s];
+          past_[z] = first_[s] = j;
+        }
+        else
+        {
+          past_[z] = past_[s];
+          first_[z] = past_[s] = j;
+        }
+        for (unsigned i = first_[z]; i < past_[z]; i++)
+          set_of_[elems_[i]] = z;
+        marked_[s] = marked_[z] = 0;
+      }
+    }
+  };
+
+  // the coarsest partition of the letters such that every guard of the
+  // outgoing edges of the states is a union of classes, with the classes
+  // included in each guard
+  static std::vector<bdd>
+  compute_letter_classes(const spot::const_twa_graph_ptr &aut, const std::vector<unsigned> &states,
+                         std::unordered_map<int, std::vector<unsigned>> &guard2classes)
+  {
+    std::vector<bdd> classes = {bddtrue};
+    std::vector<bdd> guards;
+    for (unsigned s : states)
+    {
+      for (const auto &t : aut->out(s))
+      {
+        if (!guard2classes.emplace(t.cond.id(), std::vector<unsigned>()).second)
+          continue;
+        guards.push_back(t.cond);
+        std::vector<bdd> refined;
+        for (const bdd &c : classes)
+        {
+          bdd in = c & t.cond;
+          bdd out = c - t.cond;
+          if (in != bddfalse)
+            refined.push_back(in);
+          if (out != bddfalse)
+            refined.push_back(out);
+        }
+        classes.swap(refined);
+      }
+    }
+    for (const bdd &guard : guards)
+    {
+      std::vector<unsigned> &in_guard = guard2classes[guard.id()];
+      for (unsigned i = 0; i < classes.size(); i++)
+        if ((classes[i] & guard) != bddfalse)
+          in_guard.push_back(i);
+    }
+    return classes;
+  }
+
+  static const unsigned NO_HEAD = -1U;
+
+  // refine blocks, a partition of the states, into the coarsest partition
+  // respected by the transitions (tails[t], label_of[t], heads[t]) of a
+  // deterministic automaton; the transitions with heads[t] == NO_HEAD leave
+  // the states, their label must decide their target. Returns false if
+  // expired() before the end, blocks are then only partly refined.
+  static bool
+  refine_blocks(refinable_partition &blocks, const std::vector<unsigned> &tails,
+                const std::vector<unsigned> &heads, const std::vector<unsigned> &label_of,
+                const std::function<bool()> &expired)
+  {
+    unsigned num_states = blocks.elems_.size();
+    unsigned num_trans = tails.size();
+    // the transitions grouped by label
+    refinable_partition cords(num_trans);
+    if (num_trans > 0)
+    {
+      std::sort(cords.elems_.begin(), cords.elems_.end(),
+                [&](unsigned i, unsigned j) { return label_of[i] < label_of[j]; });
+      cords.num_sets_ = 0;
+      for (unsigned i = 0; i < num_trans; i++)
+      {
+        unsigned t = cords.elems_[i];
+        if (i == 0 || label_of[t] != label_of[cords.elems_[i - 1]])
+        {
+          if (i > 0)
+            cords.past_[cords.num_sets_ - 1] = i;
+          cords.first_[cords.num_sets_++] = i;
+        }
+        cords.set_of_[t] = cords.num_sets_ - 1;
+        cords.loc_[t] = i;
+      }
+      cords.past_[cords.num_sets_ - 1] = num_trans;
+    }
+
+    // the incoming transitions of each state
+    std::vector<unsigned> in_first(num_states + 1, 0);
+    for (unsigned t = 0; t < num_trans; t++)
+      if (heads[t] != NO_HEAD)
+        in_first[heads[t] + 1]++;
+    for (unsigned s = 0; s < num_states; s++)
+      in_first[s + 1] += in_first[s];
+    std::vector<unsigned> in_trans(in_first[num_states]);
+    {
+      std::vector<unsigned> pos(in_first.begin(), in_first.end() - 1);
+      for (unsigned t = 0; t < num_trans; t++)
+        if (heads[t] != NO_HEAD)
+          in_trans[pos[heads[t]]++] = t;
+    }
+
+    // every set of transitions but only the new blocks are splitters,
+    // the smaller half of a split gets the new number
+    unsigned b = 1;
+    unsigned c = 0;
+    while (c < cords.num_sets_)
+    {
+      if (expired())
+        return false;
+      for (unsigned i = cords.first_[c]; i < cords.past_[c]; i++)
+        blocks.mark(tails[cords.elems_[i]]);
+      blocks.split();
+      c++;
+      while (b < blocks.num_sets_)
+      {
+        for (unsigned i = blocks.first_[b]; i < blocks.past_[b]; i++)
+        {
+          unsigned s = blocks.elems_[i];
+          for (unsigned j = in_first[s]; j < in_first[s + 1]; j++)
+            cords.mark(in_trans[j]);
+        }
+        cords.split();
+        b++;
+      }
+    }
+    return true;
+  }
+
+  // merge the bisimilar states of an SCC, the classes of the states outside
+  // of it are fixed; the class of a state is the smallest state in it.
+  // Returns false if expired() before the end, the classes of the states of
+  // the SCC are then left as they were.
+  static bool
+  merge_scc(const spot::twa_graph_ptr &aut, const spot::scc_info &si, unsigned scc, std::vector<unsigned> &cls,
+            const std::function<bool()> &expired)
+  {
+    const std::vector<unsigned> &states = si.states_of(scc);
+    unsigned rep = *std::min_element(states.begin(), states.end());
+    for (unsigned s : states)
+      cls[s] = rep;
+    unsigned num_classes = 1;
+    while (true)
+    {
+      if (expired())
+      {
+        for (unsigned s : states)
+          cls[s] = s;
+        return false;
+      }
+      // all signatures are alive until the classes are updated, so the
+      // identifiers of their BDDs are unique
+      std::vector<signature> sigs;
+      sigs.reserve(states.size());
+      for (unsigned s : states)
+        sigs.push_back(compute_signature(aut, s, cls));
+      std::map<signature, unsigned, signature_less> sig2rep;
+      for (unsigned i = 0; i < states.size(); i++)
+      {
+        auto it = sig2rep.emplace(sigs[i], states[i]).first;
+        it->second = std::min(it->second, states[i]);
+      }
+      for (unsigned i = 0; i < states.size(); i++)
+        cls[states[i]] = sig2rep[sigs[i]];
+      if (sig2rep.size() == num_classes)
+        break;
+      num_classes = sig2rep.size();
+    }
+    return true;
+  }
+
+  // merge_scc() for deterministic automata by the partition refinement of
+  // bisimulation_quotient(), in O(m k log n) for the m edges of the SCC and
+  // its k letter classes; local maps the states of the SCC to 0, 1, ...
+  static bool
+  merge_det_scc(const spot::twa_graph_ptr &aut, const spot::scc_info &si, unsigned scc, std::vector<unsigned> &cls,
+                std::vector<unsigned> &local, const std::function<bool()> &expired)
+  {
+    const std::vector<unsigned> &states = si.states_of(scc);
+    for (unsigned i = 0; i < states.size(); i++)
+      local[states[i]] = i;
+    std::unordered_map<int, std::vector<unsigned>> guard2classes;
+    compute_letter_classes(aut, states, guard2classes);
+    // the edges leaving the SCC are labelled by the fixed class of their target
+    std::map<std::tuple<unsigned, spot::acc_cond::mark_t, unsigned>, unsigned> labels;
+    std::vector<unsigned> tails, heads, label_of;
+    for (unsigned i = 0; i < states.size(); i++)
+    {
+      for (const auto &t : aut->out(states[i]))
+      {
+        bool inside = si.scc_of(t.dst) == scc;
+        unsigned target = inside ? NO_HEAD : cls[t.dst];
+        for (unsigned c : guard2classes[t.cond.id()])
+        {
+          auto it = labels.emplace(std::make_tuple(c, t.acc, target), labels.size()).first;
+          tails.push_back(i);
+          heads.push_back(inside ? local[t.dst] : NO_HEAD);
+          label_of.push_back(it->second);
+        }
+      }
+    }
+    refinable_partition blocks(states.size());
+    if (!refine_blocks(blocks, tails, heads, label_of, expired))
+      return false;
+    for (unsigned blk = 0; blk < blocks.num_sets_; blk++)
+    {
+      unsigned rep = -1U;
+      for (unsigned i = blocks.first_[blk]; i < blocks.past_[blk]; i++)
+        rep = std::min(rep, states[blocks.elems_[i]]);
+      for (unsigned i = blocks.first_[blk]; i < blocks.past_[blk]; i++)
+        cls[states[blocks.elems_[i]]] = rep;
+    }
+    return true;
+  }
+
+  // renumber the colors of the parity automaton aut in each SCC, keeping
+  // their order and parity and merging consecutive colors of the same parity
+  static void
+  compact_parity_colors(const spot::twa_graph_ptr &aut, const spot::scc_info &si, bool max, bool odd)
+  {
+    int num_sets = aut->num_sets();
+    // the color deciding the acceptance of an edge, edges without colors
+    // are below or above all the colors and accept as the empty set does
+    const int no_color = max ? -1 : num_sets;
+    const bool no_color_accepting = aut->acc().accepting(spot::acc_cond::mark_t());
+    auto color_of = [&](spot::acc_cond::mark_t acc)
+    {
+      if (!acc)
+        return no_color;
+      return max ? (int)acc.max_set() - 1 : (int)acc.min_set() - 1;
+    };
+    auto is_accepting = [&](int color)
+    {
+      if (color == no_color)
+        return no_color_accepting;
+      return (color & 1) == (int)odd;
+    };
+    std::vector<std::map<int, unsigned>> new_colors(si.scc_count());
+    for (auto &t : aut->edges())
+    {
+      unsigned scc = si.scc_of(t.src);
+      if (scc == si.scc_of(t.dst))
+        new_colors[scc].emplace(color_of(t.acc), 0);
+    }
+    unsigned new_num_sets = 0;
+    for (auto &colors : new_colors)
+    {
+      unsigned color = 0;
+      bool first = true;
+      bool prev = false;
+      for (auto &p : colors)
+      {
+        bool acc = is_accepting(p.first);
+        if (first)
+          color = is_accepting(0) == acc ? 0 : 1;
+        else if (acc != prev)
+          color++;
+        p.second = color;
+        prev = acc;
+        first = false;
+      }
+      if (!colors.empty())
+        new_num_sets = std::max(new_num_sets, color + 1);
+    }
+    for (auto &t : aut->edges())
+    {
+      unsigned scc = si.scc_of(t.src);
+      spot::acc_cond::mark_t acc = {};
+      if (scc == si.scc_of(t.dst))
+        acc.set(new_colors[scc][color_of(t.acc)]);
+      t.acc = acc;
+    }
+    new_num_sets = std::max(new_num_sets, 1u);
+    aut->set_acceptance(new_num_sets, spot::acc_cond::acc_code::parity(max, odd, new_num_sets));
+  }
+
+  spot::twa_graph_ptr
+  postprocess_sccs(const spot::twa_graph_ptr &aut, spot::option_map &om)
+  {
+    auto start = std::chrono::steady_clock::now();
+    unsigned time_limit = om.get(POST_TIME_LIMIT);
+    unsigned num_states = aut->num_states();
+    unsigned num_sets = aut->num_sets();
+    spot::cleanup_acceptance_here(aut);
+    spot::scc_info si(aut, spot::scc_info_options::NONE);
+    // without colors, the acceptance t or f is not a parity condition worth compacting
+    bool max, odd;
+    if (aut->num_sets() > 0 && aut->acc().is_parity(max, odd))
+      compact_parity_colors(aut, si, max, odd);
+
+    // successors have smaller SCC numbers, so the classes of the successors
+    // of an SCC are final when it is processed
+    std::vector<unsigned> cls(num_states);
+    for (unsigned s = 0; s < num_states; s++)
+      cls[s] = s;
+    auto expired = [&]()
+    {
+      return time_limit > 0 && std::chrono::duration_cast<std::chrono::milliseconds>(
+                                   std::chrono::steady_clock::now() - start).count() >= time_limit;
+    };
+    bool deterministic = spot::is_deterministic(aut);
+    std::vector<unsigned> local(deterministic ? num_states : 0);
+    unsigned scc = 0;
+    for (; scc < si.scc_count(); scc++)
+    {
+      // an SCC cut by the deadline keeps its states
+      bool done = deterministic ? merge_det_scc(aut, si, scc, cls, local, expired)
+                                : merge_scc(aut, si, scc, cls, expired);
+      if (!done)
+        break;
+    }
+    for (auto &t : aut->edges())
+      t.dst = cls[t.dst];
+    aut->set_init_state(cls[aut->get_init_state_number()]);
+    aut->merge_edges();
+    aut->purge_unreachable_states();
+    if (om.get(VERBOSE_LEVEL) > 0)
+      std::cout << "SCC-wise postprocessing: " << num_states << " -> " << aut->num_states()
+                << " states, " << num_sets << " -> " << aut->num_sets() << " colors, "
+                << scc << " of " << si.scc_count() << " SCCs processed" << std::endl;
+    return aut;
+  }
+
+  spot::twa_graph_ptr
+  bisimulation_quotient(const spot::twa_graph_ptr &aut, spot::option_map &om)
+  {
+    // the quotient by the letters and colors of the edges is only
+    // language-preserving on deterministic automata
+    if (!spot::is_deterministic(aut))
+      return aut;
+    clock_t c_start = clock();
+    unsigned num_states = aut->num_states();
+
+    // the transitions of aut over (letter class, colors), as arrays of
+    // tails, labels and heads
+    std::unordered_map<int, std::vector<unsigned>> guard2classes;
+    std::vector<unsigned> all_states(num_states);
+    for (unsigned s = 0; s < num_states; s++)
+      all_states[s] = s;
+    std::vector<bdd> classes = compute_letter_classes(aut, all_states, guard2classes);
+    std::map<std::pair<unsigned, spot::acc_cond::mark_t>, unsigned> labels;
+    std::vector<unsigned> tails, heads, label_of;
+    for (const auto &t : aut->edges())
+    {
+      for (unsigned c : guard2classes[t.cond.id()])
+      {
+        auto it = labels.emplace(std::make_pair(c, t.acc), labels.size()).first;
+        tails.push_back(t.src);
+        heads.push_back(t.dst);
+        label_of.push_back(it->second);
+      }
+    }
+
+    // the blocks of states are refined by the sets of transitions and vice versa
+    refinable_partition blocks(num_states);
+    refine_blocks(blocks, tails, heads, label_of, []() { return false; });
+
+    // one state per block with the edges of any of its states
+    spot::twa_graph_ptr res = spot::make_twa_graph(aut->get_dict());
+    res->copy_ap_of(aut);
+    res->copy_acceptance_of(aut);
+    res->prop_copy(aut,
+                   {
+                       true,       // state based
+                       true,       // inherently_weak
+                       true, true, // deterministic
+                       true,       // complete
+                       true        // stutter inv
+                   });
+    res->new_states(blocks.num_sets_);
+    for (unsigned blk = 0; blk < blocks.num_sets_; blk++)
+    {
+      unsigned rep = blocks.elems_[blocks.first_[blk]];
+      for (const auto &t : aut->out(rep))
+        res->new_edge(blk, blocks.set_of_[t.dst], t.cond, t.acc);
+    }
+    res->set_init_state(blocks.set_of_[aut->get_init_state_number()]);
+    res->merge_edges();
+    clock_t c_end = clock();
+    if (om.get(VERBOSE_LEVEL) > 0)
+      std::cout << "Bisimulation quotient: " << num_states << " -> " << res->num_states() << " states over "
+                << classes.size() << " letter classes in " << 1000.0 * (c_end - c_start) / CLOCKS_PER_SEC << " ms" << std::endl;
+    return res;
+  }
+}
@@ -0,0 +1,203 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "result_cache.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <spot/twa/bddprint.hh>
+
+namespace cola
+{
+  static const char *RESULT_SUFFIX = ".hoa";
+
+  result_cache::result_cache(const std::string &dir, size_t max_bytes)
+      : dir_(dir), max_bytes_(max_bytes)
+  {
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+      throw std::runtime_error("result cache: cannot create " + dir);
+  }
+
+  std::string
+  result_cache::path_of(const std::string &key) const
+  {
+    return dir_ + "/" + key + RESULT_SUFFIX;
+  }
+
+  bool
+  result_cache::find(const std::string &text, std::string &result)
+  {
+    std::string path = path_of(compute_key(text));
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+      return false;
+    // the file is "<length of the text>\n", the text and the result
+    size_t length;
+    if (!(in >> length) || in.get() != '\n')
+      return false;
+    std::string stored(length, '\0');
+    if (!in.read(&stored[0], length) || stored != text)
+      return false;
+    std::ostringstream content;
+    content << in.rdbuf();
+    result = content.str();
+    // the file is the most recently used now
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    return true;
+  }
+
+  void
+  result_cache::insert(const std::string &text, const std::string &result)
+  {
+    std::string key = compute_key(text);
+    std::string path = path_of(key);
+    std::string tmp = dir_ + "/." + key + "." + std::to_string(getpid()) + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary);
+      out << text.size() << '\n' << text << result;
+      out.close();
+      if (!out)
+      {
+        // a full disk only loses the result
+        unlink(tmp.c_str());
+        return;
+      }
+    }
+    if (rename(tmp.c_str(), path.c_str()) != 0)
+    {
+      unlink(tmp.c_str());
+      return;
+    }
+    evict();
+  }
+
+  void
+  result_cache::evict()
+  {
+    if (max_bytes_ == 0)
+      return;
+    DIR *dir = opendir(dir_.c_str());
+    if (dir == nullptr)
+      return;
+    // (modification time, size, path) of the results
+    std::vector<std::tuple<struct timespec, size_t, std::string>> files;
+    size_t total = 0;
+    while (dirent *entry = readdir(dir))
+    {
+      std::string name = entry->d_name;
+      size_t len = std::string(RESULT_SUFFIX).size();
+      if (name[0] == '.' || name.size() <= len || name.compare(name.size() - len, len, RESULT_SUFFIX) != 0)
+        continue;
+      std::string path = dir_ + "/" + name;
+      struct stat st;
+      if (stat(path.c_str(), &st) != 0)
+        continue;
+      files.emplace_back(st.st_mtim, st.st_size, path);
+      total += st.st_size;
+    }
+    closedir(dir);
+    if (total <= max_bytes_)
+      return;
+    std::sort(files.begin(), files.end(),
+              [](const std::tuple<struct timespec, size_t, std::string> &a,
+                 const std::tuple<struct timespec, size_t, std::string> &b)
+              {
+                const struct timespec &ta = std::get<0>(a);
+                const struct timespec &tb = std::get<0>(b);
+                return ta.tv_sec != tb.tv_sec ? ta.tv_sec < tb.tv_sec : ta.tv_nsec < tb.tv_nsec;
+              });
+    for (const auto &f : files)
+    {
+      if (total <= max_bytes_)
+        break;
+      // another run may have removed it already
+      unlink(std::get<2>(f).c_str());
+      total -= std::get<1>(f);
+    }
+  }
+
+  std::string
+  result_cache::canonical_text(const spot::const_twa_graph_ptr &aut, const std::string &settings)
+  {
+    std::ostringstream text;
+    text << settings << '\n';
+    for (const auto &ap : aut->ap())
+      text << ap << ' ';
+    text << '\n' << aut->num_sets() << ' ' << aut->get_acceptance() << '\n';
+
+    // the edges of a state as (guard, colors, successor) in the order of the key
+    typedef std::tuple<std::string, std::string, unsigned> key_edge;
+    std::vector<int> order(aut->num_states(), -1);
+    std::deque<unsigned> todo;
+    unsigned init = aut->get_init_state_number();
+    order[init] = 0;
+    todo.push_back(init);
+    unsigned num_visited = 1;
+    while (!todo.empty())
+    {
+      unsigned s = todo.front();
+      todo.pop_front();
+      std::vector<key_edge> edges;
+      for (const auto &t : aut->out(s))
+      {
+        std::ostringstream acc;
+        acc << t.acc;
+        edges.emplace_back(spot::bdd_format_formula(aut->get_dict(), t.cond), acc.str(), t.dst);
+      }
+      // ties keep the order of the input
+      std::stable_sort(edges.begin(), edges.end(),
+                       [](const key_edge &a, const key_edge &b)
+                       {
+                         return std::tie(std::get<0>(a), std::get<1>(a)) < std::tie(std::get<0>(b), std::get<1>(b));
+                       });
+      text << order[s] << ':';
+      for (const auto &e : edges)
+      {
+        unsigned dst = std::get<2>(e);
+        if (order[dst] < 0)
+        {
+          order[dst] = num_visited++;
+          todo.push_back(dst);
+        }
+        text << " [" << std::get<0>(e) << "] " << order[dst] << ' ' << std::get<1>(e);
+      }
+      text << '\n';
+    }
+    return text.str();
+  }
+
+  std::string
+  result_cache::compute_key(const std::string &text)
+  {
+    char key[33];
+    std::snprintf(key, sizeof(key), "%016llx%016llx",
+                  (unsigned long long)hash_values(text, 0),
+                  (unsigned long long)hash_values(text, 0x5851f42d4c957f2dULL));
+    return key;
+  }
+}
@@ -0,0 +1,84 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "cola.hpp"
+
+#include <string>
+
+namespace cola
+{
+  /// \brief The results of previous runs kept in a directory
+  ///
+  /// A result is stored in the file named by the key of its input, after the
+  /// canonical text of the input, which is compared on lookup so that two
+  /// inputs with the same key never share a result. The file is written to a
+  /// temporary file first and then renamed, so concurrent runs never see a
+  /// partial result. Hits update the modification time and the
+  /// least recently used results are removed once the directory is larger
+  /// than the size bound.
+  class result_cache
+  {
+  private:
+    std::string dir_;
+
+    // 0 means no bound
+    size_t max_bytes_;
+
+    std::string
+    path_of(const std::string &key) const;
+
+    // remove the oldest results until the directory fits in max_bytes_
+    void
+    evict();
+
+  public:
+    result_cache(const std::string &dir, size_t max_bytes);
+
+    const std::string &
+    get_dir() const
+    {
+      return dir_;
+    }
+
+    // the stored result of the input given by its canonical text, false if
+    // there is none
+    bool
+    find(const std::string &text, std::string &result);
+
+    void
+    insert(const std::string &text, const std::string &result);
+
+    /// \brief The canonical text of an input automaton with the settings of a run
+    ///
+    /// The states reachable from the initial state are renumbered in BFS
+    /// order, visiting the edges of a state sorted by their guards and
+    /// colors. The edges with the same guard and colors keep the order of
+    /// the input, so two numberings of the same automaton usually, but not
+    /// always, give the same text.
+    static std::string
+    canonical_text(const spot::const_twa_graph_ptr &aut, const std::string &settings);
+
+    // the 128-bit hash of a canonical text, in hexadecimal
+    static std::string
+    compute_key(const std::string &text);
+
+    static std::string
+    compute_key(const spot::const_twa_graph_ptr &aut, const std::string &settings)
+    {
+      return compute_key(canonical_text(aut, settings));
+    }
+  };
+}
@@ -0,0 +1,288 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "selector.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+
+namespace cola
+{
+  static const char *engine_names[NUM_ENGINES] = {"twba", "tldba", "teba", "tnba", "spot", "tnba-decomposed"};
+
+  // log2(n!)
+  static double
+  log2_factorial(unsigned n)
+  {
+    return std::lgamma(n + 1.0) / std::log(2.0);
+  }
+
+  algorithm_selector::algorithm_selector()
+      : coefs_(NUM_ENGINES, std::vector<double>{1.0, 0.0, 0.0}),
+        samples_(NUM_ENGINES)
+  {
+    // hand-set placeholders, not fitted on any benchmark: prefer our
+    // constructions and no decomposition when in doubt, until a calibration
+    // file obtained with --calibrate is given
+    coefs_[ENGINE_SPOT][2] = 1.0;
+    coefs_[ENGINE_TNBA_DECOMPOSED][2] = 2.0;
+  }
+
+  const char *
+  algorithm_selector::engine_name(det_engine engine)
+  {
+    return engine_names[engine];
+  }
+
+  std::vector<int>
+  algorithm_selector::decomposition_choices(det_engine engine)
+  {
+    // two pieces or one piece per accepting SCC
+    if (engine == ENGINE_TNBA_DECOMPOSED)
+      return {2, -1};
+    return {0};
+  }
+
+  void
+  algorithm_selector::load(const std::string &file)
+  {
+    std::ifstream in(file);
+    if (!in)
+      throw std::runtime_error("cannot open the calibration file " + file);
+    std::string line;
+    while (std::getline(in, line))
+    {
+      if (line.empty() || line[0] == '#')
+        continue;
+      std::istringstream iss(line);
+      std::string name;
+      double a, b, c;
+      if (!(iss >> name >> a >> b >> c))
+        throw std::runtime_error("malformed line in the calibration file: " + line);
+      auto it = std::find_if(engine_names, engine_names + NUM_ENGINES,
+                             [&name](const char *n) { return name == n; });
+      if (it == engine_names + NUM_ENGINES)
+        throw std::runtime_error("unknown construction in the calibration file: " + name);
+      coefs_[it - engine_names] = {a, b, c};
+    }
+  }
+
+  void
+  algorithm_selector::save(const std::string &file) const
+  {
+    std::ofstream out(file);
+    if (!out)
+      throw std::runtime_error("cannot write the calibration file " + file);
+    out << "# construction a b c: cost = a*L + b*#APs + c\n";
+    for (unsigned e = 0; e < NUM_ENGINES; e++)
+    {
+      out << engine_names[e] << " " << coefs_[e][0] << " " << coefs_[e][1] << " " << coefs_[e][2]
+          << "  # " << samples_[e].size() << " samples\n";
+    }
+  }
+
+  scc_stats
+  algorithm_selector::compute_stats(analysis &ctx)
+  {
+    scc_stats stats;
+    const spot::scc_info &si = ctx.get_scc_info();
+    const spot::const_twa_graph_ptr &aut = ctx.get_aut();
+    stats.num_states = aut->num_states();
+    stats.num_aps = aut->ap().size();
+    std::string &types = ctx.get_scc_types();
+    for (unsigned sc = 0; sc < si.scc_count(); sc++)
+    {
+      unsigned num = si.states_of(sc).size();
+      if (is_weakscc(types, sc))
+      {
+        stats.iwc_states += num;
+        stats.num_iwcs++;
+        if (is_accepting_weakscc(types, sc))
+          stats.num_acc_iwcs++;
+      }
+      else if (is_accepting_detscc(types, sc))
+        stats.dac_sizes.push_back(num);
+      else if (is_accepting_nondetscc(types, sc))
+        stats.nac_sizes.push_back(num);
+    }
+    stats.aut_type = ctx.get_type();
+    return stats;
+  }
+
+  double
+  algorithm_selector::structure_estimate(det_engine engine, const scc_stats &stats, int num_decomposed) const
+  {
+    // breakpoint construction on the weak part
+    const double weak = std::log2(3.0) * stats.iwc_states;
+    auto dacs = [&stats]()
+    {
+      double res = 0;
+      for (unsigned n : stats.dac_sizes)
+        res += log2_factorial(n);
+      return res;
+    };
+    auto nacs = [&stats]()
+    {
+      double res = 0;
+      for (unsigned n : stats.nac_sizes)
+        res += 2 * log2_factorial(n);
+      return res;
+    };
+    switch (engine)
+    {
+    case ENGINE_TWBA:
+      if (!(stats.aut_type & INHERENTLY_WEAK))
+        return -1;
+      return stats.iwc_states;
+    case ENGINE_TLDBA:
+    {
+      if (!(stats.aut_type & LIMIT_DETERMINISTIC))
+        return -1;
+      unsigned det_states = 0;
+      for (unsigned n : stats.dac_sizes)
+        det_states += n;
+      // subsets of the nondeterministic part, one labelling of all deterministic states
+      return (stats.num_states - det_states) + log2_factorial(det_states);
+    }
+    case ENGINE_TEBA:
+      if (!(stats.aut_type & ELEVATOR))
+        return -1;
+      return weak + dacs();
+    case ENGINE_TNBA:
+      return weak + dacs() + nacs();
+    case ENGINE_SPOT:
+    {
+      // Safra trees, split by SCCs
+      double res = stats.iwc_states + nacs();
+      for (unsigned n : stats.dac_sizes)
+        res += 2 * log2_factorial(n);
+      return res;
+    }
+    case ENGINE_TNBA_DECOMPOSED:
+    {
+      // the decomposer puts the largest accepting SCCs in separate pieces
+      std::vector<double> pieces;
+      for (unsigned n : stats.dac_sizes)
+        pieces.push_back(log2_factorial(n));
+      for (unsigned n : stats.nac_sizes)
+        pieces.push_back(2 * log2_factorial(n));
+      pieces.insert(pieces.end(), stats.num_acc_iwcs, 0.0);
+      if (pieces.size() < 2 || num_decomposed == 0 || num_decomposed == 1)
+        return -1;
+      std::sort(pieces.begin(), pieces.end(), std::greater<double>());
+      unsigned num_pieces = num_decomposed < 0 ? pieces.size() : std::min<unsigned>(num_decomposed, pieces.size());
+      double res = 0;
+      for (unsigned i = 0; i < pieces.size(); i++)
+      {
+        // every piece keeps the weak part, the rest is put together in the last one
+        if (i < num_pieces)
+          res += weak;
+        res += pieces[i];
+      }
+      return res;
+    }
+    default:
+      return -1;
+    }
+  }
+
+  double
+  algorithm_selector::predict(det_engine engine, const scc_stats &stats, int num_decomposed) const
+  {
+    double l = structure_estimate(engine, stats, num_decomposed);
+    if (l < 0)
+      return -1;
+    const std::vector<double> &c = coefs_[engine];
+    return std::max(0.0, c[0] * l + c[1] * stats.num_aps + c[2]);
+  }
+
+  det_engine
+  algorithm_selector::select(const scc_stats &stats, int &num_decomposed) const
+  {
+    det_engine best = ENGINE_TNBA;
+    double best_cost = predict(ENGINE_TNBA, stats);
+    num_decomposed = 0;
+    for (unsigned e = 0; e < NUM_ENGINES; e++)
+    {
+      det_engine engine = (det_engine)e;
+      for (int k : decomposition_choices(engine))
+      {
+        double cost = predict(engine, stats, k);
+        if (cost >= 0 && cost < best_cost)
+        {
+          best = engine;
+          best_cost = cost;
+          num_decomposed = k;
+        }
+      }
+    }
+    return best;
+  }
+
+  void
+  algorithm_selector::add_sample(det_engine engine, const scc_stats &stats, int num_decomposed, unsigned num_states)
+  {
+    double l = structure_estimate(engine, stats, num_decomposed);
+    if (l < 0)
+      return;
+    samples_[engine].push_back({l, (double)stats.num_aps, std::log2(num_states + 1.0)});
+  }
+
+  void
+  algorithm_selector::calibrate()
+  {
+    // least squares for y = a*L + b*#APs + c, pulled towards the current
+    // coefficients so that a few samples do not give wild values
+    const double lambda = 1.0;
+    for (unsigned e = 0; e < NUM_ENGINES; e++)
+    {
+      if (samples_[e].empty())
+        continue;
+      double m[3][4] = {{lambda, 0, 0, lambda * coefs_[e][0]},
+                        {0, lambda, 0, lambda * coefs_[e][1]},
+                        {0, 0, lambda, lambda * coefs_[e][2]}};
+      for (const auto &s : samples_[e])
+      {
+        double x[3] = {s[0], s[1], 1.0};
+        for (unsigned i = 0; i < 3; i++)
+        {
+          for (unsigned j = 0; j < 3; j++)
+            m[i][j] += x[i] * x[j];
+          m[i][3] += x[i] * s[2];
+        }
+      }
+      // Gaussian elimination, the matrix is positive definite
+      for (unsigned i = 0; i < 3; i++)
+      {
+        for (unsigned k = i + 1; k < 3; k++)
+        {
+          double f = m[k][i] / m[i][i];
+          for (unsigned j = i; j < 4; j++)
+            m[k][j] -= f * m[i][j];
+        }
+      }
+      for (int i = 2; i >= 0; i--)
+      {
+        double v = m[i][3];
+        for (unsigned j = i + 1; j < 3; j++)
+          v -= m[i][j] * coefs_[e][j];
+        coefs_[e][i] = v / m[i][i];
+      }
+    }
+  }
+}
@@ -0,0 +1,106 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "cola.hpp"
+#include "analysis.hpp"
+
+#include <string>
+#include <vector>
+
+namespace cola
+{
+  // the constructions the selector chooses from
+  enum det_engine
+  {
+    ENGINE_TWBA = 0,
+    ENGINE_TLDBA,
+    ENGINE_TEBA,
+    ENGINE_TNBA,
+    ENGINE_SPOT,
+    // determinize_tnba on the pieces from the decomposer
+    ENGINE_TNBA_DECOMPOSED,
+    NUM_ENGINES
+  };
+
+  /// \brief SCC statistics of the input NBA, the ones printed by --print-scc
+  struct scc_stats
+  {
+    unsigned num_states = 0;
+    unsigned num_aps = 0;
+    // states in inherently weak SCCs, accepting or not
+    unsigned iwc_states = 0;
+    unsigned num_iwcs = 0;
+    unsigned num_acc_iwcs = 0;
+    // sizes of the deterministic and nondeterministic accepting SCCs
+    std::vector<unsigned> dac_sizes;
+    std::vector<unsigned> nac_sizes;
+    // automaton_type flags
+    unsigned aut_type = NONDETERMINISTIC;
+  };
+
+  /// \brief Choose the determinization construction with a cost model
+  ///
+  /// Each construction has a structural estimate L of the logarithm of the
+  /// number of macrostates it creates (e.g. subsets for IWCs, rankings for
+  /// DACs and Safra trees for NACs). The predicted cost is a*L + b*#APs + c,
+  /// where (a, b, c) are read from a calibration file obtained with calibrate().
+  /// Without such a file, hand-set placeholder coefficients are used; no
+  /// calibration file is shipped.
+  class algorithm_selector
+  {
+  private:
+    // coefficients (a, b, c) for each construction
+    std::vector<std::vector<double>> coefs_;
+
+    // observations (L, #APs, log2 of the number of states) for each construction
+    std::vector<std::vector<std::vector<double>>> samples_;
+
+    // estimate L for the construction, negative if it does not apply
+    double structure_estimate(det_engine engine, const scc_stats &stats, int num_decomposed) const;
+
+  public:
+    algorithm_selector();
+
+    // read the coefficients from a calibration file
+    void load(const std::string &file);
+
+    void save(const std::string &file) const;
+
+    static scc_stats
+    compute_stats(analysis &ctx);
+
+    /// \brief Predicted cost of \a engine on an input with \a stats,
+    /// a negative value if the construction cannot be applied
+    double predict(det_engine engine, const scc_stats &stats, int num_decomposed = 0) const;
+
+    /// \brief The construction with the smallest predicted cost
+    ///
+    /// \a num_decomposed is set to the NUM_NBA_DECOMPOSED value to use with
+    /// ENGINE_TNBA_DECOMPOSED
+    det_engine select(const scc_stats &stats, int &num_decomposed) const;
+
+    /// \brief Record that \a engine produced \a num_states states
+    void add_sample(det_engine engine, const scc_stats &stats, int num_decomposed, unsigned num_states);
+
+    /// \brief Fit the coefficients to the recorded samples
+    void calibrate();
+
+    static const char *engine_name(det_engine engine);
+
+    // the NUM_NBA_DECOMPOSED values tried for \a engine, {0} if it does not decompose
+    static std::vector<int> decomposition_choices(det_engine engine);
+  };
+}
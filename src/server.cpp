@@ -0,0 +1,202 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "server.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace cola
+{
+  // read from fd until buffer holds at least n bytes, false at the end of the input
+  static bool
+  fill(int fd, std::string &buffer, size_t n)
+  {
+    char chunk[1 << 16];
+    while (buffer.size() < n)
+    {
+      ssize_t r = read(fd, chunk, sizeof(chunk));
+      if (r < 0 && errno == EINTR)
+        continue;
+      if (r <= 0)
+        return false;
+      buffer.append(chunk, r);
+    }
+    return true;
+  }
+
+  // the largest request, and the most digits of its length
+  static const size_t MAX_FRAME_SIZE = (size_t)1 << 30;
+  static const size_t MAX_HEADER_DIGITS = 10;
+
+  // the payload of the next frame, false at the end of the input; throws if
+  // the header is not a length of at most MAX_FRAME_SIZE
+  static bool
+  read_frame(int fd, std::string &buffer, std::string &payload)
+  {
+    size_t eol;
+    while ((eol = buffer.find('\n')) == std::string::npos)
+    {
+      if (buffer.size() > MAX_HEADER_DIGITS)
+        throw std::runtime_error("serve: invalid request header");
+      if (!fill(fd, buffer, buffer.size() + 1))
+        return false;
+    }
+    if (eol == 0 || eol > MAX_HEADER_DIGITS || buffer.find_first_not_of("0123456789") < eol)
+      throw std::runtime_error("serve: invalid request header");
+    size_t length = std::stoull(buffer.substr(0, eol));
+    if (length > MAX_FRAME_SIZE)
+      throw std::runtime_error("serve: request too large");
+    buffer.erase(0, eol + 1);
+    if (!fill(fd, buffer, length))
+      throw std::runtime_error("serve: truncated request");
+    payload = buffer.substr(0, length);
+    buffer.erase(0, length);
+    return true;
+  }
+
+  static bool
+  write_all(int fd, const std::string &data)
+  {
+    size_t written = 0;
+    while (written < data.size())
+    {
+      ssize_t n = write(fd, data.data() + written, data.size() - written);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      written += n;
+    }
+    return true;
+  }
+
+  request_server::request_server()
+  {
+  }
+
+  request_server::request_server(const std::string &socket_path)
+      : socket_path_(socket_path)
+  {
+    sockaddr_un addr;
+    if (socket_path.size() >= sizeof(addr.sun_path))
+      throw std::runtime_error("serve: socket path too long: " + socket_path);
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0)
+      throw std::runtime_error("serve: cannot create a socket");
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, socket_path.c_str());
+    // a socket left by a previous server
+    unlink(socket_path.c_str());
+    if (bind(listen_fd_, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd_, 16) != 0)
+    {
+      close(listen_fd_);
+      throw std::runtime_error("serve: cannot listen on " + socket_path);
+    }
+  }
+
+  request_server::~request_server()
+  {
+    if (listen_fd_ >= 0)
+    {
+      close(listen_fd_);
+      unlink(socket_path_.c_str());
+    }
+  }
+
+  void
+  request_server::serve_connection(int in_fd, int out_fd, const handler_t &handler)
+  {
+    std::string buffer;
+    std::string request;
+    while (!stopped_)
+    {
+      try
+      {
+        if (!read_frame(in_fd, buffer, request))
+          break;
+      }
+      catch (const std::exception &e)
+      {
+        // the rest of the input cannot be split into frames, so the
+        // connection is closed after the error
+        std::string response = e.what();
+        if (write_all(out_fd, "error " + std::to_string(response.size()) + "\n"))
+          write_all(out_fd, response);
+        break;
+      }
+      if (request.empty())
+      {
+        stopped_ = true;
+        break;
+      }
+      size_t eol = request.find('\n');
+      std::string options = request.substr(0, eol);
+      std::string input = eol == std::string::npos ? "" : request.substr(eol + 1);
+      std::string response;
+      bool ok;
+      try
+      {
+        ok = handler(options, input, response);
+      }
+      catch (const std::exception &e)
+      {
+        ok = false;
+        response = e.what();
+      }
+      std::string header = (ok ? "ok " : "error ") + std::to_string(response.size()) + "\n";
+      // the client has gone away
+      if (!write_all(out_fd, header) || !write_all(out_fd, response))
+        break;
+    }
+  }
+
+  void
+  request_server::run(const handler_t &handler)
+  {
+    // a client closing its connection must not stop the server
+    signal(SIGPIPE, SIG_IGN);
+    if (listen_fd_ < 0)
+    {
+      serve_connection(STDIN_FILENO, STDOUT_FILENO, handler);
+      return;
+    }
+    while (!stopped_)
+    {
+      int fd = accept(listen_fd_, nullptr, nullptr);
+      if (fd < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        throw std::runtime_error("serve: cannot accept a connection");
+      }
+      try
+      {
+        serve_connection(fd, fd, handler);
+      }
+      catch (const std::exception &)
+      {
+        // an error only closes that connection
+      }
+      close(fd);
+    }
+  }
+}
@@ -0,0 +1,55 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+namespace cola
+{
+  /// \brief The transport of the server mode (--serve)
+  ///
+  /// A request is a frame "<length>\n" followed by length bytes: one line
+  /// with the options and then the input automata in the HOA format.
+  /// The response is a frame "ok <length>\n" or "error <length>\n" followed
+  /// by length bytes. A request of length 0 stops the server. A header that
+  /// is not a length of at most 1 GiB gets an error response, after which
+  /// the connection is closed.
+  class request_server
+  {
+  public:
+    // fills the response and returns false if the request failed
+    typedef std::function<bool(const std::string &options, const std::string &input, std::string &response)> handler_t;
+
+  private:
+    std::string socket_path_;
+    int listen_fd_ = -1;
+    bool stopped_ = false;
+
+    // serve the requests until the end of the input
+    void serve_connection(int in_fd, int out_fd, const handler_t &handler);
+
+  public:
+    // serve on the standard input and output
+    request_server();
+
+    // serve on a Unix domain socket, one client at a time
+    request_server(const std::string &socket_path);
+
+    ~request_server();
+
+    void run(const handler_t &handler);
+  };
+}
@@ -0,0 +1,178 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "spill.hpp"
+#include "binary.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <queue>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace cola
+{
+  record_file::record_file()
+      : file_(nullptr), num_records_(0)
+  {
+    const char *tmpdir = std::getenv("TMPDIR");
+    std::string path = std::string(tmpdir && *tmpdir ? tmpdir : "/tmp") + "/cola-spill-XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0)
+      throw std::runtime_error("cola: cannot create a spill file in " + path);
+    unlink(path.c_str());
+    file_ = fdopen(fd, "w+b");
+    if (file_ == nullptr)
+    {
+      close(fd);
+      throw std::runtime_error("cola: cannot open a spill file");
+    }
+  }
+
+  record_file::~record_file()
+  {
+    if (file_)
+      fclose(file_);
+  }
+
+  void
+  record_file::write(const std::string &key, const std::string &payload)
+  {
+    std::string frame;
+    write_varint(frame, key.size());
+    frame += key;
+    write_varint(frame, payload.size());
+    frame += payload;
+    if (fwrite(frame.data(), 1, frame.size(), file_) != frame.size())
+      throw std::runtime_error("cola: cannot write a spill file, the disk may be full");
+    num_records_++;
+  }
+
+  void
+  record_file::rewind()
+  {
+    fflush(file_);
+    fseek(file_, 0, SEEK_SET);
+  }
+
+  // read a varint, returns false at the end of the file
+  static bool
+  read_length(FILE *file, size_t &length)
+  {
+    length = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+      int byte = getc(file);
+      if (byte == EOF)
+      {
+        if (shift == 0)
+          return false;
+        throw std::runtime_error("cola: truncated spill file");
+      }
+      length |= (size_t)(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+        return true;
+    }
+    throw std::runtime_error("cola: corrupted spill file");
+  }
+
+  static void
+  read_bytes(FILE *file, std::string &str)
+  {
+    size_t length;
+    if (!read_length(file, length))
+      throw std::runtime_error("cola: truncated spill file");
+    str.resize(length);
+    if (length > 0 && fread(&str[0], 1, length, file) != length)
+      throw std::runtime_error("cola: truncated spill file");
+  }
+
+  bool
+  record_file::read(std::string &key, std::string &payload)
+  {
+    size_t length;
+    if (!read_length(file_, length))
+      return false;
+    key.resize(length);
+    if (length > 0 && fread(&key[0], 1, length, file_) != length)
+      throw std::runtime_error("cola: truncated spill file");
+    read_bytes(file_, payload);
+    return true;
+  }
+
+  external_sorter::external_sorter(size_t max_bytes)
+      : max_bytes_(max_bytes), buffer_bytes_(0)
+  {
+  }
+
+  void
+  external_sorter::add(std::string key, std::string payload)
+  {
+    // the strings themselves take some memory too
+    buffer_bytes_ += key.size() + payload.size() + 2 * sizeof(std::string);
+    buffer_.emplace_back(std::move(key), std::move(payload));
+    if (buffer_bytes_ >= max_bytes_)
+      spill();
+  }
+
+  void
+  external_sorter::spill()
+  {
+    std::sort(buffer_.begin(), buffer_.end());
+    std::unique_ptr<record_file> run(new record_file());
+    for (const auto &r : buffer_)
+      run->write(r.first, r.second);
+    run->rewind();
+    runs_.push_back(std::move(run));
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+    buffer_bytes_ = 0;
+  }
+
+  void
+  external_sorter::merge(const std::function<void(const std::string &, const std::string &)> &f)
+  {
+    if (runs_.empty())
+    {
+      std::sort(buffer_.begin(), buffer_.end());
+      for (const auto &r : buffer_)
+        f(r.first, r.second);
+      buffer_.clear();
+      buffer_bytes_ = 0;
+      return;
+    }
+    if (!buffer_.empty())
+      spill();
+    // the current record of each run
+    std::vector<std::pair<std::string, std::string>> heads(runs_.size());
+    auto greater = [&heads](unsigned a, unsigned b)
+    {
+      return heads[a].first > heads[b].first;
+    };
+    std::priority_queue<unsigned, std::vector<unsigned>, decltype(greater)> queue(greater);
+    for (unsigned i = 0; i < runs_.size(); i++)
+      if (runs_[i]->read(heads[i].first, heads[i].second))
+        queue.push(i);
+    while (!queue.empty())
+    {
+      unsigned i = queue.top();
+      queue.pop();
+      f(heads[i].first, heads[i].second);
+      if (runs_[i]->read(heads[i].first, heads[i].second))
+        queue.push(i);
+    }
+    runs_.clear();
+  }
+}
@@ -0,0 +1,99 @@
+// Copyright (C) 2022  The COLA Authors
+// COLA is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// COLA is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cola
+{
+  /// \brief A temporary file of records, each a key and a payload
+  ///
+  /// The file is created in $TMPDIR (default /tmp) and unlinked right away,
+  /// so it disappears with the process. Records are read back in the order
+  /// they have been written.
+  class record_file
+  {
+  private:
+    FILE *file_;
+    size_t num_records_;
+
+  public:
+    record_file();
+
+    ~record_file();
+
+    record_file(const record_file &) = delete;
+    record_file &operator=(const record_file &) = delete;
+
+    void
+    write(const std::string &key, const std::string &payload);
+
+    // go back to the first record
+    void
+    rewind();
+
+    // read the next record, returns false at the end of the file
+    bool
+    read(std::string &key, std::string &payload);
+
+    // the number of records written
+    size_t
+    size() const
+    {
+      return num_records_;
+    }
+  };
+
+  /// \brief Sorts records that may not fit in memory
+  ///
+  /// The records are kept in memory up to \a max_bytes, then sorted and
+  /// written to a record_file as a run. merge() reads all runs at once.
+  class external_sorter
+  {
+  private:
+    size_t max_bytes_;
+    size_t buffer_bytes_;
+    std::vector<std::pair<std::string, std::string>> buffer_;
+    std::vector<std::unique_ptr<record_file>> runs_;
+
+    void
+    spill();
+
+  public:
+    external_sorter(size_t max_bytes);
+
+    void
+    add(std::string key, std::string payload);
+
+    // the number of runs written to the disk so far
+    size_t
+    num_runs() const
+    {
+      return runs_.size();
+    }
+
+    /// \brief Call \a f on all records in the order of their keys
+    ///
+    /// The records with the same key come in no particular order. The
+    /// sorter is empty afterwards.
+    void
+    merge(const std::function<void(const std::string &, const std::string &)> &f);
+  };
+}
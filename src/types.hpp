@@ -36,6 +36,8 @@
 #include <spot/twa/bddprint.hh>
 #include <spot/twaalgos/sccinfo.hh>
 
+#include "hash.hpp"
+
 
 typedef unsigned state_t;
 
@@ -95,14 +97,9 @@ typedef std::vector<std::pair<int, int>> small_dstate;
 struct small_mstate_hash
 {
   size_t
-  operator()(small_mstate s) const noexcept
+  operator()(const small_mstate &s) const noexcept
   {
-    size_t hash = 0;
-    for (const auto &p : s)
-    {
-      hash = spot::wang32_hash(hash ^ ((p.first << 2) | p.second));
-    }
-    return hash;
+    return cola::hash_pairs(s);
   }
 };
 
@@ -110,14 +107,9 @@ struct small_mstate_hash
 struct small_macrostate_hash
 {
   size_t
-  operator()(small_macrostate s) const noexcept
+  operator()(const small_macrostate &s) const noexcept
   {
-    size_t hash = 0;
-    for (const auto &p : s)
-    {
-      hash = spot::wang32_hash(hash ^ ((p.first << 2) | p.second));
-    }
-    return hash;
+    return cola::hash_pairs(s);
   }
 };
 
@@ -125,14 +117,9 @@ struct small_macrostate_hash
 struct small_mcstate_hash
 {
   size_t
-  operator()(small_mcstate s) const noexcept
+  operator()(const small_mcstate &s) const noexcept
   {
-    size_t hash = 0;
-    for (const auto &p : s)
-    {
-      hash = spot::wang32_hash(hash ^ ((p.first << 2) | p.second));
-    }
-    return hash;
+    return cola::hash_pairs(s);
   }
 };
 
@@ -140,13 +127,8 @@ struct small_mcstate_hash
 struct small_dstate_hash
 {
   size_t
-  operator()(small_dstate s) const noexcept
+  operator()(const small_dstate &s) const noexcept
   {
-    size_t hash = 0;
-    for (const auto &p : s)
-    {
-      hash = spot::wang32_hash(hash ^ ((p.first << 2) | p.second));
-    }
-    return hash;
+    return cola::hash_pairs(s);
   }
 };